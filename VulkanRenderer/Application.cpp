@@ -1,6 +1,10 @@
 ﻿#include "Application.hpp"
 
+#include <algorithm>
 #include <chrono>
+#include <format>
+#include <future>
+#include <iostream>
 #include <vector>
 
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -17,6 +21,12 @@
 #include "Scene/Model.hpp"
 #include "ShaderCompilation/ShaderCursor.hpp"
 
+Application::~Application()
+{
+	renderQueue.fallbackMaterial.reset();
+	materialCompiler.discardPending();
+}
+
 void Application::run()
 {
 	loadAssets();
@@ -24,31 +34,108 @@ void Application::run()
 	mainLoop();
 }
 
+void Application::runHeadless(const uint32_t frameCount, const std::optional<std::filesystem::path>& outputDirectory)
+{
+	if (!isHeadless())
+	{
+		throw std::runtime_error("runHeadless requires a renderer created with RendererSettings::headless");
+	}
+
+	loadAssets();
+	initScene();
+
+	if (outputDirectory)
+	{
+		std::filesystem::create_directories(*outputDirectory);
+	}
+
+	const auto startTime{std::chrono::high_resolution_clock::now()};
+
+	for (uint32_t frame = 0; frame < frameCount; ++frame)
+	{
+		drawScene(scene);
+
+		if (outputDirectory)
+		{
+			writeFrameToFile(*outputDirectory / std::format("frame_{:05}.ppm", frame));
+		}
+	}
+
+	device.waitIdle();
+	materialCompiler.waitIdle();
+	gpuProfiler.resolvePendingFrames();
+
+	const auto endTime{std::chrono::high_resolution_clock::now()};
+	const double totalMilliseconds{std::chrono::duration<double, std::milli>(endTime - startTime).count()};
+	std::cout << "Rendered " << frameCount << " frames in " << totalMilliseconds << " ms ("
+		<< (frameCount > 0 ? totalMilliseconds / frameCount : 0.) << " ms per frame)" << std::endl;
+
+	if (settings.memoryReportPath)
+	{
+		getMemoryReport().writeJson(*settings.memoryReportPath);
+	}
+}
+
 void Application::mainLoop()
 {
-	while (!window.shouldClose())
+	while (!window->shouldClose())
 	{
 		Window::pollEvents();
 
-		imGui.newFrame();
+		imGui->newFrame();
 
 		ImGui::Begin("Settings");
 
 		scene.drawImGui();
 
+		renderGraph.stats.drawImGui();
+		getMemoryReport().drawImGui();
+		residencyManager.getStats().drawImGui();
+		pipelineCache.getStats().drawImGui();
+
+		if (gpuScene)
+		{
+			gpuScene->stats.drawImGui();
+		}
+		else
+		{
+			renderQueue.getCullingStats().drawImGui();
+			renderQueue.stats.drawImGui();
+		}
+
+		if (ImGui::Button("Recompile materials"))
+		{
+			// Models keep drawing with the current pipelines until the new ones are ready
+			materialCompiler.reloadSources();
+			for (const AssetHandle<Material>& material : loadedMaterials)
+			{
+				materialCompiler.compileAsync(material);
+			}
+		}
+
 		updateMaterials();
 
 		ImGui::End();
 
+		ImGui::Begin("GPU profiler");
+		gpuProfiler.drawImGui();
+		ImGui::End();
+
+		recompileChangedMaterials();
 		drawScene(scene);
 	}
 
 	device.waitIdle();
+	materialCompiler.waitIdle();
+	gpuProfiler.resolvePendingFrames();
 }
 
 void Application::initScene()
 {
-	window.registerInputHandler(inputHandler);
+	if (window)
+	{
+		window->registerInputHandler(inputHandler);
+	}
 	//inputHandler.registerKeyCallback(std::bind(handleCameraMovement, this, std::placeholders::_1));
 
 	scene.camera.transform.translation = glm::vec3{0.f, .05f, .2f};
@@ -72,55 +159,69 @@ void Application::initScene()
 	scene.lightEnvironment.second.second.cubemap = TextureImage{"../../VulkanRenderer/Textures/Cubemap.png", vk::ImageViewType::eCube, *this};
 	scene.lightEnvironment.second.second.intensity = 5.f;
 
+	// All materials are compiled in parallel. Each is only waited for once its instance is created
+	auto fallbackMaterial{assetManager.createAsset<Material>("BRDF/basicBRDFs", "ConstantUnlitMaterial")};
+	auto pbrMaterial{assetManager.createAsset<Material>("BRDF/pbr", "ConstantPBRMaterial")};
+	auto horizontalBlendMaterial{assetManager.createAsset<Material>("Materials/demoMaterials", "HorizontalBlendDemo")};
+	auto verticalLayerMaterial{assetManager.createAsset<Material>("Materials/demoMaterials", "VerticalLayerDemo")};
+	auto opalMaterial{assetManager.createAsset<Material>("Materials/demoMaterials", "Opal")};
+	auto skyMaterial{assetManager.createAsset<Material>("Materials/basicMaterials", "SkySphereMaterial")};
+	loadedMaterials = {fallbackMaterial, pbrMaterial, horizontalBlendMaterial, verticalLayerMaterial, opalMaterial, skyMaterial};
+	const std::shared_future fallbackCompiled{materialCompiler.compile(*fallbackMaterial)};
+	const std::shared_future pbrCompiled{materialCompiler.compile(*pbrMaterial)};
+	const std::shared_future horizontalBlendCompiled{materialCompiler.compile(*horizontalBlendMaterial)};
+	const std::shared_future verticalLayerCompiled{materialCompiler.compile(*verticalLayerMaterial)};
+	const std::shared_future opalCompiled{materialCompiler.compile(*opalMaterial)};
+	const std::shared_future skyCompiled{materialCompiler.compile(*skyMaterial)};
+
 	{
-		auto material{assetManager.createAsset<Material>("BRDF/pbr", "ConstantPBRMaterial")};
-		material->compile(compiler, *this);
+		fallbackCompiled.get();
+		fallbackMaterialHandle = assetManager.createAsset<MaterialInstance>(fallbackMaterial, "fallback");
+		fallbackMaterialHandle->getShaderCursor().field("material").field("emissive").write(glm::vec3{.5f});
+		renderQueue.fallbackMaterial = fallbackMaterialHandle;
+	}
 
-		auto materialHandle = assetManager.createAsset<MaterialInstance>(material, "constant pbr");
+	{
+		pbrCompiled.get();
+		auto materialHandle = assetManager.createAsset<MaterialInstance>(pbrMaterial, "constant pbr");
 
 		materials.emplace_back(std::make_unique<SimplePBRMaterial>())->Initialize(std::move(materialHandle));
 	}
 
 	{
-		auto material{assetManager.createAsset<Material>("Materials/demoMaterials", "HorizontalBlendDemo")};
-		material->compile(compiler, *this);
-
-		auto materialHandle = assetManager.createAsset<MaterialInstance>(material, "horizontal blend");
+		horizontalBlendCompiled.get();
+		auto materialHandle = assetManager.createAsset<MaterialInstance>(horizontalBlendMaterial, "horizontal blend");
 
 		materials.emplace_back(std::make_unique<SimpleHorizontalBlendDemo>())->Initialize(std::move(materialHandle));
 	}
 
 	{
-		auto material{assetManager.createAsset<Material>("Materials/demoMaterials", "VerticalLayerDemo")};
-		material->compile(compiler, *this);
-
-		auto materialHandle = assetManager.createAsset<MaterialInstance>(material, "vertical layer");
+		verticalLayerCompiled.get();
+		auto materialHandle = assetManager.createAsset<MaterialInstance>(verticalLayerMaterial, "vertical layer");
 
 		materials.emplace_back(std::make_unique<SimpleVerticalBlendDemo>())->Initialize(std::move(materialHandle));
 	}
 
 	{
-		auto material{assetManager.createAsset<Material>("Materials/demoMaterials", "Opal")};
-		material->compile(compiler, *this);
+		// Textures are loaded while the material may still be compiling
+		TextureImage normalMap{"../../VulkanRenderer/Textures/gray_rocks_nor_dx_1k.png", vk::ImageViewType::e2D, *this};
+		TextureImage armMap{"../../VulkanRenderer/Textures/gray_rocks_arm_1k.png", vk::ImageViewType::e2D, *this};
+		TextureImage heightMap{"../../VulkanRenderer/Textures/gray_rocks_disp_1k.png", vk::ImageViewType::e2D, *this};
 
-		auto materialHandle = assetManager.createAsset<MaterialInstance>(material, "opal");
+		opalCompiled.get();
+		auto materialHandle = assetManager.createAsset<MaterialInstance>(opalMaterial, "opal");
 
 		scene.models.emplace_back(meshes[0], materialHandle);
-		materials.emplace_back(std::make_unique<OpalDemo>(
-			         TextureImage{"../../VulkanRenderer/Textures/gray_rocks_nor_dx_1k.png", vk::ImageViewType::e2D, *this},
-			         TextureImage{"../../VulkanRenderer/Textures/gray_rocks_arm_1k.png", vk::ImageViewType::e2D, *this},
-			         TextureImage{"../../VulkanRenderer/Textures/gray_rocks_disp_1k.png", vk::ImageViewType::e2D, *this}))
-		         ->Initialize(std::move(materialHandle));
+		materials.emplace_back(std::make_unique<OpalDemo>(std::move(normalMap), std::move(armMap), std::move(heightMap)))->Initialize(std::move(materialHandle));
 	}
 
 	{
-		auto skyMaterial{assetManager.createAsset<Material>("Materials/basicMaterials", "SkySphereMaterial")};
-		skyMaterial->compile(compiler, *this);
+		skyTexture = TextureImage{"../../VulkanRenderer/Textures/Cubemap.png", vk::ImageViewType::eCube, *this}; // TODO: This should be shared with the above
 
+		skyCompiled.get();
 		skyMaterialHandle = assetManager.createAsset<MaterialInstance>(skyMaterial, "sky material");
-		scene.models.emplace_back(meshes[3], skyMaterialHandle).transform.scale = glm::vec3{1000.f};
-		ShaderCursor skyMaterialCursor{skyMaterialHandle->getShaderCursor().field("gMaterial")};
-		skyTexture = TextureImage{"../../VulkanRenderer/Textures/Cubemap.png", vk::ImageViewType::eCube, *this}; // TODO: This should be shared with the above
+		scene.models.emplace_back(meshes[3], skyMaterialHandle).setTransform(Transform{.scale = glm::vec3{1000.f}});
+		ShaderCursor skyMaterialCursor{skyMaterialHandle->getShaderCursor().field("material")};
 		skyMaterialCursor.field("cubemap").writeTexture(*skyTexture);
 		skyMaterialCursor.field("emissiveIntensity").write(glm::vec1{5.f});
 	}
@@ -138,6 +239,25 @@ void Application::updateMaterials()
 	ImGui::EndChild();
 }
 
+void Application::recompileChangedMaterials()
+{
+	const std::vector<std::filesystem::path> changedFiles{shaderWatcher.poll()};
+	if (changedFiles.empty())
+	{
+		return;
+	}
+
+	materialCompiler.reloadSources();
+	for (const AssetHandle<Material>& material : loadedMaterials)
+	{
+		if (std::ranges::any_of(changedFiles, [&](const std::filesystem::path& file) { return material->dependsOn(file); }))
+		{
+			std::cout << "Recompiling " << material->getName() << std::endl;
+			materialCompiler.compileAsync(material);
+		}
+	}
+}
+
 void Application::loadAssets()
 {
 	static const std::filesystem::path assetBasePath{"../../VulkanRenderer/"}; // TODO: This should be improved as asset locations depend on the working directory
@@ -197,7 +317,8 @@ void Application::handleCameraMovement(const InputEvent& keyEvent)
 	}
 	if (keyEvent.type == InputType::mouseMove)
 	{
-		glm::vec2 normalizedMousePos{keyEvent.mouseX / swapchain.extent.width, keyEvent.mouseY / swapchain.extent.height};
+		const vk::Extent2D extent{getRenderExtent()};
+		glm::vec2 normalizedMousePos{keyEvent.mouseX / extent.width, keyEvent.mouseY / extent.height};
 		normalizedMousePos = 2.f * (normalizedMousePos - glm::vec2{0.5f, 0.5f});
 		glm::vec2 angles{glm::radians(normalizedMousePos.x * 180), glm::radians(normalizedMousePos.y * 90)};
 		scene.camera.transform.rotation = glm::quat{glm::vec3{angles.y, angles.x, 0.0f}};
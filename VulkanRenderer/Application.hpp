@@ -4,12 +4,16 @@
 #include "AssetSystem/AssetManager.hpp"
 #include "Demo/LayeredMaterials/LayeredMaterialsDemo.hpp"
 #include "Scene/Scene.hpp"
+#include "ShaderCompilation/ShaderWatcher.hpp"
 
 class Application : public Renderer
 {
 public:
     void run();
 
+    // Renders frameCount frames without any window. Every frame is written to outputDirectory if given
+    void runHeadless(uint32_t frameCount, const std::optional<std::filesystem::path>& outputDirectory = std::nullopt);
+
 private:
     void mainLoop();
 
@@ -17,6 +21,9 @@ private:
 
     void updateMaterials();
 
+    // Recompiles the materials importing shader files that changed since the last frame
+    void recompileChangedMaterials();
+
     void loadAssets();
 
     AssetManager assetManager;
@@ -28,11 +35,20 @@ private:
 
     Scene scene;
 
+    // Every material of the scene and the demos, so they can be recompiled together
+    std::vector<AssetHandle<Material>> loadedMaterials;
+    // Drawn while the material of a model is compiled for the first time
+    AssetHandle<MaterialInstance> fallbackMaterialHandle;
+    ShaderWatcher shaderWatcher;
+
     // TODO: All of this is bad!
     AssetHandle<MaterialInstance> skyMaterialHandle;
     std::optional<TextureImage> skyTexture;
     std::vector<std::unique_ptr<DemoMaterialBase>> materials;
 public:
-    Application() : skyMaterialHandle(assetManager) {}
+    explicit Application(const RendererSettings& settings = {}) : Renderer(settings), assetManager(deletionQueue), fallbackMaterialHandle(assetManager),
+        shaderWatcher(SlangCompiler::getSearchPaths()), skyMaterialHandle(assetManager) {}
+    // Releases the handles the renderer holds, before the asset manager is destroyed
+    ~Application();
 
 };
@@ -4,49 +4,37 @@
 
 #include "Buffer.hpp"
 
-#include "PhysicalDeviceHelper.hpp"
 #include "Renderer.hpp"
 
-Buffer::Buffer(const vk::raii::Device& device, const vk::raii::PhysicalDevice& physicalDevice, vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties)
-	: Buffer(createBuffer(device, physicalDevice, size, usage, properties))
+Buffer::Buffer(const vk::raii::Device& device, DeviceMemoryAllocator& allocator, vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties,
+               MemoryCategory category)
+	: Buffer(createBuffer(device, allocator, size, usage, properties, category))
 {
 }
 
 Buffer::Buffer(const Renderer& app, vk::DeviceSize size, vk::BufferUsageFlags usage,
-               vk::MemoryPropertyFlags properties)
-	: Buffer(app.device, app.physicalDevice, size, usage, properties)
+               vk::MemoryPropertyFlags properties, MemoryCategory category)
+	: Buffer(app.device, app.memoryAllocator, size, usage, properties, category)
 {
 }
 
-void Buffer::copyBufferToBuffer(const Renderer& app, const Buffer& source, const Buffer& destination, vk::DeviceSize size, vk::DeviceSize dstOffset, vk::DeviceSize srcOffset)
+void Buffer::copyBytesToBufferStaged(const Renderer& app, const std::span<const std::byte> source, const Buffer& destination, const vk::DeviceSize dstOffset)
 {
-	vk::raii::CommandBuffer commandBuffer{app.beginSingleTimeCommands()};
-
-	vk::BufferCopy copyRegion{srcOffset, dstOffset, size};
-
-	commandBuffer.copyBuffer(source.vkBuffer, destination.vkBuffer, copyRegion);
-
-	app.endSingleTimeCommands(std::move(commandBuffer));
+	app.uploadContext.copyToBuffer(destination, source, dstOffset);
 }
 
-Buffer::Buffer(vk::raii::Buffer&& buffer, vk::raii::DeviceMemory&& memory)
-	: vkBuffer(std::move(buffer)), memory(std::move(memory))
+Buffer::Buffer(vk::raii::Buffer&& buffer, DeviceAllocation&& allocation)
+	: vkBuffer(std::move(buffer)), allocation(std::move(allocation))
 {
 }
 
-Buffer Buffer::createBuffer(const vk::raii::Device& device, const vk::raii::PhysicalDevice& physicalDevice, vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties)
+Buffer Buffer::createBuffer(const vk::raii::Device& device, DeviceMemoryAllocator& allocator, vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties,
+                            MemoryCategory category)
 {
 	vk::BufferCreateInfo bufferCreateInfo{{}, size, usage, vk::SharingMode::eExclusive, nullptr};
 
 	vk::raii::Buffer buffer{device, bufferCreateInfo};
-	vk::MemoryRequirements memoryRequirements{buffer.getMemoryRequirements()};
-
-	vk::MemoryAllocateInfo memoryAllocateInfo{
-		memoryRequirements.size, findMemoryType(physicalDevice, memoryRequirements.memoryTypeBits, properties)
-	};
-	vk::raii::DeviceMemory memory{device.allocateMemory(memoryAllocateInfo)};
-
-	buffer.bindMemory(memory, 0);
+	DeviceAllocation allocation{allocator.allocateForBuffer(buffer, properties, category)};
 
-	return {std::move(buffer), std::move(memory)};
+	return {std::move(buffer), std::move(allocation)};
 }
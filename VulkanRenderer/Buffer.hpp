@@ -1,42 +1,46 @@
 #pragma once
 #include "VulkanBackend.hpp"
+#include "Renderer/DeviceMemoryAllocator.hpp"
 
 class Renderer;
 
 class Buffer
 {
 public:
-	Buffer(const vk::raii::Device& device, const vk::raii::PhysicalDevice& physicalDevice, vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties);
-	Buffer(const Renderer& app, vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties);
+	Buffer(const vk::raii::Device& device, DeviceMemoryAllocator& allocator, vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties,
+	       MemoryCategory category);
+	Buffer(const Renderer& app, vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties, MemoryCategory category);
 
 	template <typename T>
-	Buffer(const Renderer& app, const std::vector<T>& source, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties);
+	Buffer(const Renderer& app, const std::vector<T>& source, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties, MemoryCategory category);
 
 
 	vk::raii::Buffer vkBuffer;
-	vk::raii::DeviceMemory memory;
-
-	static void copyBufferToBuffer(const Renderer& app, const Buffer& source, const Buffer& destination, vk::DeviceSize size, vk::DeviceSize dstOffset = 0, vk::DeviceSize srcOffset = 0);
+	DeviceAllocation allocation; // Mapped if host visible
 
 	template <typename T>
 	static void copyVectorToBufferStaged(const Renderer& app, const std::vector<T>& source, const Buffer& destination);
 
+	// Recorded into the renderer's upload context. The copy is visible to frames submitted afterward
 	template <typename T>
-	static void copySpanToBufferStaged(const Renderer& app, const std::span<T>& source, const Buffer& destination, vk::DeviceSize dstOffset = 0, vk::DeviceSize srcOffset = 0);
+	static void copySpanToBufferStaged(const Renderer& app, const std::span<T>& source, const Buffer& destination, vk::DeviceSize dstOffset = 0);
 
 private:
-	Buffer(vk::raii::Buffer&& buffer, vk::raii::DeviceMemory&& memory);
+	Buffer(vk::raii::Buffer&& buffer, DeviceAllocation&& allocation);
+
+	static void copyBytesToBufferStaged(const Renderer& app, std::span<const std::byte> source, const Buffer& destination, vk::DeviceSize dstOffset);
 
-	static Buffer createBuffer(const vk::raii::Device& device, const vk::raii::PhysicalDevice& physicalDevice, vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties);
+	static Buffer createBuffer(const vk::raii::Device& device, DeviceMemoryAllocator& allocator, vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties,
+	                           MemoryCategory category);
 
 	template <typename T>
-	static Buffer createBuffer(const Renderer& app, const std::vector<T>& source, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties);
+	static Buffer createBuffer(const Renderer& app, const std::vector<T>& source, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties, MemoryCategory category);
 };
 
 template <typename T>
 Buffer::Buffer(const Renderer& app, const std::vector<T>& source, vk::BufferUsageFlags usage,
-               vk::MemoryPropertyFlags properties)
-	: Buffer(createBuffer(app, source, usage, properties))
+               vk::MemoryPropertyFlags properties, MemoryCategory category)
+	: Buffer(createBuffer(app, source, usage, properties, category))
 {
 }
 
@@ -47,26 +51,18 @@ void Buffer::copyVectorToBufferStaged(const Renderer& app, const std::vector<T>&
 }
 
 template<typename T>
-void Buffer::copySpanToBufferStaged(const Renderer &app, const std::span<T> &source, const Buffer &destination, vk::DeviceSize dstOffset, vk::DeviceSize srcOffset)
+void Buffer::copySpanToBufferStaged(const Renderer &app, const std::span<T> &source, const Buffer &destination, vk::DeviceSize dstOffset)
 {
-	const VkDeviceSize bufferSize = sizeof(T) * source.size();
-
-	Buffer stagingBuffer{app, bufferSize, vk::BufferUsageFlagBits::eTransferSrc, vk::MemoryPropertyFlagBits::eHostCoherent | vk::MemoryPropertyFlagBits::eHostVisible};
-
-	void* data{stagingBuffer.memory.mapMemory(0, bufferSize, {})};
-	std::memcpy(data, source.data(), bufferSize);
-	stagingBuffer.memory.unmapMemory();
-
-	copyBufferToBuffer(app, stagingBuffer, destination, bufferSize, dstOffset, srcOffset);
+	copyBytesToBufferStaged(app, std::as_bytes(source), destination, dstOffset);
 }
 
 template <typename T>
 Buffer Buffer::createBuffer(const Renderer& app, const std::vector<T>& source,
-                            vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties)
+                            vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties, MemoryCategory category)
 {
 	const VkDeviceSize size = sizeof(T) * source.size();
 
-	Buffer buffer{app, size, vk::BufferUsageFlagBits::eTransferDst | usage, properties};
+	Buffer buffer{app, size, vk::BufferUsageFlagBits::eTransferDst | usage, properties, category};
 	copyVectorToBufferStaged(app, source, buffer);
 	return buffer;
 }
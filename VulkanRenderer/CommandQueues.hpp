@@ -11,19 +11,60 @@ struct QueueFamilyIndices
 {
     std::optional<uint32_t> graphicsFamily;
     std::optional<uint32_t> presentFamily;
+    // A family that can transfer but not render. Empty if the device has none, uploads then run on the graphics queue
+    std::optional<uint32_t> transferFamily;
 
-    [[nodiscard]] bool isComplete() const
+    // Offscreen rendering does not need a present family
+    [[nodiscard]] bool isComplete(const bool requirePresent = true) const
     {
-        return graphicsFamily.has_value() && presentFamily.has_value();
+        return graphicsFamily.has_value() && (presentFamily.has_value() || !requirePresent);
     }
 };
 
+// Prefers a family without compute, which usually is the copy engine of the GPU
+inline std::optional<uint32_t> findDedicatedTransferFamily(const std::vector<vk::QueueFamilyProperties>& queueFamilies)
+{
+    std::optional<uint32_t> transferFamily;
+    for (const auto& [i, queueFamily] : queueFamilies | std::ranges::views::enumerate)
+    {
+        if (!(queueFamily.queueFlags & vk::QueueFlagBits::eTransfer) || (queueFamily.queueFlags & vk::QueueFlagBits::eGraphics))
+        {
+            continue;
+        }
+        if (!(queueFamily.queueFlags & vk::QueueFlagBits::eCompute))
+        {
+            return static_cast<uint32_t>(i);
+        }
+        if (!transferFamily)
+        {
+            transferFamily = static_cast<uint32_t>(i);
+        }
+    }
+    return transferFamily;
+}
+
 inline QueueFamilyIndices findQueueFamilies(const vk::PhysicalDevice& device, const vk::SurfaceKHR& surface)
 {
     QueueFamilyIndices indices;
 
     std::vector<vk::QueueFamilyProperties> queueFamilies(device.getQueueFamilyProperties());
 
+    indices.transferFamily = findDedicatedTransferFamily(queueFamilies);
+
+    // Without a surface, we only need a graphics queue
+    if (!surface)
+    {
+        for (const auto& [i, queueFamily] : queueFamilies | std::ranges::views::enumerate)
+        {
+            if (queueFamily.queueFlags & vk::QueueFlagBits::eGraphics)
+            {
+                indices.graphicsFamily = static_cast<uint32_t>(i);
+                break;
+            }
+        }
+        return indices;
+    }
+
     // First try to find a queue with graphics and present capabilities
     auto idealFamilies{queueFamilies | std::ranges::views::enumerate | std::ranges::views::filter([&](const auto& indexedQueueFamily)
     {
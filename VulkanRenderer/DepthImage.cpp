@@ -2,9 +2,9 @@
 
 #include "PhysicalDeviceHelper.hpp"
 
-DepthImage::DepthImage(const vk::raii::Device& device, const vk::PhysicalDevice& physicalDevice, vk::Extent2D swapchainExtent)
-	: Image(device, physicalDevice, swapchainExtent.width, swapchainExtent.height, findDepthFormat(physicalDevice), vk::ImageTiling::eOptimal, vk::ImageUsageFlagBits::eDepthStencilAttachment,
-	        vk::MemoryPropertyFlagBits::eDeviceLocal, vk::ImageAspectFlagBits::eDepth)
+DepthImage::DepthImage(const vk::raii::Device& device, const vk::PhysicalDevice& physicalDevice, DeviceMemoryAllocator& allocator, vk::Extent2D swapchainExtent)
+	: Image(device, allocator, swapchainExtent.width, swapchainExtent.height, findDepthFormat(physicalDevice), vk::ImageTiling::eOptimal, vk::ImageUsageFlagBits::eDepthStencilAttachment,
+	        vk::MemoryPropertyFlagBits::eDeviceLocal, MemoryCategory::RenderTarget, vk::ImageAspectFlagBits::eDepth)
 {
 }
 
@@ -4,7 +4,7 @@
 class DepthImage : public Image
 {
 public:
-	DepthImage(const vk::raii::Device& device, const vk::PhysicalDevice& physicalDevice, vk::Extent2D swapchainExtent);
+	DepthImage(const vk::raii::Device& device, const vk::PhysicalDevice& physicalDevice, DeviceMemoryAllocator& allocator, vk::Extent2D swapchainExtent);
 
 	static vk::Format findDepthFormat(const vk::PhysicalDevice& physicalDevice);
 };
@@ -9,6 +9,14 @@ const std::vector<const char*> deviceExtensions = {
     VK_KHR_SWAPCHAIN_EXTENSION_NAME
 };
 
+// Offscreen rendering does not present, so it does not need the swapchain extension
+const std::vector<const char*> headlessDeviceExtensions = {};
+
+inline const std::vector<const char*>& getDeviceExtensions(const bool presentable)
+{
+    return presentable ? deviceExtensions : headlessDeviceExtensions;
+}
+
 struct SwapChainSupportDetails
 {
     vk::SurfaceCapabilitiesKHR capabilities;
@@ -16,11 +24,11 @@ struct SwapChainSupportDetails
     std::vector<vk::PresentModeKHR> presentModes;
 };
 
-inline bool CheckDeviceExtensionSupport(const vk::PhysicalDevice& physicalDevice)
+inline bool CheckDeviceExtensionSupport(const vk::PhysicalDevice& physicalDevice, const std::vector<const char*>& extensions)
 {
     std::vector<vk::ExtensionProperties> availableExtensions(physicalDevice.enumerateDeviceExtensionProperties());
 
-    std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
+    std::set<std::string> requiredExtensions(extensions.begin(), extensions.end());
 
     for (const auto& extension : availableExtensions) // TODO: Set difference is probably better
     {
@@ -30,6 +38,12 @@ inline bool CheckDeviceExtensionSupport(const vk::PhysicalDevice& physicalDevice
     return requiredExtensions.empty();
 }
 
+// Optional, enabled when available. Reports how much memory of each heap the process uses and may use
+inline bool supportsMemoryBudget(const vk::PhysicalDevice& physicalDevice)
+{
+    return CheckDeviceExtensionSupport(physicalDevice, {VK_EXT_MEMORY_BUDGET_EXTENSION_NAME});
+}
+
 inline SwapChainSupportDetails querySwapChainSupport(const vk::PhysicalDevice& device, const vk::SurfaceKHR& surface)
 {
     return SwapChainSupportDetails{
@@ -0,0 +1,95 @@
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "Application.hpp"
+
+// Renders the demo scene without a window, e.g. on machines without a display
+// Usage: VulkanRendererHeadless [--frames N] [--output DIRECTORY] [--width W] [--height H] [--threads N] [--compile-threads N] [--profile-csv FILE] [--memory-report FILE] [--residency-budget MIB] [--shader-cache DIRECTORY] [--pipeline-cache FILE] [--gpu-driven]
+int main(int argc, char* argv[])
+{
+	try
+	{
+		RendererSettings settings{};
+		settings.headless = true;
+
+		uint32_t frameCount{100};
+		std::optional<std::filesystem::path> outputDirectory{};
+
+		for (int i = 1; i < argc; ++i)
+		{
+			const std::string_view argument{argv[i]};
+			if (argument == "--gpu-driven")
+			{
+				settings.gpuDriven = true;
+				continue;
+			}
+			if (i + 1 >= argc)
+			{
+				throw std::runtime_error("Missing value for argument " + std::string{argument});
+			}
+
+			const std::string value{argv[++i]};
+			if (argument == "--frames")
+			{
+				frameCount = static_cast<uint32_t>(std::stoul(value));
+			}
+			else if (argument == "--output")
+			{
+				outputDirectory = value;
+			}
+			else if (argument == "--width")
+			{
+				settings.extent.width = static_cast<uint32_t>(std::stoul(value));
+			}
+			else if (argument == "--height")
+			{
+				settings.extent.height = static_cast<uint32_t>(std::stoul(value));
+			}
+			else if (argument == "--threads")
+			{
+				settings.recordingThreadCount = static_cast<uint32_t>(std::stoul(value));
+			}
+			else if (argument == "--compile-threads")
+			{
+				settings.compileThreadCount = static_cast<uint32_t>(std::stoul(value));
+			}
+			else if (argument == "--profile-csv")
+			{
+				settings.profilerCsvPath = value;
+			}
+			else if (argument == "--memory-report")
+			{
+				settings.memoryReportPath = value;
+			}
+			else if (argument == "--residency-budget")
+			{
+				settings.residencyBudget = vk::DeviceSize{std::stoull(value)} * 1024 * 1024;
+			}
+			else if (argument == "--shader-cache")
+			{
+				settings.shaderCachePath = value;
+			}
+			else if (argument == "--pipeline-cache")
+			{
+				settings.pipelineCachePath = value;
+			}
+			else
+			{
+				throw std::runtime_error("Unknown argument " + std::string{argument});
+			}
+		}
+
+		Application app{settings};
+		app.runHeadless(frameCount, outputDirectory);
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
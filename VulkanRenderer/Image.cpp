@@ -2,18 +2,19 @@
 
 #include <ranges>
 
-#include "PhysicalDeviceHelper.hpp"
 #include "Renderer.hpp"
+#include "Renderer/BarrierBatcher.hpp"
 
-Image::Image(const vk::raii::Device& device, const vk::PhysicalDevice& physicalDevice, uint32_t width, uint32_t height, vk::Format format, vk::ImageTiling tiling, vk::ImageUsageFlags usage,
-             vk::MemoryPropertyFlags properties,
+Image::Image(const vk::raii::Device& device, DeviceMemoryAllocator& allocator, uint32_t width, uint32_t height, vk::Format format, vk::ImageTiling tiling, vk::ImageUsageFlags usage,
+             vk::MemoryPropertyFlags properties, const MemoryCategory category,
              vk::ImageAspectFlags aspectFlags, uint32_t mipLevels, const vk::ImageViewType viewType)
-	: Image(createImage(device, physicalDevice, width, height, format, tiling, usage, properties, aspectFlags, mipLevels, viewType))
+	: Image(createImage(device, allocator, width, height, format, tiling, usage, properties, category, aspectFlags, mipLevels, viewType))
 {
 }
 
-Image Image::createImage(const vk::raii::Device& device, const vk::PhysicalDevice& physicalDevice, uint32_t width, uint32_t height, vk::Format format, vk::ImageTiling tiling,
-                         vk::ImageUsageFlags usage, vk::MemoryPropertyFlags properties, vk::ImageAspectFlags aspectFlags, uint32_t mipLevels, const vk::ImageViewType viewType)
+Image Image::createImage(const vk::raii::Device& device, DeviceMemoryAllocator& allocator, uint32_t width, uint32_t height, vk::Format format, vk::ImageTiling tiling,
+                         vk::ImageUsageFlags usage, vk::MemoryPropertyFlags properties, const MemoryCategory category, vk::ImageAspectFlags aspectFlags, uint32_t mipLevels,
+                         const vk::ImageViewType viewType)
 {
 	const bool isCube{viewType == vk::ImageViewType::eCube || viewType == vk::ImageViewType::eCubeArray};
 	const vk::ImageCreateFlags createFlags{isCube ? vk::ImageCreateFlagBits::eCubeCompatible : vk::ImageCreateFlags{}};
@@ -23,17 +24,11 @@ Image Image::createImage(const vk::raii::Device& device, const vk::PhysicalDevic
 		vk::ImageLayout::eUndefined
 	};
 	vk::raii::Image image{device, imageCreateInfo};
-
-	vk::MemoryRequirements memoryRequirements{image.getMemoryRequirements()};
-	vk::MemoryAllocateInfo memoryAllocateInfo{memoryRequirements.size, findMemoryType(physicalDevice, memoryRequirements.memoryTypeBits, properties)};
-
-	vk::raii::DeviceMemory imageMemory{device, memoryAllocateInfo};
-
-	image.bindMemory(imageMemory, 0);
+	DeviceAllocation allocation{allocator.allocateForImage(image, tiling, properties, category)};
 
 	vk::raii::ImageView imageView{createImageView(device, image, format, aspectFlags, mipLevels, viewType)};
 
-	return Image{(std::move(image)), (std::move(imageMemory)), std::move(imageView), width, height, mipLevels, viewType};
+	return Image{(std::move(image)), (std::move(allocation)), std::move(imageView), width, height, mipLevels, viewType, aspectFlags};
 }
 
 vk::raii::ImageView Image::createImageView(const vk::raii::Device& device, const vk::Image& image, const vk::Format format, const vk::ImageAspectFlags aspectFlags, const uint32_t mipLevels,
@@ -60,78 +55,66 @@ std::vector<vk::raii::ImageView> Image::createImageViews(const vk::raii::Device&
 	return {imageViews.begin(), imageViews.end()};
 }
 
-void Image::transitionImageLayout(const Renderer& app, vk::Format format, vk::ImageLayout oldLayout, vk::ImageLayout newLayout, uint32_t mipLevels) const
+void Image::transition(BarrierBatcher& barriers, const vk::ImageLayout layout, const vk::PipelineStageFlags2 stages, const vk::AccessFlags2 access,
+                       const vk::ImageSubresourceRange& range) const
 {
-	vk::raii::CommandBuffer commandBuffer{app.beginSingleTimeCommands()};
-
-	vk::PipelineStageFlags sourceStage;
-	vk::PipelineStageFlags destinationStage;
-
-	const bool isCube{imageViewType == vk::ImageViewType::eCube || imageViewType == vk::ImageViewType::eCubeArray};
-	const unsigned arrayLayers{isCube ? 6u : 1u};
+	const uint32_t arrayLayers{getArrayLayerCount()};
+	const uint32_t levelCount{range.levelCount == vk::RemainingMipLevels ? mipLevels - range.baseMipLevel : range.levelCount};
+	const uint32_t layerCount{range.layerCount == vk::RemainingArrayLayers ? arrayLayers - range.baseArrayLayer : range.layerCount};
+	const bool isWrite{isWriteAccess(access)};
 
-	vk::ImageMemoryBarrier barrier{
-		{}, {}, oldLayout, newLayout, vk::QueueFamilyIgnored, vk::QueueFamilyIgnored, image,
-		vk::ImageSubresourceRange{vk::ImageAspectFlagBits::eColor, 0, mipLevels, 0, arrayLayers}
-	};
-
-	if (newLayout == vk::ImageLayout::eDepthStencilAttachmentOptimal)
+	for (uint32_t mipLevel = range.baseMipLevel; mipLevel < range.baseMipLevel + levelCount; ++mipLevel)
 	{
-		barrier.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eDepth;
-
-		if (hasStencilComponent(format))
+		for (uint32_t arrayLayer = range.baseArrayLayer; arrayLayer < range.baseArrayLayer + layerCount; ++arrayLayer)
 		{
-			barrier.subresourceRange.aspectMask |= vk::ImageAspectFlagBits::eStencil;
-		}
-	}
-	else
-	{
-		barrier.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
-	}
-
-	if (oldLayout == vk::ImageLayout::eUndefined && newLayout == vk::ImageLayout::eTransferDstOptimal)
-	{
-		barrier.srcAccessMask = {};
-		barrier.dstAccessMask = vk::AccessFlagBits::eTransferWrite;
+			ImageSubresourceState& state{subresourceStates[mipLevel * arrayLayers + arrayLayer]};
+			const bool changesLayout{state.layout != layout};
+			const bool isVisible{(stages & ~state.readStages) == vk::PipelineStageFlags2{} && (access & ~state.readAccess) == vk::AccessFlags2{}};
 
-		sourceStage = vk::PipelineStageFlagBits::eTopOfPipe;
-		destinationStage = vk::PipelineStageFlagBits::eTransfer;
-	}
-	else if (oldLayout == vk::ImageLayout::eTransferDstOptimal && newLayout == vk::ImageLayout::eShaderReadOnlyOptimal)
-	{
-		barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
-		barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
-
-		sourceStage = vk::PipelineStageFlagBits::eTransfer;
-		destinationStage = vk::PipelineStageFlagBits::eFragmentShader;
-	}
-	else if (oldLayout == vk::ImageLayout::eUndefined && newLayout == vk::ImageLayout::eDepthStencilAttachmentOptimal)
-	{
-		barrier.srcAccessMask = {};
-		barrier.dstAccessMask = vk::AccessFlagBits::eDepthStencilAttachmentRead | vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+			// Layout transitions and writes wait for all earlier accesses, reads only for the last write
+			const bool hasEarlierAccess{(state.writeStages | state.readStages) != vk::PipelineStageFlags2{}};
+			if (changesLayout || (isWrite && hasEarlierAccess))
+			{
+				barriers.addImageBarrier(vk::ImageMemoryBarrier2{
+					state.writeStages | state.readStages, state.writeAccess, stages, access, state.layout, layout, vk::QueueFamilyIgnored, vk::QueueFamilyIgnored, image,
+					vk::ImageSubresourceRange{range.aspectMask, mipLevel, 1, arrayLayer, 1}
+				});
+			}
+			else if (state.writeStages != vk::PipelineStageFlags2{} && !isVisible)
+			{
+				barriers.addImageBarrier(vk::ImageMemoryBarrier2{
+					state.writeStages, state.writeAccess, stages, access, layout, layout, vk::QueueFamilyIgnored, vk::QueueFamilyIgnored, image,
+					vk::ImageSubresourceRange{range.aspectMask, mipLevel, 1, arrayLayer, 1}
+				});
+			}
 
-		sourceStage = vk::PipelineStageFlagBits::eTopOfPipe;
-		destinationStage = vk::PipelineStageFlagBits::eEarlyFragmentTests;
-	}
-	else
-	{
-		throw std::runtime_error("Failed to transition image layout: Unsupported layout transition");
+			if (isWrite)
+			{
+				state = ImageSubresourceState{layout, stages, access, {}, {}};
+			}
+			else if (changesLayout)
+			{
+				// The transition is a write that is only visible to the stages of this barrier
+				state = ImageSubresourceState{layout, stages, {}, stages, access};
+			}
+			else
+			{
+				state.readStages |= stages;
+				state.readAccess |= access;
+			}
+		}
 	}
-
-	commandBuffer.pipelineBarrier(sourceStage, destinationStage, {}, nullptr, nullptr, barrier);
-
-	app.endSingleTimeCommands(std::move(commandBuffer));
 }
 
-void Image::copyBufferToImage(const Renderer& app, vk::Buffer buffer, vk::Image image, uint32_t width, uint32_t height, uint32_t layerCount)
+uint32_t Image::getArrayLayerCount() const
 {
-	vk::raii::CommandBuffer commandBuffer{app.beginSingleTimeCommands()};
-
-	vk::BufferImageCopy copyRegion{0, 0, 0, vk::ImageSubresourceLayers{vk::ImageAspectFlagBits::eColor, 0, 0, layerCount}, vk::Offset3D{0, 0, 0}, vk::Extent3D{width, height, 1}};
-
-	commandBuffer.copyBufferToImage(buffer, image, vk::ImageLayout::eTransferDstOptimal, copyRegion);
+	const bool isCube{imageViewType == vk::ImageViewType::eCube || imageViewType == vk::ImageViewType::eCubeArray};
+	return isCube ? 6u : 1u;
+}
 
-	app.endSingleTimeCommands(std::move(commandBuffer));
+vk::ImageSubresourceRange Image::getSubresourceRange(const uint32_t baseMipLevel, const uint32_t levelCount) const
+{
+	return vk::ImageSubresourceRange{aspectMask, baseMipLevel, levelCount, 0, getArrayLayerCount()};
 }
 
 bool Image::hasStencilComponent(vk::Format format)
@@ -156,8 +139,19 @@ void Image::copyCubemapSide(void* dstData, const void* srcData, CubemapSide side
 	}
 }
 
-Image::Image(vk::raii::Image&& image, vk::raii::DeviceMemory&& imageMemory, vk::raii::ImageView&& imageView, uint32_t width, uint32_t height, uint32_t mipLevels, const vk::ImageViewType viewType) :
-	width(width), height(height), mipLevels(mipLevels), imageViewType(viewType),
-	image(std::move(image)), imageDeviceMemory(std::move(imageMemory)), imageView(std::move(imageView))
+Image::Image(vk::raii::Image&& image, DeviceAllocation&& allocation, vk::raii::ImageView&& imageView, uint32_t width, uint32_t height, uint32_t mipLevels, const vk::ImageViewType viewType,
+             const vk::ImageAspectFlags aspectMask) :
+	width(width), height(height), mipLevels(mipLevels), imageViewType(viewType), aspectMask(aspectMask),
+	image(std::move(image)), allocation(std::move(allocation)), imageView(std::move(imageView)),
+	subresourceStates(static_cast<size_t>(mipLevels) * getArrayLayerCount())
 {
 }
+
+bool Image::isWriteAccess(const vk::AccessFlags2 access)
+{
+	constexpr vk::AccessFlags2 writeAccessMask{
+		vk::AccessFlagBits2::eShaderWrite | vk::AccessFlagBits2::eShaderStorageWrite | vk::AccessFlagBits2::eColorAttachmentWrite |
+		vk::AccessFlagBits2::eDepthStencilAttachmentWrite | vk::AccessFlagBits2::eTransferWrite | vk::AccessFlagBits2::eHostWrite | vk::AccessFlagBits2::eMemoryWrite
+	};
+	return static_cast<bool>(access & writeAccessMask);
+}
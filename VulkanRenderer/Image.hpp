@@ -1,6 +1,9 @@
 ﻿#pragma once
 
+#include <vector>
+
 #include "VulkanBackend.hpp"
+#include "Renderer/DeviceMemoryAllocator.hpp"
 
 enum class CubemapSide : uint8_t
 {
@@ -12,38 +15,63 @@ enum class CubemapSide : uint8_t
 	Left
 };
 
+class BarrierBatcher;
 class Renderer;
 
+// Last accesses of an image subresource, which the next access has to wait for
+struct ImageSubresourceState
+{
+	vk::ImageLayout layout{vk::ImageLayout::eUndefined};
+	// Last write, or the last layout transition with an empty access mask
+	vk::PipelineStageFlags2 writeStages{vk::PipelineStageFlagBits2::eNone};
+	vk::AccessFlags2 writeAccess{vk::AccessFlagBits2::eNone};
+	// Reads since then that the write is already visible to
+	vk::PipelineStageFlags2 readStages{vk::PipelineStageFlagBits2::eNone};
+	vk::AccessFlags2 readAccess{vk::AccessFlagBits2::eNone};
+};
+
 class Image
 {
 public:
-	Image(const vk::raii::Device &device, const vk::PhysicalDevice& physicalDevice, uint32_t width, uint32_t height, vk::Format format, vk::ImageTiling tiling, vk::ImageUsageFlags usage,
-	      vk::MemoryPropertyFlags properties, vk::ImageAspectFlags aspectFlags, uint32_t mipLevels = 1, vk::ImageViewType viewType = vk::ImageViewType::e2D);
+	Image(const vk::raii::Device &device, DeviceMemoryAllocator& allocator, uint32_t width, uint32_t height, vk::Format format, vk::ImageTiling tiling, vk::ImageUsageFlags usage,
+	      vk::MemoryPropertyFlags properties, MemoryCategory category, vk::ImageAspectFlags aspectFlags, uint32_t mipLevels = 1,
+	      vk::ImageViewType viewType = vk::ImageViewType::e2D);
 
 	uint32_t width;
 	uint32_t height;
 	uint32_t mipLevels;
 	vk::ImageViewType imageViewType;
+	vk::ImageAspectFlags aspectMask;
 
 	vk::raii::Image image{VK_NULL_HANDLE};
-	vk::raii::DeviceMemory imageDeviceMemory{VK_NULL_HANDLE};
+	DeviceAllocation allocation;
 	vk::raii::ImageView imageView{VK_NULL_HANDLE};
 
-	void transitionImageLayout(const Renderer &app, vk::Format format, vk::ImageLayout oldLayout, vk::ImageLayout newLayout, uint32_t mipLevels = 1) const;
+	// Adds the barriers that the subresources in range need before an access in layout to barriers, and records the access as their last one
+	// Reads that the last write is already visible to need no barrier. The barriers have to be flushed before the access is recorded
+	void transition(BarrierBatcher& barriers, vk::ImageLayout layout, vk::PipelineStageFlags2 stages, vk::AccessFlags2 access, const vk::ImageSubresourceRange& range) const;
+
+	[[nodiscard]] uint32_t getArrayLayerCount() const;
+	[[nodiscard]] vk::ImageSubresourceRange getSubresourceRange(uint32_t baseMipLevel = 0, uint32_t levelCount = vk::RemainingMipLevels) const;
 
 	static vk::raii::ImageView createImageView(const vk::raii::Device &device, const vk::Image& image, vk::Format format, vk::ImageAspectFlags aspectFlags, uint32_t mipLevels = 1, vk::ImageViewType viewType = vk::ImageViewType::e2D);
 	static std::vector<vk::raii::ImageView> createImageViews(const vk::raii::Device &device, const std::vector<vk::Image> &images, vk::Format format,
 	                                                         vk::ImageAspectFlags aspectFlags, uint32_t mipLevels = 1);
 
-	static void copyBufferToImage(const Renderer &app, vk::Buffer buffer, vk::Image image, uint32_t width, uint32_t height, uint32_t layerCount = 1);
-
 	static bool hasStencilComponent(vk::Format format);
 
 	static void copyCubemapSide(void* dstData, const void* srcData, CubemapSide side, vk::DeviceSize imageSideSize, int sideWidth, int coordinateX, int coordinateY);
 
 private:
-	Image(vk::raii::Image &&image, vk::raii::DeviceMemory &&imageMemory, vk::raii::ImageView &&imageView, uint32_t width, uint32_t height, uint32_t mipLevels, vk::ImageViewType viewType);
+	// Indexed by mip level * array layer count + array layer. Commands are recorded in the order they run, so the last recorded access is the last one
+	mutable std::vector<ImageSubresourceState> subresourceStates;
+
+	Image(vk::raii::Image &&image, DeviceAllocation &&allocation, vk::raii::ImageView &&imageView, uint32_t width, uint32_t height, uint32_t mipLevels, vk::ImageViewType viewType,
+	      vk::ImageAspectFlags aspectMask);
+
+	static bool isWriteAccess(vk::AccessFlags2 access);
 
-	static Image createImage(const vk::raii::Device& device, const vk::PhysicalDevice& physicalDevice, uint32_t width, uint32_t height, vk::Format format, vk::ImageTiling tiling,
-	                         vk::ImageUsageFlags usage, vk::MemoryPropertyFlags properties, vk::ImageAspectFlags aspectFlags, uint32_t mipLevels = 1, vk::ImageViewType viewType = vk::ImageViewType::e2D);
+	static Image createImage(const vk::raii::Device& device, DeviceMemoryAllocator& allocator, uint32_t width, uint32_t height, vk::Format format, vk::ImageTiling tiling,
+	                         vk::ImageUsageFlags usage, vk::MemoryPropertyFlags properties, MemoryCategory category, vk::ImageAspectFlags aspectFlags, uint32_t mipLevels = 1,
+	                         vk::ImageViewType viewType = vk::ImageViewType::e2D);
 };
@@ -4,22 +4,39 @@
 #include "DeviceExtensions.hpp"
 #include "VulkanBackend.hpp"
 
+// A null surface checks for offscreen rendering only
 inline bool isDeviceSuitableForSurface(const vk::PhysicalDevice& physDevice, const vk::SurfaceKHR& surface)
 {
-    vk::PhysicalDeviceFeatures deviceFeatures{physDevice.getFeatures()};
+    const auto features{physDevice.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan11Features, vk::PhysicalDeviceVulkan13Features>()};
+    const vk::PhysicalDeviceFeatures& deviceFeatures{features.get<vk::PhysicalDeviceFeatures2>().features};
+    // SV_InstanceID is relative to the first instance, which needs the draw parameters
+    const bool drawParametersSupported{static_cast<bool>(features.get<vk::PhysicalDeviceVulkan11Features>().shaderDrawParameters)};
+    // The render graph needs both
+    const vk::PhysicalDeviceVulkan13Features& features13{features.get<vk::PhysicalDeviceVulkan13Features>()};
+    const bool renderGraphSupported{features13.synchronization2 && features13.dynamicRendering};
+
+    const bool presentable{static_cast<bool>(surface)};
 
     QueueFamilyIndices queueFamilyIndices{findQueueFamilies(physDevice, surface)};
 
-    bool extensionsSupported{CheckDeviceExtensionSupport(physDevice)};
+    bool extensionsSupported{CheckDeviceExtensionSupport(physDevice, getDeviceExtensions(presentable))};
 
-    bool swapChainAdequate{false};
-    if (extensionsSupported)
+    bool swapChainAdequate{!presentable};
+    if (presentable && extensionsSupported)
     {
         SwapChainSupportDetails swapChainSupport = querySwapChainSupport(physDevice, surface);
         swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
     }
 
-    return queueFamilyIndices.isComplete() && extensionsSupported && swapChainAdequate && deviceFeatures.samplerAnisotropy;
+    return queueFamilyIndices.isComplete(presentable) && extensionsSupported && swapChainAdequate && deviceFeatures.samplerAnisotropy && drawParametersSupported && renderGraphSupported;
+}
+
+// Features needed by GPU-driven rendering: Indirect draws with count
+inline bool supportsGpuDrivenRendering(const vk::PhysicalDevice& physDevice)
+{
+    const auto features{physDevice.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan12Features>()};
+
+    return features.get<vk::PhysicalDeviceFeatures2>().features.multiDrawIndirect && features.get<vk::PhysicalDeviceVulkan12Features>().drawIndirectCount;
 }
 
 inline std::optional<vk::Format> findSupportedFormat(const vk::PhysicalDevice& physicalDevice, const std::vector<vk::Format>& candidates, vk::ImageTiling tiling, vk::FormatFeatureFlags features)
@@ -39,17 +56,4 @@ inline std::optional<vk::Format> findSupportedFormat(const vk::PhysicalDevice& p
     }
 
     return {};
-}
-
-inline uint32_t findMemoryType(const vk::PhysicalDevice& physicalDevice, uint32_t typeBits, vk::MemoryPropertyFlags properties) {
-	vk::PhysicalDeviceMemoryProperties physicalMemoryProperties{physicalDevice.getMemoryProperties()};
-
-	for (uint32_t i = 0; i < physicalMemoryProperties.memoryTypeCount; ++i) {
-		if ((typeBits & (1 << i)) && (physicalMemoryProperties.memoryTypes[i].propertyFlags & properties) ==
-			properties) {
-			return i;
-			}
-	}
-
-	throw std::runtime_error("Failed to find suitable memory type!");
 }
\ No newline at end of file
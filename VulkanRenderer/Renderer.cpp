@@ -1,9 +1,11 @@
 ﻿#include "Renderer.hpp"
 
+#include <algorithm>
 #include <imgui.h>
 #include <iostream>
-#include <ranges>
 #include <set>
+#include <span>
+#include <thread>
 #include <backends/imgui_impl_vulkan.h>
 
 #include "DepthImage.hpp"
@@ -13,81 +15,99 @@
 #include "Asset/Material.hpp"
 #include "Asset/MaterialInstance.hpp"
 #include "Renderer/RenderSync.hpp"
+#include "Renderer/ResidencyBlob.hpp"
 #include "Scene/Camera.hpp"
 #include "Scene/Model.hpp"
 #include "Scene/Scene.hpp"
+#include "ShaderCompilation/PushConstantObject.hpp"
 #include "ShaderCompilation/ShaderCursor.hpp"
 
 using namespace std::placeholders;
 
-Renderer::Renderer()
-	: context(),
-	  instance(createInstance(context)),
+Renderer::Renderer(const RendererSettings& settings)
+	: settings(settings),
+	  context(),
+	  instance(createInstance(context, settings.headless)),
 	  debugMessenger(createDebugMessenger(instance)),
-	  window(1600, 1200, [this](const int width, const int height) { onFrameBufferResized(width, height); }),
-	  surface(window.createWindowSurface(instance)),
+	  window(createWindow()),
+	  surface(window ? window->createWindowSurface(instance) : vk::raii::SurfaceKHR{nullptr}),
 	  physicalDevice(pickPhysicalDevice(instance, surface)),
 	  queueIndices(findQueueFamilies(physicalDevice, surface)),
-	  device(createLogicalDevice(physicalDevice, queueIndices)),
+	  device(createLogicalDevice(physicalDevice, queueIndices, settings.gpuDriven)),
+	  memoryAllocator(device, physicalDevice),
+	  uniformArena(device, memoryAllocator, physicalDevice.getProperties().limits.minUniformBufferOffsetAlignment),
+	  residencyManager(maxFramesInFlight, getResidencyBudget()),
+	  deletionQueue(maxFramesInFlight),
 	  graphicsQueue(device.getQueue(queueIndices.graphicsFamily.value(), 0)),
-	  presentQueue(device.getQueue(queueIndices.presentFamily.value(), 0)),
-	  swapchain(device, physicalDevice, surface, window, queueIndices),
-	  depthImage(device, physicalDevice, swapchain.extent),
-	  renderPass(createRenderPass(device, physicalDevice, swapchain)),
-	  commandPool(createCommandPool(device, queueIndices)),
-	  commandBuffers(device.allocateCommandBuffers({commandPool, vk::CommandBufferLevel::ePrimary, maxFramesInFlight})),
-	  swapChainFramebuffers(createFramebuffers(device, renderPass, depthImage.imageView, swapchain.imageViews, swapchain.extent)),
+	  presentQueue(queueIndices.presentFamily ? device.getQueue(queueIndices.presentFamily.value(), 0) : vk::raii::Queue{nullptr}),
+	  transferQueue(queueIndices.transferFamily ? device.getQueue(queueIndices.transferFamily.value(), 0) : vk::raii::Queue{nullptr}),
+	  swapchain(window ? std::optional<Swapchain>{std::in_place, device, physicalDevice, surface, *window, queueIndices} : std::nullopt),
+	  offscreenTargets(window ? std::vector<OffscreenTarget>{} : createOffscreenTargets(device, memoryAllocator, settings.extent, maxFramesInFlight)),
+	  depthFormat(DepthImage::findDepthFormat(physicalDevice)),
+	  uploadContext(device, memoryAllocator, graphicsQueue, queueIndices.graphicsFamily.value(), queueIndices.transferFamily ? transferQueue : graphicsQueue,
+	                queueIndices.transferFamily.value_or(queueIndices.graphicsFamily.value())),
+	  frameAllocator(maxFramesInFlight),
+	  frameCommandPools(createFrameCommandPools(device, queueIndices, maxFramesInFlight)),
+	  commandBuffers(allocateFrameCommandBuffers(device, frameCommandPools, vk::CommandBufferLevel::ePrimary)),
+	  overlayCommandBuffers(allocateFrameCommandBuffers(device, frameCommandPools, vk::CommandBufferLevel::eSecondary)),
 	  renderSyncObjects(createSyncObjects(device, maxFramesInFlight)),
+	  commandRecorder(device, queueIndices.graphicsFamily.value(), maxFramesInFlight, getRecordingThreadCount()),
+	  gpuProfiler(device, physicalDevice, queueIndices.graphicsFamily.value(), maxFramesInFlight),
 	  compiler(),
-	  imGui(initImGUI())
+	  spirvCache(settings.shaderCachePath),
+	  pipelineCache(device, physicalDevice, settings.pipelineCachePath),
+	  materialCompiler(*this, getCompileThreadCount()),
+	  imGui(initImGUI()),
+	  instanceBuffer(*this),
+	  gpuScene(createGpuScene()),
+	  renderGraph(*this)
 {
-}
+	// Blobs of crashed renderers are never removed otherwise
+	ResidencyBlob::removeStaleFiles();
 
-void Renderer::recreateSwapchain()
-{
-	auto framebufferSize{window.getFramebufferSize()};
-	while (framebufferSize.x == 0 && framebufferSize.y == 0) // TODO: This is ugly
+	if (settings.profilerCsvPath)
 	{
-		// We are minimized, just wait
-		framebufferSize = window.getFramebufferSize();
-		Window::waitEvents();
+		gpuProfiler.startCsvCapture(*settings.profilerCsvPath);
 	}
-
-	device.waitIdle();
-
-	swapchain = Swapchain{device, physicalDevice, surface, window, queueIndices, swapchain.swapchain};
-	depthImage = DepthImage{device, physicalDevice, swapchain.extent};
-	swapChainFramebuffers = createFramebuffers(device, renderPass, depthImage.imageView, swapchain.imageViews, swapchain.extent);
-	// TODO: There is a slight performance overhead here by not reusing the vector
 }
 
-void Renderer::onFrameBufferResized(int inWidth, int inHeight)
+bool Renderer::isHeadless() const
 {
-	framebufferResized = true;
+	return settings.headless;
 }
 
-vk::raii::CommandBuffer Renderer::beginSingleTimeCommands() const
+vk::Extent2D Renderer::getRenderExtent() const
 {
-	vk::CommandBufferAllocateInfo commandBufferAllocateInfo{commandPool, vk::CommandBufferLevel::ePrimary, 1};
-	vk::raii::CommandBuffer commandBuffer{std::move(device.allocateCommandBuffers(commandBufferAllocateInfo).front())};
-
-	vk::CommandBufferBeginInfo beginInfo{vk::CommandBufferUsageFlagBits::eOneTimeSubmit};
-	commandBuffer.begin(beginInfo);
-
-	return commandBuffer;
+	return swapchain ? swapchain->extent : settings.extent;
 }
 
-void Renderer::endSingleTimeCommands(vk::raii::CommandBuffer&& commandBuffer) const
+void Renderer::recreateSwapchain()
 {
-	commandBuffer.end();
+	if (isHeadless())
+	{
+		// Offscreen targets have a fixed size
+		return;
+	}
 
-	vk::SubmitInfo submitInfo{nullptr, nullptr, *commandBuffer, nullptr};
+	auto framebufferSize{window->getFramebufferSize()};
+	while (framebufferSize.x == 0 && framebufferSize.y == 0) // TODO: This is ugly
+	{
+		// We are minimized, just wait
+		framebufferSize = window->getFramebufferSize();
+		Window::waitEvents();
+	}
 
-	graphicsQueue.submit(submitInfo, nullptr);
+	// The render graph recreates the depth image once it is declared with the new extent
+	Swapchain newSwapchain{device, physicalDevice, surface, *window, queueIndices, swapchain->swapchain};
 
-	graphicsQueue.waitIdle();
+	// Frames in flight may still render to the old images
+	deletionQueue.push(std::move(*swapchain));
+	swapchain = std::move(newSwapchain);
+}
 
-	// TODO: Make sure the command buffer is properly destroyed here
+void Renderer::onFrameBufferResized(int inWidth, int inHeight)
+{
+	framebufferResized = true;
 }
 
 void Renderer::drawScene(Scene& scene)
@@ -98,33 +118,71 @@ void Renderer::drawScene(Scene& scene)
 		framebufferResized = false;
 	}
 
-	vk::raii::CommandBuffer& commandBuffer{commandBuffers[currentFrame]};
-	const RenderSync& renderSync{renderSyncObjects[currentFrame]};
+	const uint32_t frameIndex{currentFrame};
+	vk::raii::CommandBuffer& commandBuffer{commandBuffers[frameIndex]};
+	const RenderSync& renderSync{renderSyncObjects[frameIndex]};
 
 	currentFrame = (currentFrame + 1) % maxFramesInFlight;
 
 	check(device.waitForFences(*renderSync.inFlightFence, true, UINT64_MAX), "Fence wait failed");
+	frameAllocator.beginFrame(frameIndex);
+	deletionQueue.beginFrame(frameIndex);
+	residencyManager.beginFrame();
+	// Before the render queue is built, so every material keeps one set of results for the whole frame
+	materialCompiler.applyFinished();
+
+	if (isHeadless())
+	{
+		// Every frame in flight owns its offscreen target, so there is nothing to acquire or present
+		resetFrameCommandBuffers(frameIndex);
+		recordCommandBufferForSceneDraw(commandBuffer, frameIndex, frameIndex, scene);
+
+		const vk::SubmitInfo submitInfo{nullptr, nullptr, *commandBuffer, nullptr};
 
-	auto [result, imageIndex]{swapchain.swapchain.acquireNextImage(UINT64_MAX, renderSync.imageAvailableSemaphore, nullptr)};
+		// The uploads recorded until now, including this frame's, run before the frame on the same queue
+		uploadContext.flush();
+
+		device.resetFences(*renderSync.inFlightFence);
+		graphicsQueue.submit(submitInfo, renderSync.inFlightFence);
+
+		lastRenderedFrame = frameIndex;
+		return;
+	}
+
+	auto [result, imageIndex]{swapchain->swapchain.acquireNextImage(UINT64_MAX, renderSync.imageAvailableSemaphore, nullptr)};
 	if (checkForBadSwapchain(result) == vk::Result::eErrorOutOfDateKHR)
 	{
 		return;
 	}
 
-	commandBuffer.reset({});
-	recordCommandBufferForSceneDraw(commandBuffer, imageIndex, scene);
+	resetFrameCommandBuffers(frameIndex);
+	recordCommandBufferForSceneDraw(commandBuffer, frameIndex, imageIndex, scene);
 
 	vk::PipelineStageFlags waitStages{vk::PipelineStageFlagBits::eColorAttachmentOutput};
 	const vk::SubmitInfo submitInfo{*renderSync.imageAvailableSemaphore, waitStages, *commandBuffer, *renderSync.renderFinishedSemaphore};
 
+	uploadContext.flush();
+
 	device.resetFences(*renderSync.inFlightFence);
 	graphicsQueue.submit(submitInfo, renderSync.inFlightFence);
 
-	const vk::PresentInfoKHR presentInfo{*renderSync.renderFinishedSemaphore, *swapchain.swapchain, imageIndex, nullptr};
+	const vk::PresentInfoKHR presentInfo{*renderSync.renderFinishedSemaphore, *swapchain->swapchain, imageIndex, nullptr};
 	checkForBadSwapchain(presentQueue.presentKHR(presentInfo));
 }
 
-vk::raii::Instance Renderer::createInstance(const vk::raii::Context& context)
+void Renderer::writeFrameToFile(const std::filesystem::path& path) const
+{
+	if (!lastRenderedFrame)
+	{
+		throw std::runtime_error("No offscreen frame has been rendered yet");
+	}
+
+	check(device.waitForFences(*renderSyncObjects[*lastRenderedFrame].inFlightFence, true, UINT64_MAX), "Fence wait failed");
+
+	offscreenTargets[*lastRenderedFrame].writeToFile(path);
+}
+
+vk::raii::Instance Renderer::createInstance(const vk::raii::Context& context, const bool headless)
 {
 	if (enableValidationLayers && !checkValidationLayerSupport())
 	{
@@ -135,7 +193,7 @@ vk::raii::Instance Renderer::createInstance(const vk::raii::Context& context)
 		"Hello Triangle", VK_MAKE_VERSION(1, 0, 0), "No Engine", VK_MAKE_VERSION(1, 0, 0), vk::ApiVersion14
 	};
 
-	const auto requiredExtensions{getRequiredExtensions()};
+	const auto requiredExtensions{getRequiredExtensions(headless)};
 
 	const std::vector<const char*>& usedValidationLayers{
 		enableValidationLayers ? validationLayers : std::vector<const char*>{}
@@ -198,10 +256,13 @@ Renderer::pickPhysicalDevice(const vk::raii::Instance& instance, const vk::Surfa
 }
 
 vk::raii::Device Renderer::createLogicalDevice(const vk::raii::PhysicalDevice& physicalDevice,
-                                               const QueueFamilyIndices& queueIndices)
+                                               const QueueFamilyIndices& queueIndices, const bool gpuDriven)
 {
 	std::vector<vk::DeviceQueueCreateInfo> queueCreateInfos;
-	std::set<uint32_t> uniqueQueueFamilies = {queueIndices.graphicsFamily.value(), queueIndices.presentFamily.value()};
+	std::set<uint32_t> uniqueQueueFamilies = {
+		queueIndices.graphicsFamily.value(), queueIndices.presentFamily.value_or(queueIndices.graphicsFamily.value()),
+		queueIndices.transferFamily.value_or(queueIndices.graphicsFamily.value())
+	};
 	float queuePriority = 1.0f;
 
 	for (uint32_t queueFamily : uniqueQueueFamilies)
@@ -209,79 +270,61 @@ vk::raii::Device Renderer::createLogicalDevice(const vk::raii::PhysicalDevice& p
 		queueCreateInfos.emplace_back(vk::DeviceQueueCreateFlags{}, queueFamily, 1, &queuePriority);
 	}
 
-	vk::PhysicalDeviceFeatures deviceFeatures{};
-	deviceFeatures.samplerAnisotropy = true;
+	if (gpuDriven && !supportsGpuDrivenRendering(physicalDevice))
+	{
+		throw std::runtime_error("GPU-driven rendering requested, but the GPU does not support indirect draws with count");
+	}
+
+	vk::StructureChain<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan11Features, vk::PhysicalDeviceVulkan12Features, vk::PhysicalDeviceVulkan13Features> deviceFeatures{};
+	deviceFeatures.get<vk::PhysicalDeviceFeatures2>().features.samplerAnisotropy = true;
+	deviceFeatures.get<vk::PhysicalDeviceFeatures2>().features.multiDrawIndirect = gpuDriven;
+	deviceFeatures.get<vk::PhysicalDeviceVulkan11Features>().shaderDrawParameters = true;
+	deviceFeatures.get<vk::PhysicalDeviceVulkan12Features>().drawIndirectCount = gpuDriven;
+	// Hands uploads from the transfer queue over to the graphics queue
+	deviceFeatures.get<vk::PhysicalDeviceVulkan12Features>().timelineSemaphore = true;
+	// The render graph records its barriers with synchronization2 and renders without render pass objects
+	deviceFeatures.get<vk::PhysicalDeviceVulkan13Features>().synchronization2 = true;
+	deviceFeatures.get<vk::PhysicalDeviceVulkan13Features>().dynamicRendering = true;
 
 	const std::vector<const char*>& usedValidationLayers{
 		enableValidationLayers ? validationLayers : std::vector<const char*>{}
 	};
-	vk::DeviceCreateInfo createInfo{{}, queueCreateInfos, usedValidationLayers, deviceExtensions, &deviceFeatures};
-
-	return vk::raii::Device{physicalDevice, createInfo};
-}
+	std::vector<const char*> extensions{getDeviceExtensions(queueIndices.presentFamily.has_value())};
+	if (supportsMemoryBudget(physicalDevice))
+	{
+		extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+	}
 
-vk::raii::CommandPool Renderer::createCommandPool(const vk::raii::Device& device,
-                                                  const QueueFamilyIndices& queueIndices)
-{
-	vk::CommandPoolCreateInfo commandPoolCreateInfo{
-		vk::CommandPoolCreateFlagBits::eResetCommandBuffer, queueIndices.graphicsFamily.value()
-	};
+	// Features are passed through the chain, so pEnabledFeatures stays empty
+	vk::DeviceCreateInfo createInfo{{}, queueCreateInfos, usedValidationLayers, extensions, nullptr, &deviceFeatures.get<vk::PhysicalDeviceFeatures2>()};
 
-	return vk::raii::CommandPool{device, commandPoolCreateInfo};
+	return vk::raii::Device{physicalDevice, createInfo};
 }
 
-vk::raii::RenderPass Renderer::createRenderPass(const vk::raii::Device& device, const vk::PhysicalDevice& physicalDevice, const Swapchain& swapchain)
+std::vector<vk::raii::CommandPool> Renderer::createFrameCommandPools(const vk::raii::Device& device, const QueueFamilyIndices& queueIndices, const uint32_t count)
 {
-	vk::AttachmentDescription colorAttachment{
-		{}, swapchain.imageFormat, vk::SampleCountFlagBits::e1, vk::AttachmentLoadOp::eClear,
-		vk::AttachmentStoreOp::eStore, vk::AttachmentLoadOp::eDontCare,
-		vk::AttachmentStoreOp::eDontCare, vk::ImageLayout::eUndefined, vk::ImageLayout::ePresentSrcKHR
-	};
-	vk::AttachmentReference colorAttachmentReference{0, vk::ImageLayout::eColorAttachmentOptimal};
-
-	vk::AttachmentDescription depthAttachment{
-		{}, DepthImage::findDepthFormat(physicalDevice), vk::SampleCountFlagBits::e1, vk::AttachmentLoadOp::eClear,
-		vk::AttachmentStoreOp::eDontCare, vk::AttachmentLoadOp::eDontCare,
-		vk::AttachmentStoreOp::eDontCare, vk::ImageLayout::eUndefined, vk::ImageLayout::eDepthStencilAttachmentOptimal
-	};
-	vk::AttachmentReference depthAttachmentReference{1, vk::ImageLayout::eDepthStencilAttachmentOptimal};
-
-	vk::SubpassDescription subpass{
-		{}, vk::PipelineBindPoint::eGraphics, 0, nullptr, 1, &colorAttachmentReference, nullptr,
-		&depthAttachmentReference, 0, nullptr
-	};
+	// No eResetCommandBuffer, the command buffers of a frame are reset together with their pool
+	const vk::CommandPoolCreateInfo commandPoolCreateInfo{vk::CommandPoolCreateFlagBits::eTransient, queueIndices.graphicsFamily.value()};
 
-	vk::SubpassDependency dependency{
-		vk::SubpassExternal, 0,
-		vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eEarlyFragmentTests,
-		vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eEarlyFragmentTests,
-		vk::AccessFlagBits::eDepthStencilAttachmentWrite,
-		vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eDepthStencilAttachmentWrite
-	};
-
-	std::array<vk::AttachmentDescription, 2> attachments{colorAttachment, depthAttachment};
-	vk::RenderPassCreateInfo renderPassCreateInfo{{}, attachments, subpass, dependency};
-
-	return vk::raii::RenderPass{device, renderPassCreateInfo};
+	std::vector<vk::raii::CommandPool> commandPools{};
+	commandPools.reserve(count);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		commandPools.emplace_back(device, commandPoolCreateInfo);
+	}
+	return commandPools;
 }
 
-std::vector<vk::raii::Framebuffer> Renderer::createFramebuffers(const vk::raii::Device& device,
-                                                                const vk::raii::RenderPass& renderPass,
-                                                                const vk::raii::ImageView& depthImageView,
-                                                                const std::vector<vk::raii::ImageView>& imageViews,
-                                                                const vk::Extent2D& swapchainExtent)
+std::vector<vk::raii::CommandBuffer> Renderer::allocateFrameCommandBuffers(const vk::raii::Device& device, const std::vector<vk::raii::CommandPool>& commandPools,
+                                                                           const vk::CommandBufferLevel level)
 {
-	auto framebuffers{
-		imageViews | std::ranges::views::transform([&](const auto& imageView) -> vk::raii::Framebuffer
-		{
-			std::array<vk::ImageView, 2> attachments = {imageView, depthImageView};
-			vk::FramebufferCreateInfo framebufferCreateInfo{
-				{}, renderPass, attachments, swapchainExtent.width, swapchainExtent.height, 1
-			};
-			return vk::raii::Framebuffer{device, framebufferCreateInfo};
-		})
-	};
-	return {framebuffers.begin(), framebuffers.end()};
+	std::vector<vk::raii::CommandBuffer> commandBuffers{};
+	commandBuffers.reserve(commandPools.size());
+	for (const auto& commandPool : commandPools)
+	{
+		commandBuffers.push_back(std::move(device.allocateCommandBuffers({commandPool, level, 1}).front()));
+	}
+	return commandBuffers;
 }
 
 std::vector<RenderSync> Renderer::createSyncObjects(const vk::raii::Device& device, uint8_t maxFramesInFlight)
@@ -296,8 +339,53 @@ std::vector<RenderSync> Renderer::createSyncObjects(const vk::raii::Device& devi
 	return renderSyncObjects;
 }
 
-ImGUI Renderer::initImGUI() const
+std::vector<OffscreenTarget> Renderer::createOffscreenTargets(const vk::raii::Device& device, DeviceMemoryAllocator& allocator, const vk::Extent2D extent,
+                                                              const uint32_t count)
 {
+	std::vector<OffscreenTarget> offscreenTargets{};
+	offscreenTargets.reserve(count);
+
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		offscreenTargets.emplace_back(device, allocator, extent);
+	}
+	return offscreenTargets;
+}
+
+std::optional<Window> Renderer::createWindow()
+{
+	if (settings.headless)
+	{
+		return std::nullopt;
+	}
+	return std::optional<Window>{
+		std::in_place, static_cast<int>(settings.extent.width), static_cast<int>(settings.extent.height),
+		[this](const int width, const int height) { onFrameBufferResized(width, height); }
+	};
+}
+
+vk::Format Renderer::getColorFormat() const
+{
+	return swapchain ? swapchain->imageFormat : OffscreenTarget::colorFormat;
+}
+
+MemoryReport Renderer::getMemoryReport() const
+{
+	return MemoryReport{memoryAllocator.getStats(), hostMemory.getBytes(), frameAllocator.getChunkCount()};
+}
+
+std::optional<ImGUI> Renderer::initImGUI() const
+{
+	if (isHeadless())
+	{
+		// ImGui needs a glfw window for its input
+		return std::nullopt;
+	}
+
+	// ImGui only needs the attachment formats for dynamic rendering
+	const vk::Format colorFormat{getColorFormat()};
+	const vk::PipelineRenderingCreateInfo renderingCreateInfo{0, colorFormat, depthFormat};
+
 	// TODO: I don't know if all of this is correct...
 	ImGui_ImplVulkan_InitInfo initInfo{
 		.ApiVersion = vk::ApiVersion14,
@@ -307,14 +395,63 @@ ImGUI Renderer::initImGUI() const
 		.QueueFamily = *queueIndices.graphicsFamily,
 		.Queue = *graphicsQueue,
 		.DescriptorPool = nullptr,
-		.RenderPass = *renderPass,
 		.MinImageCount = 2,
 		.ImageCount = maxFramesInFlight,
 		.MSAASamples = {},
-		.DescriptorPoolSize = 7
+		.DescriptorPoolSize = 7,
+		.UseDynamicRendering = true,
+		.PipelineRenderingCreateInfo = renderingCreateInfo
 	};
-	ImGUI imGui{window, initInfo};
-	return imGui;
+
+	hostMemory.trackImGuiAllocations();
+	return std::optional<ImGUI>{std::in_place, *window, initInfo};
+}
+
+uint32_t Renderer::getRecordingThreadCount() const
+{
+	if (settings.recordingThreadCount > 0)
+	{
+		return settings.recordingThreadCount;
+	}
+	// hardware_concurrency may return 0 if it is unknown
+	return std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+uint32_t Renderer::getCompileThreadCount() const
+{
+	if (settings.compileThreadCount > 0)
+	{
+		return settings.compileThreadCount;
+	}
+	return std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+vk::DeviceSize Renderer::getResidencyBudget() const
+{
+	if (settings.residencyBudget)
+	{
+		return *settings.residencyBudget;
+	}
+
+	// Leaves the other half of the largest device-local heap to render targets, textures and everything else
+	vk::DeviceSize heapBudget{0};
+	for (const DeviceHeapStats& heap : memoryAllocator.getStats().heaps)
+	{
+		if (heap.isDeviceLocal)
+		{
+			heapBudget = std::max(heapBudget, heap.budget);
+		}
+	}
+	return heapBudget / 2;
+}
+
+std::optional<GpuScene> Renderer::createGpuScene() const
+{
+	if (!settings.gpuDriven)
+	{
+		return std::nullopt;
+	}
+	return std::optional<GpuScene>{std::in_place, *this, instanceBuffer};
 }
 
 vk::Bool32 Renderer::debugCallback(vk::DebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
@@ -330,57 +467,264 @@ vk::Bool32 Renderer::debugCallback(vk::DebugUtilsMessageSeverityFlagBitsEXT mess
 	return false;
 }
 
-void Renderer::recordCommandBufferForSceneDraw(const vk::raii::CommandBuffer& commandBuffer, unsigned imageIndex, const Scene& scene)
+void Renderer::resetFrameCommandBuffers(const uint32_t frameIndex)
+{
+	frameCommandPools[frameIndex].reset({});
+	commandRecorder.resetFrame(frameIndex);
+}
+
+void Renderer::recordCommandBufferForSceneDraw(const vk::raii::CommandBuffer& commandBuffer, const uint32_t frameIndex, unsigned imageIndex, const Scene& scene)
 {
 	vk::CommandBufferBeginInfo beginInfo{{}, nullptr};
 	commandBuffer.begin(beginInfo);
 
-	std::array<vk::ClearValue, 2> clearValues{
-		vk::ClearValue{vk::ClearColorValue{std::array{0.0f, 0.0f, 0.0f, 1.0f}}}, vk::ClearValue{vk::ClearDepthStencilValue{1.0f, 0}}
+	// The frame's fence was waited on, so the timings of its last submission are available
+	gpuProfiler.beginFrame(commandBuffer, frameIndex);
+	const uint32_t frameScope{gpuProfiler.beginScope(commandBuffer, "Frame")};
+
+	// Uploads are flushed right before this command buffer is submitted
+	UploadContext::recordVisibilityBarrier(commandBuffer);
+
+	const vk::Extent2D extent{getRenderExtent()};
+
+	const glm::mat4 viewProjection{scene.camera.getViewProjection(glm::vec2{extent.width, extent.height})};
+
+	// Material of the first draw. Set 0 layouts are identical for all materials
+	const Material* frameMaterial{nullptr};
+	bool instanceBufferReallocated{false};
+	if (gpuScene)
+	{
+		// GPU-driven rendering culls on the GPU and keeps the instances of earlier frames, so the render queue is not built
+		instanceBufferReallocated = instanceBuffer.reserve(static_cast<uint32_t>(scene.models.size()));
+		gpuScene->update(scene, renderQueue.fallbackMaterial, frameIndex);
+
+		// Evicted meshes and textures are uploaded again before their draws are recorded
+		for (const GpuDraw& draw : gpuScene->getDraws())
+		{
+			draw.mesh->markUsed();
+			draw.materialInstance->shaderObject->updateDescriptors(frameIndex);
+		}
+		if (!gpuScene->getDraws().empty())
+		{
+			frameMaterial = gpuScene->getDraws().front().material;
+		}
+	}
+	else
+	{
+		renderQueue.build(scene, scene.camera.transform.translation, FrustumCuller::extractFrustumPlanes(viewProjection));
+
+		const std::vector<RenderItem>& renderItems{renderQueue.getItems()};
+		for (const RenderItem& item : renderItems)
+		{
+			item.mesh->markUsed();
+			item.materialInstance->shaderObject->updateDescriptors(frameIndex);
+		}
+		if (!renderItems.empty())
+		{
+			frameMaterial = renderItems.front().material;
+			instanceBufferReallocated = instanceBuffer.reserve(static_cast<uint32_t>(renderItems.size()));
+			renderQueue.writeInstances(instanceBuffer.getFrameInstances(frameIndex));
+		}
+	}
+
+	const bool frameDataCreated{frameMaterial && writeFrameData(scene, extent, *frameMaterial)};
+	// Descriptors may only be rewritten before the set is bound
+	if (frameShaderObject && (instanceBufferReallocated || frameDataCreated))
+	{
+		ShaderCursor{&*frameShaderObject}.field("instances").writeBuffer(instanceBuffer.getBuffer());
+	}
+	if (frameMaterial)
+	{
+		frameShaderObject->updateDescriptors(frameIndex);
+	}
+
+	buildRenderGraph(frameIndex, imageIndex, extent, viewProjection);
+	renderGraph.compile();
+	renderGraph.execute(commandBuffer, &gpuProfiler);
+
+	gpuProfiler.endScope(commandBuffer, frameScope);
+
+	commandBuffer.end();
+}
+
+void Renderer::buildRenderGraph(const uint32_t frameIndex, const unsigned imageIndex, const vk::Extent2D& extent, const glm::mat4& viewProjection)
+{
+	renderGraph.reset();
+
+	// Swapchain images are presented, offscreen targets are copied to their readback buffer
+	const RenderGraphImageInfo colorInfo{getColorFormat(), extent, vk::ImageAspectFlagBits::eColor};
+	const RenderGraphResource colorTarget{
+		swapchain
+			? renderGraph.importImage("Swapchain image", swapchain->images[imageIndex], swapchain->imageViews[imageIndex], colorInfo, vk::ImageLayout::eUndefined,
+			                          vk::ImageLayout::ePresentSrcKHR)
+			: renderGraph.importImage("Offscreen target", offscreenTargets[imageIndex].colorImage.image, offscreenTargets[imageIndex].colorImage.imageView, colorInfo,
+			                          vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferSrcOptimal)
 	};
+	const RenderGraphResource depthTarget{renderGraph.createImage("Depth", RenderGraphImageInfo{depthFormat, extent, vk::ImageAspectFlagBits::eDepth})};
 
-	vk::RenderPassBeginInfo renderPassInfo{renderPass, swapChainFramebuffers[imageIndex], vk::Rect2D{{0, 0}, swapchain.extent}, clearValues};
+	// Passes run in the order they are added
+	std::optional<RenderGraphResource> drawCommands{};
+	std::optional<RenderGraphResource> drawCounts{};
+	if (gpuScene && !gpuScene->getDraws().empty())
+	{
+		drawCommands = renderGraph.importBuffer("Draw commands", gpuScene->getDrawCommandBuffer().vkBuffer);
+		drawCounts = renderGraph.importBuffer("Draw counts", gpuScene->getCountBuffer().vkBuffer);
+
+		// The counts are cleared by a transfer before the culling dispatch increments them
+		renderGraph.addPass("Clear draw counts")
+		           .write(*drawCounts, RenderGraphUsage::TransferWrite)
+		           .setExecute([this, frameIndex](const RenderGraphContext& context)
+		           {
+			           gpuScene->recordClearCounts(context.commandBuffer, frameIndex);
+		           });
+		renderGraph.addPass("GPU culling")
+		           .read(*drawCounts, RenderGraphUsage::ComputeShaderRead)
+		           .write(*drawCounts, RenderGraphUsage::ComputeShaderWrite)
+		           .write(*drawCommands, RenderGraphUsage::ComputeShaderWrite)
+		           .setExecute([this, frameIndex, viewProjection](const RenderGraphContext& context)
+		           {
+			           gpuScene->recordCulling(context.commandBuffer, frameIndex, viewProjection);
+		           });
+	}
 
-	commandBuffer.beginRenderPass(renderPassInfo, vk::SubpassContents::eInline);
+	RenderGraphPass& forwardPass{renderGraph.addPass("Forward")};
+	if (drawCommands && drawCounts)
+	{
+		forwardPass.read(*drawCommands, RenderGraphUsage::IndirectRead).read(*drawCounts, RenderGraphUsage::IndirectRead);
+	}
+	forwardPass.addColorAttachment(colorTarget, vk::AttachmentLoadOp::eClear, vk::ClearValue{vk::ClearColorValue{std::array{0.0f, 0.0f, 0.0f, 1.0f}}})
+	           .setDepthAttachment(depthTarget, vk::AttachmentLoadOp::eClear, vk::ClearValue{vk::ClearDepthStencilValue{1.0f, 0}})
+	           .useSecondaryCommandBuffers()
+	           .setExecute([this, frameIndex, extent](const RenderGraphContext& context)
+	           {
+		           recordForwardPass(context, frameIndex, extent);
+	           });
+
+	if (isHeadless())
+	{
+		renderGraph.addPass("Readback")
+		           .read(colorTarget, RenderGraphUsage::TransferRead)
+		           .markSideEffect()
+		           .setExecute([this, imageIndex](const RenderGraphContext& context)
+		           {
+			           offscreenTargets[imageIndex].recordReadback(context.commandBuffer);
+		           });
+	}
+}
 
-	vk::Viewport viewport{0, 0, static_cast<float>(swapchain.extent.width), static_cast<float>(swapchain.extent.height), 0.f, 1.f};
-	commandBuffer.setViewportWithCount(viewport);
+void Renderer::recordForwardPass(const RenderGraphContext& context, const uint32_t frameIndex, const vk::Extent2D& extent)
+{
+	const vk::CommandBufferInheritanceInfo& inheritanceInfo{*context.inheritanceInfo};
 
-	vk::Rect2D scissor{{0, 0}, swapchain.extent};
-	commandBuffer.setScissorWithCount(scissor);
+	std::pmr::vector<vk::CommandBuffer> secondaryCommandBuffers{frameAllocator.makeVector<vk::CommandBuffer>()};
+	if (!gpuScene && !renderQueue.getItems().empty())
+	{
+		secondaryCommandBuffers = recordRenderQueue(frameIndex, inheritanceInfo, extent);
+	}
 
-	for (const auto& model : scene.models)
+	// GPU-driven draws are only a few indirect draws, so they are recorded on this thread together with ImGui
+	const bool recordGpuDraws{gpuScene && !gpuScene->getDraws().empty()};
+	if (recordGpuDraws || imGui)
 	{
-		// TODO: This is extremely inefficient. We should sort the models by material, material instance, mesh to avoid rebinding. Also, we should share descriptor sets and maybe use push constants
+		recordOverlay(inheritanceInfo, frameIndex, extent, recordGpuDraws);
+		secondaryCommandBuffers.push_back(overlayCommandBuffers[frameIndex]);
+	}
 
-		ShaderCursor globalCursor{model.material->getShaderCursor()};
-		ShaderCursor modelCursor{globalCursor.field("gModelData")};
-		modelCursor.field("modelTransform").write(model.transform.getMatrix());
-		modelCursor.field("inverseTransposeModelTransform").write(inverse(transpose(model.transform.getMatrix())));
+	// Command buffers without commands are left out. Without any, the pass only clears its attachments
+	if (!secondaryCommandBuffers.empty())
+	{
+		context.commandBuffer.executeCommands(secondaryCommandBuffers);
+	}
+}
 
-		ShaderCursor viewCursor{globalCursor.field("gViewData")};
-		viewCursor.field("viewPosition").write(scene.camera.transform.translation);
-		viewCursor.field("viewProjection").write(scene.camera.getViewProjection(glm::vec2{swapchain.extent.width, swapchain.extent.height}));
-		viewCursor.field("exposureValue").write(scene.camera.exposureValue);
+void Renderer::recordOverlay(const vk::CommandBufferInheritanceInfo& inheritanceInfo, const uint32_t frameIndex, const vk::Extent2D& extent, const bool recordGpuDraws)
+{
+	const vk::raii::CommandBuffer& overlayCommandBuffer{overlayCommandBuffers[frameIndex]};
+	overlayCommandBuffer.begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit | vk::CommandBufferUsageFlagBits::eRenderPassContinue, &inheritanceInfo});
 
-		ShaderCursor lightCursor{globalCursor.field("gLightEnvironment")};
-		scene.lightEnvironment.writeToCursor(lightCursor);
+	if (recordGpuDraws)
+	{
+		overlayCommandBuffer.setViewportWithCount(vk::Viewport{0, 0, static_cast<float>(extent.width), static_cast<float>(extent.height), 0.f, 1.f});
+		overlayCommandBuffer.setScissorWithCount(vk::Rect2D{{0, 0}, extent});
+		frameShaderObject->bind(overlayCommandBuffer, vk::PipelineBindPoint::eGraphics, gpuScene->getDraws().front().material->pipelineLayout, frameSetIndex, frameIndex);
+		gpuScene->recordDraws(overlayCommandBuffer, frameIndex);
+	}
+
+	if (imGui)
+	{
+		imGui->Render(overlayCommandBuffer);
+	}
+
+	overlayCommandBuffer.end();
+}
 
-		commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, model.material->parentMaterial->pipeline);
+std::pmr::vector<vk::CommandBuffer> Renderer::recordRenderQueue(const uint32_t frameIndex, const vk::CommandBufferInheritanceInfo& inheritanceInfo, const vk::Extent2D& extent)
+{
+	const std::vector<RenderDraw>& draws{renderQueue.getDraws()};
+	const uint32_t workerCount{commandRecorder.getWorkerCount()};
+	const size_t drawsPerWorker{(draws.size() + workerCount - 1) / workerCount};
+	const vk::PipelineLayout frameSetLayout{renderQueue.getItems().front().material->pipelineLayout};
+
+	std::pmr::vector<RenderQueueStats> workerStats(workerCount, frameAllocator.getResource());
+
+	std::pmr::vector<vk::CommandBuffer> secondaryCommandBuffers{commandRecorder.record(frameIndex, inheritanceInfo, frameAllocator.getResource(), [&](const uint32_t workerIndex, const vk::raii::CommandBuffer& commandBuffer)
+	{
+		// Every worker records a contiguous range of draws, so state changes stay as rare as on a single thread
+		const size_t firstDraw{std::min(workerIndex * drawsPerWorker, draws.size())};
+		const size_t lastDraw{std::min(firstDraw + drawsPerWorker, draws.size())};
+		if (firstDraw == lastDraw)
+		{
+			return false;
+		}
 
-		commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, model.material->parentMaterial->pipelineLayout, 0, *model.material->shaderObject.getDescriptorSets()[currentFrame], nullptr);
+		// Secondary command buffers inherit neither dynamic state nor bound descriptor sets
+		commandBuffer.setViewportWithCount(vk::Viewport{0, 0, static_cast<float>(extent.width), static_cast<float>(extent.height), 0.f, 1.f});
+		commandBuffer.setScissorWithCount(vk::Rect2D{{0, 0}, extent});
 
-		commandBuffer.bindVertexBuffers(0, *model.mesh->vertexBuffer.vkBuffer, {0});
-		commandBuffer.bindIndexBuffer(model.mesh->indexBuffer.vkBuffer, 0, vk::IndexType::eUint32);
+		// Set 0 layouts are identical for all materials, so it stays bound for all draws of the worker
+		frameShaderObject->bind(commandBuffer, vk::PipelineBindPoint::eGraphics, frameSetLayout, frameSetIndex, frameIndex);
 
-		commandBuffer.drawIndexed(model.mesh->rawMesh.indices.size(), 1, 0, 0, 0);
+		workerStats[workerIndex] = renderQueue.record(commandBuffer, frameIndex, std::span{draws}.subspan(firstDraw, lastDraw - firstDraw),
+		                                              [&](const RenderItem& item, const uint32_t firstInstance)
+		                                              {
+			                                              // Per-draw data only lives in the command buffer, the instances themselves are in the frame's instance buffer
+			                                              // Written by offset, reflection must not be read on recording threads
+			                                              PushConstantObject drawData{nullptr};
+			                                              drawData.write(item.material->drawInstanceOffset, instanceBuffer.getFrameOffset(frameIndex) + firstInstance);
+
+			                                              drawData.push(commandBuffer, item.material->pipelineLayout, item.material->drawDataRange);
+		                                              });
+		return true;
+	})};
+
+	renderQueue.stats = {};
+	for (const RenderQueueStats& stats : workerStats)
+	{
+		renderQueue.stats += stats;
 	}
 
-	imGui.Render(commandBuffer);
+	return secondaryCommandBuffers;
+}
 
-	commandBuffer.endRenderPass();
+bool Renderer::writeFrameData(const Scene& scene, const vk::Extent2D& extent, const Material& material)
+{
+	const bool created{!frameShaderObject};
+	if (created)
+	{
+		frameShaderObject.emplace(material.frameLayout);
+	}
 
-	commandBuffer.end();
+	const ShaderCursor frameCursor{&*frameShaderObject};
+
+	ShaderCursor viewCursor{frameCursor.field("viewData")};
+	viewCursor.field("viewPosition").write(scene.camera.transform.translation);
+	viewCursor.field("viewProjection").write(scene.camera.getViewProjection(glm::vec2{extent.width, extent.height}));
+	viewCursor.field("exposureValue").write(scene.camera.exposureValue);
+
+	ShaderCursor lightCursor{frameCursor.field("lightEnvironment")};
+	scene.lightEnvironment.writeToCursor(lightCursor);
+
+	return created;
 }
 
 vk::Result Renderer::checkForBadSwapchain(vk::Result inResult)
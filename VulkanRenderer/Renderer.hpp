@@ -1,4 +1,6 @@
 ﻿#pragma once
+#include <filesystem>
+#include <optional>
 #include <utility>
 
 #include "CommandQueues.hpp"
@@ -8,64 +10,129 @@
 #include "VulkanBackend.hpp"
 #include "Window.hpp"
 #include "ImGUI/ImGUI.hpp"
+#include "ShaderCompilation/MaterialCompiler.hpp"
+#include "ShaderCompilation/SpirvCache.hpp"
+#include "ShaderCompilation/VulkanShaderObject.hpp"
+#include "Renderer/DeletionQueue.hpp"
+#include "Renderer/DeviceMemoryAllocator.hpp"
+#include "Renderer/FrameAllocator.hpp"
+#include "Renderer/GpuProfiler.hpp"
+#include "Renderer/GpuScene.hpp"
+#include "Renderer/InstanceBuffer.hpp"
+#include "Renderer/MemoryAccounting.hpp"
+#include "Renderer/MemoryReport.hpp"
+#include "Renderer/OffscreenTarget.hpp"
+#include "Renderer/PipelineCache.hpp"
+#include "Renderer/ParallelCommandRecorder.hpp"
+#include "Renderer/RenderGraph.hpp"
+#include "Renderer/RenderQueue.hpp"
+#include "Renderer/ResidencyManager.hpp"
+#include "Renderer/RendererSettings.hpp"
 #include "Renderer/RenderSync.hpp"
+#include "Renderer/UniformArena.hpp"
+#include "Renderer/UploadContext.hpp"
 
+class Material;
 class Scene;
 
 class Renderer : public std::enable_shared_from_this<Renderer>
 {
 public:
-    Renderer();
+    explicit Renderer(const RendererSettings& settings = {});
 
     uint32_t maxFramesInFlight{2};
+
+    const RendererSettings settings;
     
     vk::raii::Context context;
     vk::raii::Instance instance;
     vk::raii::DebugUtilsMessengerEXT debugMessenger;
-    Window window;
+    std::optional<Window> window; // Empty when headless
     vk::raii::SurfaceKHR surface;
     vk::raii::PhysicalDevice physicalDevice;
 private:
     QueueFamilyIndices queueIndices;
 public:
+    mutable HostMemoryTracker hostMemory; // Declared early so it outlives everything it tracks
     vk::raii::Device device;
+    mutable DeviceMemoryAllocator memoryAllocator; // Backs every Buffer and Image. Declared early so it outlives them
+    mutable UniformArena uniformArena; // Uniform data of all shader objects. Outlives the deletion queue holding unloaded materials
+    mutable ResidencyManager residencyManager; // Evicts mesh buffers and textures that are not drawn under memory pressure. Outlives the deletion queue holding unloaded meshes and materials
+    mutable DeletionQueue deletionQueue; // Released resources that frames in flight may still use. Destroyed before the device
     vk::raii::Queue graphicsQueue;
     vk::raii::Queue presentQueue; // TODO: The queues should probably be somewhere else
-    Swapchain swapchain;
-	DepthImage depthImage;
-    vk::raii::RenderPass renderPass;
-    vk::raii::CommandPool commandPool;
-    std::vector<vk::raii::CommandBuffer> commandBuffers;
-    std::vector<vk::raii::Framebuffer> swapChainFramebuffers;
+    vk::raii::Queue transferQueue; // Empty if the device has no dedicated transfer queue
+    std::optional<Swapchain> swapchain; // Empty when headless
+    std::vector<OffscreenTarget> offscreenTargets; // One per frame in flight, only when headless
+    vk::Format depthFormat;
+    mutable UploadContext uploadContext; // Assets record their uploads through const references of the renderer
+    mutable FrameAllocator frameAllocator; // Transient CPU memory of each frame in flight, reset once the frame's fence has signaled
+    std::vector<vk::raii::CommandPool> frameCommandPools; // One per frame in flight, reset at the start of the frame
+    std::vector<vk::raii::CommandBuffer> commandBuffers; // Primary command buffer of each frame in flight
+    std::vector<vk::raii::CommandBuffer> overlayCommandBuffers; // Secondary command buffer of each frame in flight for ImGui and GPU-driven draws
     std::vector<RenderSync> renderSyncObjects;
+    ParallelCommandRecorder commandRecorder;
+    GpuProfiler gpuProfiler;
     SlangCompiler compiler;
-    ImGUI imGui;
+    SpirvCache spirvCache; // Compiled material code and reflection from earlier runs
+    mutable PipelineCache pipelineCache; // Used for every pipeline. Saved to disk when the renderer is destroyed
+    MaterialCompiler materialCompiler; // Declared after everything compiles use, so its workers are joined first
+    std::optional<ImGUI> imGui; // Empty when headless
+    RenderQueue renderQueue;
+    InstanceBuffer instanceBuffer;
+    std::optional<GpuScene> gpuScene; // Only when GPU-driven
+    RenderGraph renderGraph; // Declared anew every frame
+
+    // Descriptor set 0, written once per frame. Created with the layout of the first drawn material
+    std::optional<VulkanShaderObject> frameShaderObject;
 
     uint32_t currentFrame{0};
 
-    void recreateSwapchain();
+    [[nodiscard]] bool isHeadless() const;
+    [[nodiscard]] vk::Extent2D getRenderExtent() const;
+    [[nodiscard]] vk::Format getColorFormat() const;
+    [[nodiscard]] MemoryReport getMemoryReport() const;
 
-    [[nodiscard]] vk::raii::CommandBuffer beginSingleTimeCommands() const;
-    void endSingleTimeCommands(vk::raii::CommandBuffer&& commandBuffer) const;
+    void recreateSwapchain();
 
     void drawScene(Scene& scene);
 
+    // Waits for the last frame rendered in headless mode and writes it to disk as PPM
+    void writeFrameToFile(const std::filesystem::path& path) const;
+
 private:
+    std::optional<uint32_t> lastRenderedFrame;
 
-    static vk::raii::Instance createInstance(const vk::raii::Context& context);
+    static vk::raii::Instance createInstance(const vk::raii::Context& context, bool headless);
     static vk::raii::DebugUtilsMessengerEXT createDebugMessenger(const vk::raii::Instance& instance);
     static vk::raii::PhysicalDevice pickPhysicalDevice(const vk::raii::Instance& instance, const vk::SurfaceKHR& surface);
-    static vk::raii::Device createLogicalDevice(const vk::raii::PhysicalDevice& physicalDevice, const QueueFamilyIndices& queueIndices);
-    static vk::raii::CommandPool createCommandPool(const vk::raii::Device& device, const QueueFamilyIndices& queueIndices);
-    static vk::raii::RenderPass createRenderPass(const vk::raii::Device& device, const vk::PhysicalDevice& physicalDevice, const Swapchain& swapchain);
-    static std::vector<vk::raii::Framebuffer> createFramebuffers(const vk::raii::Device& device, const vk::raii::RenderPass& renderPass, const vk::raii::ImageView& depthImageView, const std::vector<vk::raii::ImageView>& imageViews, const vk::Extent2D& swapchainExtent);
+    static vk::raii::Device createLogicalDevice(const vk::raii::PhysicalDevice& physicalDevice, const QueueFamilyIndices& queueIndices, bool gpuDriven);
+    static std::vector<vk::raii::CommandPool> createFrameCommandPools(const vk::raii::Device& device, const QueueFamilyIndices& queueIndices, uint32_t count);
+    static std::vector<vk::raii::CommandBuffer> allocateFrameCommandBuffers(const vk::raii::Device& device, const std::vector<vk::raii::CommandPool>& commandPools, vk::CommandBufferLevel level);
     static std::vector<RenderSync> createSyncObjects(const vk::raii::Device& device, uint8_t maxFramesInFlight);
-    ImGUI initImGUI() const;
+    static std::vector<OffscreenTarget> createOffscreenTargets(const vk::raii::Device& device, DeviceMemoryAllocator& allocator, vk::Extent2D extent, uint32_t count);
+    std::optional<Window> createWindow();
+    std::optional<ImGUI> initImGUI() const;
+    std::optional<GpuScene> createGpuScene() const;
+    [[nodiscard]] uint32_t getRecordingThreadCount() const;
+    [[nodiscard]] uint32_t getCompileThreadCount() const;
+    [[nodiscard]] vk::DeviceSize getResidencyBudget() const;
 
     static VKAPI_ATTR vk::Bool32 VKAPI_CALL debugCallback(vk::DebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
                                                       vk::DebugUtilsMessageTypeFlagsEXT messageType, const vk::DebugUtilsMessengerCallbackDataEXT* pCallbackData, void* pUserData);
 
-    void recordCommandBufferForSceneDraw(const vk::raii::CommandBuffer& commandBuffer, unsigned imageIndex, const Scene& scene);
+    void resetFrameCommandBuffers(uint32_t frameIndex);
+    void recordCommandBufferForSceneDraw(const vk::raii::CommandBuffer& commandBuffer, uint32_t frameIndex, unsigned imageIndex, const Scene& scene);
+    // Declares the passes of the frame. imageIndex selects the swapchain image or offscreen target
+    void buildRenderGraph(uint32_t frameIndex, unsigned imageIndex, const vk::Extent2D& extent, const glm::mat4& viewProjection);
+    // Records the scene and ImGui into secondary command buffers and executes them in the forward pass
+    void recordForwardPass(const RenderGraphContext& context, uint32_t frameIndex, const vk::Extent2D& extent);
+    // Records the draws of the render queue on the worker threads and returns their secondary command buffers
+    std::pmr::vector<vk::CommandBuffer> recordRenderQueue(uint32_t frameIndex, const vk::CommandBufferInheritanceInfo& inheritanceInfo, const vk::Extent2D& extent);
+    // Records the GPU-driven draws and ImGui into the frame's overlay command buffer
+    void recordOverlay(const vk::CommandBufferInheritanceInfo& inheritanceInfo, uint32_t frameIndex, const vk::Extent2D& extent, bool recordGpuDraws);
+    // Returns true if the frame's shader object was created by this call
+    bool writeFrameData(const Scene& scene, const vk::Extent2D& extent, const Material& material);
 
     void onFrameBufferResized(int inWidth, int inHeight);
 
@@ -1,12 +1,137 @@
 ﻿#include "ShaderCompiler.hpp"
 
 #include <array>
+#include <format>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <string>
 
 #include "slang/slang-com-helper.h"
 
 static std::array<const char*, 1> baseShaderPaths{"../../VulkanRenderer/Shaders"}; // TODO: This should not be hardcoded
 
+// Source file contents handed to Slang
+class SourceBlob : public ISlangBlob
+{
+public:
+	explicit SourceBlob(std::string contents)
+		: contents(std::move(contents))
+	{
+	}
+
+	SLANG_NO_THROW SlangResult SLANG_MCALL queryInterface(const SlangUUID& uuid, void** outObject) override
+	{
+		if (uuid == ISlangUnknown::getTypeGuid() || uuid == ISlangBlob::getTypeGuid())
+		{
+			addRef();
+			*outObject = static_cast<ISlangBlob*>(this);
+			return SLANG_OK;
+		}
+		*outObject = nullptr;
+		return SLANG_E_NO_INTERFACE;
+	}
+
+	SLANG_NO_THROW uint32_t SLANG_MCALL addRef() override
+	{
+		return ++referenceCount;
+	}
+
+	SLANG_NO_THROW uint32_t SLANG_MCALL release() override
+	{
+		const uint32_t count{--referenceCount};
+		if (count == 0)
+		{
+			delete this;
+		}
+		return count;
+	}
+
+	SLANG_NO_THROW const void* SLANG_MCALL getBufferPointer() override
+	{
+		return contents.data();
+	}
+
+	SLANG_NO_THROW size_t SLANG_MCALL getBufferSize() override
+	{
+		return contents.size();
+	}
+
+private:
+	std::atomic<uint32_t> referenceCount{0};
+	std::string contents;
+};
+
+SlangResult SourceFileSystem::queryInterface(const SlangUUID& uuid, void** outObject)
+{
+	void* object{castAs(uuid)};
+	*outObject = object;
+	if (!object)
+	{
+		return SLANG_E_NO_INTERFACE;
+	}
+	addRef();
+	return SLANG_OK;
+}
+
+uint32_t SourceFileSystem::addRef()
+{
+	return ++referenceCount;
+}
+
+uint32_t SourceFileSystem::release()
+{
+	const uint32_t count{--referenceCount};
+	if (count == 0)
+	{
+		delete this;
+	}
+	return count;
+}
+
+void* SourceFileSystem::castAs(const SlangUUID& guid)
+{
+	if (guid == ISlangUnknown::getTypeGuid() || guid == ISlangCastable::getTypeGuid() || guid == ISlangFileSystem::getTypeGuid())
+	{
+		return static_cast<ISlangFileSystem*>(this);
+	}
+	return nullptr;
+}
+
+SlangResult SourceFileSystem::loadFile(const char* path, ISlangBlob** outBlob)
+{
+	std::ifstream file{path, std::ios::binary};
+	if (!file)
+	{
+		*outBlob = nullptr;
+		return SLANG_E_NOT_FOUND;
+	}
+	std::string contents{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+
+	// The session reads every file once. Should it read one again, the contents it compiled first are kept
+	const std::string& loaded{loadedFiles.try_emplace(getKey(path), std::move(contents)).first->second};
+	*outBlob = ComPtr<ISlangBlob>{new SourceBlob{loaded}}.detach();
+	return SLANG_OK;
+}
+
+std::optional<std::string> SourceFileSystem::getLoadedFile(const std::filesystem::path& path) const
+{
+	const auto file{loadedFiles.find(getKey(path))};
+	if (file == loadedFiles.end())
+	{
+		return std::nullopt;
+	}
+	return file->second;
+}
+
+std::filesystem::path SourceFileSystem::getKey(const std::filesystem::path& path)
+{
+	// Slang passes the paths relative to its search paths, materials know their sources by canonical path
+	std::error_code error;
+	std::filesystem::path canonicalPath{std::filesystem::weakly_canonical(path, error)};
+	return error ? path.lexically_normal() : canonicalPath;
+}
+
 SlangCompiler::SlangCompiler()
 	: globalSession(createGlobalSession()),
 	  targetDesc{
@@ -27,12 +152,14 @@ SlangCompiler::SlangCompiler()
 			  }
 		  }
 	  },
+	  fileSystem(new SourceFileSystem{}),
 	  sessionDesc{
 		  .targets = &targetDesc,
 		  .targetCount = 1,
 		  .defaultMatrixLayoutMode = SLANG_MATRIX_LAYOUT_COLUMN_MAJOR,
 		  .searchPaths = baseShaderPaths.data(),
 		  .searchPathCount = static_cast<uint32_t>(baseShaderPaths.size()),
+		  .fileSystem = fileSystem.get(),
 		  .compilerOptionEntries = options.data(),
 		  .compilerOptionEntryCount = static_cast<uint32_t>(options.size())
 	  },
@@ -140,6 +267,63 @@ slang::ProgramLayout* SlangCompiler::getProgramLayout(const ComPtr<slang::ICompo
 	return programLayout;
 }
 
+slang::VariableLayoutReflection* SlangCompiler::findGlobalParameter(const Slang::ComPtr<slang::IComponentType>& program, const std::string_view& name)
+{
+	slang::ProgramLayout* programLayout{getProgramLayout(program)};
+	for (unsigned i = 0; i < programLayout->getParameterCount(); ++i)
+	{
+		slang::VariableLayoutReflection* parameter{programLayout->getParameterByIndex(i)};
+		if (name == parameter->getName())
+		{
+			return parameter;
+		}
+	}
+	throw std::runtime_error("Failed to find global shader parameter " + std::string{name});
+}
+
+std::string SlangCompiler::describeOptions() const
+{
+	std::string description{std::format("slang {} target {} profile {} matrix layout {}", globalSession->getBuildTagString(), static_cast<int>(targetDesc.format),
+	                                    static_cast<int>(targetDesc.profile), static_cast<int>(sessionDesc.defaultMatrixLayoutMode))};
+	for (const slang::CompilerOptionEntry& option : options)
+	{
+		description += std::format(" option {} {} {}", static_cast<int>(option.name), option.value.intValue0, option.value.intValue1);
+	}
+	for (const char* searchPath : baseShaderPaths)
+	{
+		description += std::format(" search path {}", searchPath);
+	}
+	return description;
+}
+
+std::vector<std::filesystem::path> SlangCompiler::getDependencyFiles(const ComPtr<slang::IModule>& module)
+{
+	std::vector<std::filesystem::path> files{};
+	for (SlangInt32 i = 0; i < module->getDependencyFileCount(); ++i)
+	{
+		files.emplace_back(module->getDependencyFilePath(i));
+	}
+	return files;
+}
+
+std::optional<std::string> SlangCompiler::getLoadedSource(const std::filesystem::path& path) const
+{
+	return fileSystem->getLoadedFile(path);
+}
+
+std::vector<std::filesystem::path> SlangCompiler::getSearchPaths()
+{
+	return {baseShaderPaths.begin(), baseShaderPaths.end()};
+}
+
+void SlangCompiler::reloadSources()
+{
+	// Programs compiled by the previous session keep it and its file system alive
+	fileSystem = ComPtr<SourceFileSystem>{new SourceFileSystem{}};
+	sessionDesc.fileSystem = fileSystem.get();
+	session = createSession(globalSession, sessionDesc);
+}
+
 ComPtr<slang::IGlobalSession> SlangCompiler::createGlobalSession()
 {
 	ComPtr<slang::IGlobalSession> session;
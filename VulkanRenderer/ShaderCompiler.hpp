@@ -1,8 +1,13 @@
 ﻿#pragma once
 
+#include <atomic>
 #include <filesystem>
+#include <map>
+#include <memory>
+#include <optional>
 #include <span>
 #include <stdexcept>
+#include <string>
 #include <vector>
 
 #include "slang/slang.h"
@@ -10,12 +15,36 @@
 
 using Slang::ComPtr;
 
+// Loads the source files of a Slang session from disk and keeps what was loaded, so caches can tell whether a file changed after it was compiled
+// Reference counted like other Slang objects, used by one session only
+class SourceFileSystem : public ISlangFileSystem
+{
+public:
+	SLANG_NO_THROW SlangResult SLANG_MCALL queryInterface(const SlangUUID& uuid, void** outObject) override;
+	SLANG_NO_THROW uint32_t SLANG_MCALL addRef() override;
+	SLANG_NO_THROW uint32_t SLANG_MCALL release() override;
+	SLANG_NO_THROW void* SLANG_MCALL castAs(const SlangUUID& guid) override;
+	SLANG_NO_THROW SlangResult SLANG_MCALL loadFile(const char* path, ISlangBlob** outBlob) override;
+
+	// Contents of the file as the session loaded it. Empty if it did not load it
+	[[nodiscard]] std::optional<std::string> getLoadedFile(const std::filesystem::path& path) const;
+
+private:
+	std::atomic<uint32_t> referenceCount{0};
+	std::map<std::filesystem::path, std::string> loadedFiles; // By canonical path
+
+	static std::filesystem::path getKey(const std::filesystem::path& path);
+};
+
 class SlangCompiler
 {
 public:
 
 	SlangCompiler();
 
+	SlangCompiler(const SlangCompiler&) = delete;
+	SlangCompiler& operator=(const SlangCompiler&) = delete;
+
 	[[nodiscard]] ComPtr<slang::IModule> loadModule(const std::string_view& moduleName) const;
 	[[nodiscard]] static ComPtr<slang::IEntryPoint> findEntryPoint(const ComPtr<slang::IModule>& module, const std::string_view& entryPointName);
 	[[nodiscard]] ComPtr<slang::IComponentType> composeProgram(const std::vector<slang::IComponentType*>& components) const;
@@ -26,10 +55,25 @@ public:
 	[[nodiscard]] static ComPtr<slang::IComponentType> specializeProgram(const ComPtr<slang::IComponentType>& program, const std::span<slang::SpecializationArg>& specializationArgs);
 
 	[[nodiscard]] static slang::ProgramLayout* getProgramLayout(const ComPtr<slang::IComponentType>& program, int targetIndex = 0);
+	[[nodiscard]] static slang::VariableLayoutReflection* findGlobalParameter(const ComPtr<slang::IComponentType>& program, const std::string_view& name);
+
+	// Compiler version, target and options. Code compiled with a different description may differ
+	[[nodiscard]] std::string describeOptions() const;
+
+	// Files of the module and of everything it imports, transitively
+	[[nodiscard]] static std::vector<std::filesystem::path> getDependencyFiles(const ComPtr<slang::IModule>& module);
+	// Contents of a source file as the current session loaded it. Empty if it did not load it
+	[[nodiscard]] std::optional<std::string> getLoadedSource(const std::filesystem::path& path) const;
+	[[nodiscard]] static std::vector<std::filesystem::path> getSearchPaths();
+
+	// The session keeps every module it has loaded. Starts a new one, so changed source files are loaded again
+	void reloadSources();
+
 private:
 	ComPtr<slang::IGlobalSession> globalSession;
 	slang::TargetDesc targetDesc;
 	std::vector<slang::CompilerOptionEntry> options;
+	ComPtr<SourceFileSystem> fileSystem; // Replaced with the session
 	slang::SessionDesc sessionDesc;
 	ComPtr<slang::ISession> session;
 
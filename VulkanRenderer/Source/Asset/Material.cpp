@@ -4,29 +4,104 @@
 
 #include "Material.hpp"
 
+#include <algorithm>
 #include <array>
+#include <ranges>
+#include <stdexcept>
 
 #include "Renderer.hpp"
 #include "ShaderCompiler.hpp"
 #include "Vertex.hpp"
 #include "Debug/SlangDebug.hpp"
+#include "ShaderCompilation/PushConstantObject.hpp"
+#include "ShaderCompilation/ShaderCursor.hpp"
+#include "ShaderCompilation/SpirvCache.hpp"
 #include "Scene/Light/UniversalLightEnvironment.hpp"
 
 Material::Material(const std::string& materialModuleName, const std::string& materialTypeName)
 	: AssetBase(materialModuleName + " - " + materialTypeName),
-	  pipelineLayout(nullptr), pipeline(nullptr), materialModuleName(materialModuleName), materialTypeName(materialTypeName)
+	  pipelineLayout(nullptr), pipeline(nullptr), indirectPipeline(nullptr), materialModuleName(materialModuleName), materialTypeName(materialTypeName)
 {
 }
 
 void Material::compile(const SlangCompiler& compiler, const Renderer& app)
 {
-	auto [materialModule, materialType]{loadMaterial(materialModuleName, materialTypeName, compiler)};
-	auto [newProgram, existentialObjects]{compileMaterialProgram(materialModule, materialType, compiler)};
-	program = newProgram;
-	spirv = compileSpirv(program);
-	shaderLayout = std::make_unique<VulkanShaderObjectLayout>(SlangCompiler::getProgramLayout(program)->getGlobalParamsVarLayout(), existentialObjects, app);
-	pipelineLayout = createPipelineLayout(*shaderLayout, app);
-	pipeline = createPipeline(spirv, pipelineLayout, app);
+	// Everything is built before the old objects are retired, so a failed build never leaves the material without pipelines
+	CompiledMaterial compiled{build(materialModuleName, materialTypeName, compiler, app)};
+	apply(std::move(compiled), app);
+}
+
+CompiledMaterial Material::build(const std::string& materialModuleName, const std::string& materialTypeName, const SlangCompiler& compiler, const Renderer& app)
+{
+	const std::array moduleNames{std::string{"Core/mainRaster"}, std::string{"Core/lights"}, materialModuleName};
+	const std::array specializationArgs{UniversalLightEnvironment::getLightTypeNameStatic(), materialTypeName};
+	const std::string key{SpirvCache::makeKey(moduleNames, specializationArgs, compiler)};
+
+	std::optional<SpirvCache::Entry> entry{app.spirvCache.load(key)};
+	if (!entry || entry->entryPointCode.size() != 3 || entry->layouts.size() != 2)
+	{
+		entry = compileProgram(materialModuleName, materialTypeName, compiler, app);
+		app.spirvCache.store(key, *entry, compiler);
+	}
+	// Processes on other devices may share the cache
+	PushConstantObject::checkRange(entry->pushConstantRange, "gDraw", app);
+
+	CompiledMaterial compiled{};
+	compiled.spirv = {std::move(entry->entryPointCode[0]), std::move(entry->entryPointCode[1]), std::move(entry->entryPointCode[2])};
+	compiled.frameLayout = std::make_shared<VulkanShaderObjectLayout>(std::move(entry->layouts[0]), app);
+	compiled.shaderLayout = std::make_shared<VulkanShaderObjectLayout>(std::move(entry->layouts[1]), app);
+	compiled.drawInstanceOffset = entry->drawInstanceOffset;
+	compiled.drawDataRange = entry->pushConstantRange;
+	compiled.sourceFiles = std::move(entry->sourceFiles);
+	compiled.pipelineLayout = createPipelineLayout({compiled.frameLayout.get(), compiled.shaderLayout.get()}, {compiled.drawDataRange}, app);
+	compiled.pipeline = createPipeline(compiled.spirv.vertSpirv, compiled.spirv.fragSpirv, compiled.pipelineLayout, app);
+	compiled.indirectPipeline = createPipeline(compiled.spirv.vertIndirectSpirv, compiled.spirv.fragSpirv, compiled.pipelineLayout, app);
+	return compiled;
+}
+
+void Material::apply(CompiledMaterial&& compiled, const Renderer& app)
+{
+	if (isCompiled() && (!frameLayout->isCompatible(*compiled.frameLayout) || !shaderLayout->isCompatible(*compiled.shaderLayout)))
+	{
+		throw std::runtime_error("Parameters of material " + name + " changed. Restart to apply the changes");
+	}
+
+	// Frames in flight may still draw with the results of an earlier compile
+	app.deletionQueue.push(std::move(pipeline));
+	app.deletionQueue.push(std::move(indirectPipeline));
+	app.deletionQueue.push(std::move(pipelineLayout));
+	app.deletionQueue.push(std::move(frameLayout));
+	app.deletionQueue.push(std::move(shaderLayout));
+
+	spirv = std::move(compiled.spirv);
+	frameLayout = std::move(compiled.frameLayout);
+	shaderLayout = std::move(compiled.shaderLayout);
+	drawInstanceOffset = compiled.drawInstanceOffset;
+	drawDataRange = compiled.drawDataRange;
+	pipelineLayout = std::move(compiled.pipelineLayout);
+	pipeline = std::move(compiled.pipeline);
+	indirectPipeline = std::move(compiled.indirectPipeline);
+	sourceFiles = std::move(compiled.sourceFiles);
+}
+
+const std::string& Material::getModuleName() const
+{
+	return materialModuleName;
+}
+
+const std::string& Material::getTypeName() const
+{
+	return materialTypeName;
+}
+
+bool Material::isCompiled() const
+{
+	return shaderLayout != nullptr;
+}
+
+bool Material::dependsOn(const std::filesystem::path& file) const
+{
+	return !isCompiled() || std::ranges::contains(sourceFiles, file);
 }
 
 std::pair<Slang::ComPtr<slang::IModule>, slang::TypeReflection*> Material::loadMaterial(const std::string_view& materialModuleName, const std::string_view& materialType, const SlangCompiler& compiler)
@@ -36,10 +111,61 @@ std::pair<Slang::ComPtr<slang::IModule>, slang::TypeReflection*> Material::loadM
 	return {materialModule, material};
 }
 
-Spirv Material::compileSpirv(const Slang::ComPtr<slang::IComponentType>& program)
+SpirvCache::Entry Material::compileProgram(const std::string& materialModuleName, const std::string& materialTypeName, const SlangCompiler& compiler, const Renderer& app)
+{
+	auto [materialModule, materialType]{loadMaterial(materialModuleName, materialTypeName, compiler)};
+	auto [program, existentialObjects]{compileMaterialProgram(materialModule, materialType, compiler)};
+
+	const auto modules{loadModules(materialModuleName, compiler)};
+
+	// Reflection is copied out of the session, so nothing built from it refers to Slang objects
+	SpirvCache::Entry entry{};
+	entry.sourceFiles = getSourceFiles(modules);
+	entry.entryPointCode = generateSpirv(program);
+	entry.layouts.push_back(VulkanShaderObjectLayout::reflect(SlangCompiler::findGlobalParameter(program, "gFrame"), {existentialObjects[0]}));
+	entry.layouts.push_back(VulkanShaderObjectLayout::reflect(SlangCompiler::findGlobalParameter(program, "gMaterial"), {existentialObjects[1]}));
+	slang::VariableLayoutReflection* drawParameter{SlangCompiler::findGlobalParameter(program, "gDraw")};
+	PushConstantObject drawData{std::make_shared<const ShaderTypeLayout>(drawParameter->getTypeLayout()->getElementTypeLayout())};
+	entry.drawInstanceOffset = ShaderCursor{&drawData}.field("instanceOffset").getOffset();
+	entry.pushConstantRange = PushConstantObject::getRange(drawParameter, vk::ShaderStageFlagBits::eVertex, app);
+	return entry;
+}
+
+std::vector<std::vector<uint32_t>> Material::generateSpirv(const Slang::ComPtr<slang::IComponentType>& program)
 {
 	auto linked{SlangCompiler::linkProgram(program)};
-	return {SlangCompiler::getSprirV(linked, 0), SlangCompiler::getSprirV(linked, 1)};
+	std::vector<std::vector<uint32_t>> entryPointCode(3);
+	for (const auto& [entryPointIndex, code] : entryPointCode | std::ranges::views::enumerate)
+	{
+		const auto blob{SlangCompiler::getSprirV(linked, static_cast<uint32_t>(entryPointIndex))};
+		const auto* words{static_cast<const uint32_t*>(blob->getBufferPointer())};
+		code.assign(words, words + blob->getBufferSize() / sizeof(uint32_t));
+	}
+	return entryPointCode;
+}
+
+std::array<Slang::ComPtr<slang::IModule>, 3> Material::loadModules(const std::string& materialModuleName, const SlangCompiler& compiler)
+{
+	// Modules are only loaded once per session, so this just looks up the ones the program was composed of
+	return {compiler.loadModule("Core/mainRaster"), compiler.loadModule("Core/lights"), compiler.loadModule(materialModuleName)};
+}
+
+std::vector<std::filesystem::path> Material::getSourceFiles(const std::span<const Slang::ComPtr<slang::IModule>> modules)
+{
+	std::vector<std::filesystem::path> files{};
+	for (const auto& module : modules)
+	{
+		for (const std::filesystem::path& file : SlangCompiler::getDependencyFiles(module))
+		{
+			std::error_code error;
+			std::filesystem::path canonicalFile{std::filesystem::weakly_canonical(file, error)};
+			if (!error && !std::ranges::contains(files, canonicalFile))
+			{
+				files.push_back(std::move(canonicalFile));
+			}
+		}
+	}
+	return files;
 }
 
 std::pair<ComPtr<slang::IComponentType>, std::vector<slang::TypeLayoutReflection*>> Material::compileMaterialProgram(const Slang::ComPtr<slang::IModule>& materialModule,
@@ -49,11 +175,12 @@ std::pair<ComPtr<slang::IComponentType>, std::vector<slang::TypeLayoutReflection
 	auto rasterModule{compiler.loadModule("Core/mainRaster")};
 	auto vertEntry{SlangCompiler::findEntryPoint(rasterModule, "vertexMain")};
 	auto fragEntry{SlangCompiler::findEntryPoint(rasterModule, "fragmentMain")};
+	auto vertIndirectEntry{SlangCompiler::findEntryPoint(rasterModule, "vertexMainIndirect")};
 
 	auto lightModule{compiler.loadModule("Core/lights")};
 	auto lightType{lightModule->getLayout()->findTypeByName(UniversalLightEnvironment::getLightTypeNameStatic().c_str())};
 
-	auto composedProgram{compiler.composeProgram({rasterModule, vertEntry, fragEntry, materialModule, lightModule})};
+	auto composedProgram{compiler.composeProgram({rasterModule, vertEntry, fragEntry, vertIndirectEntry, materialModule, lightModule})};
 
 	// TODO: Try to specialize by type
 	std::array specializationArgs
@@ -72,17 +199,31 @@ std::pair<ComPtr<slang::IComponentType>, std::vector<slang::TypeLayoutReflection
 	return {program, {program->getLayout()->getTypeLayout(lightType), program->getLayout()->getTypeLayout(materialType)}};
 }
 
-vk::raii::PipelineLayout Material::createPipelineLayout(const VulkanShaderObjectLayout& layout, const Renderer& app)
+vk::raii::PipelineLayout Material::createPipelineLayout(const std::vector<const VulkanShaderObjectLayout*>& layouts, const std::vector<vk::PushConstantRange>& pushConstantRanges,
+                                                        const Renderer& app)
 {
-	vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo{{}, *layout.descriptorSetLayout, nullptr};
+	// Layouts are expected in set order, the renderer binds them by index
+	std::vector<vk::DescriptorSetLayout> setLayouts{};
+	setLayouts.reserve(layouts.size());
+	for (const auto& [setIndex, layout] : layouts | std::ranges::views::enumerate)
+	{
+		if (layout->getSetIndex() != static_cast<uint32_t>(setIndex))
+		{
+			throw std::runtime_error("Shader parameter block is not in the expected descriptor set");
+		}
+		setLayouts.push_back(layout->descriptorSetLayout);
+	}
+
+	vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo{{}, setLayouts, pushConstantRanges};
 
 	return {app.device, pipelineLayoutCreateInfo};
 }
 
-vk::raii::Pipeline Material::createPipeline(const Spirv& spirv, const vk::raii::PipelineLayout& layout, const Renderer& app)
+vk::raii::Pipeline Material::createPipeline(const std::span<const uint32_t> vertSpirv, const std::span<const uint32_t> fragSpirv, const vk::raii::PipelineLayout& layout,
+                                            const Renderer& app)
 {
-	vk::raii::ShaderModule vertShaderModule{createShaderModule(spirv.vertSpirv, app.device)};
-	vk::raii::ShaderModule fragShaderModule{createShaderModule(spirv.fragSpirv, app.device)};
+	vk::raii::ShaderModule vertShaderModule{createShaderModule(vertSpirv, app.device)};
+	vk::raii::ShaderModule fragShaderModule{createShaderModule(fragSpirv, app.device)};
 
 	vk::PipelineShaderStageCreateInfo vertShaderStageCreateInfo{{}, vk::ShaderStageFlagBits::eVertex, vertShaderModule, "main", nullptr};
 	vk::PipelineShaderStageCreateInfo fragShaderStageCreateInfo{{}, vk::ShaderStageFlagBits::eFragment, fragShaderModule, "main", nullptr};
@@ -120,16 +261,20 @@ vk::raii::Pipeline Material::createPipeline(const Spirv& spirv, const vk::raii::
 
 	vk::PipelineDepthStencilStateCreateInfo depthStencilInfo{{}, true, true, vk::CompareOp::eLessOrEqual, false, false, {}, {}, 0.f, 1.f};
 
+	// Rendering is dynamic, so the pipeline only needs the formats of the attachments instead of a render pass
+	const vk::Format colorFormat{app.getColorFormat()};
+	const vk::PipelineRenderingCreateInfo renderingCreateInfo{0, colorFormat, app.depthFormat};
+
 	vk::GraphicsPipelineCreateInfo pipelineCreateInfo{
 		{}, shaderStages, &vertexInputStateCreateInfo, &inputAssemblyStateCreateInfo, nullptr, &viewportStateCreateInfo, &rasterizer, &multisampleState,
-		&depthStencilInfo, &colorBlendStateCreateInfo, &dynamicState, layout, app.renderPass, 0, {}, -1
+		&depthStencilInfo, &colorBlendStateCreateInfo, &dynamicState, layout, nullptr, 0, {}, -1, &renderingCreateInfo
 	};
 
-	return {app.device, nullptr, pipelineCreateInfo};
+	return app.pipelineCache.createGraphicsPipeline(pipelineCreateInfo);
 }
 
-vk::raii::ShaderModule Material::createShaderModule(const Slang::ComPtr<slang::IBlob>& codeBlob, const vk::raii::Device& device)
+vk::raii::ShaderModule Material::createShaderModule(const std::span<const uint32_t> code, const vk::raii::Device& device)
 {
-	const vk::ShaderModuleCreateInfo createInfo{{}, codeBlob->getBufferSize(), static_cast<const uint32_t*>(codeBlob->getBufferPointer())};
+	const vk::ShaderModuleCreateInfo createInfo{{}, code.size_bytes(), code.data()};
 	return device.createShaderModule(createInfo);
 }
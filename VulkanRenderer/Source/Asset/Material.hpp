@@ -1,43 +1,101 @@
 ﻿#pragma once
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <vector>
 #include <slang/slang-com-ptr.h>
 
 #include "AssetBase.hpp"
+#include "ShaderCompilation/SpirvCache.hpp"
 #include "ShaderCompilation/VulkanShaderObjectLayout.hpp"
 
 struct Spirv
 {
 public:
-	Slang::ComPtr<slang::IBlob> vertSpirv;
-	Slang::ComPtr<slang::IBlob> fragSpirv;
+	std::vector<uint32_t> vertSpirv;
+	std::vector<uint32_t> fragSpirv;
+	// Vertex entry point for GPU-driven draws. Shares the fragment shader
+	std::vector<uint32_t> vertIndirectSpirv;
 };
 
 class SlangCompiler;
 
+// Everything a compile of a material produces. Built without touching the material, so it can be built on any thread while the material is drawn
+// Holds no Slang objects, so it can be used and released on any thread
+struct CompiledMaterial
+{
+	Spirv spirv;
+	std::shared_ptr<VulkanShaderObjectLayout> frameLayout;
+	std::shared_ptr<VulkanShaderObjectLayout> shaderLayout;
+	ShaderOffset drawInstanceOffset{};
+	vk::PushConstantRange drawDataRange{};
+	vk::raii::PipelineLayout pipelineLayout{nullptr};
+	vk::raii::Pipeline pipeline{nullptr};
+	vk::raii::Pipeline indirectPipeline{nullptr};
+	// Canonical paths of every source file the program was compiled from
+	std::vector<std::filesystem::path> sourceFiles;
+};
+
+// Descriptor sets of Core/mainRaster.slang, split by how often they are written
+enum DescriptorSetIndex : uint32_t
+{
+	frameSetIndex = 0,
+	materialSetIndex = 1
+};
+
 class Material : public AssetBase
 {
 public:
 	Material(const std::string& materialModuleName, const std::string& materialTypeName);
 
+	// Builds and applies right away. A build that throws leaves the results of the previous compile in place
 	void compile(const SlangCompiler& compiler, const Renderer& app);
+	// Only needs the names of a material, so a worker can build without touching the material, which may move or be unloaded meanwhile
+	// Takes the code and reflection from the SPIR-V cache if its sources are unchanged, without loading any module
+	[[nodiscard]] static CompiledMaterial build(const std::string& materialModuleName, const std::string& materialTypeName, const SlangCompiler& compiler, const Renderer& app);
+	// Replaces the results of the previous compile. Frames in flight keep drawing with them until they finish
+	// Shader objects of the material's instances and of the frame keep their layouts, so results with different ones are refused by throwing
+	void apply(CompiledMaterial&& compiled, const Renderer& app);
 
-	Spirv spirv;
+	[[nodiscard]] const std::string& getModuleName() const;
+	[[nodiscard]] const std::string& getTypeName() const;
 
-	Slang::ComPtr<slang::IComponentType> program;
+	// False until the first compile has been applied
+	[[nodiscard]] bool isCompiled() const;
+	// Whether the applied compile read the canonical path file. Materials that have not compiled yet depend on every file
+	[[nodiscard]] bool dependsOn(const std::filesystem::path& file) const;
+
+	Spirv spirv;
 
-	std::shared_ptr<VulkanShaderObjectLayout> shaderLayout; // TODO: This all screams for a refactor that separates material assets from compiled materials
+	// Descriptor set layouts by update frequency. Frame and draw layouts are the same for all materials, so their sets can be shared
+	std::shared_ptr<VulkanShaderObjectLayout> frameLayout; // Set 0
+	std::shared_ptr<VulkanShaderObjectLayout> shaderLayout; // Set 1 TODO: This all screams for a refactor that separates material assets from compiled materials
+	// Per-draw data is pushed as push constants. Per-instance data lives in the frame's instance buffer
+	// Offset of its instanceOffset field, looked up at compile time so recording threads do not read reflection
+	ShaderOffset drawInstanceOffset{};
+	vk::PushConstantRange drawDataRange{};
 	vk::raii::PipelineLayout pipelineLayout;
 	vk::raii::Pipeline pipeline;
+	vk::raii::Pipeline indirectPipeline; // Used by GPU-driven rendering
 
 private:
 	std::string materialModuleName;
 	std::string materialTypeName;
+	std::vector<std::filesystem::path> sourceFiles;
 
 	static std::pair<Slang::ComPtr<slang::IModule>, slang::TypeReflection*> loadMaterial(const std::string_view& materialModuleName, const std::string_view& materialType,
 	                                                                                     const SlangCompiler& compiler);
-	static Spirv compileSpirv(const Slang::ComPtr<slang::IComponentType>& program);
+	// Runs the whole Slang pipeline. Produces what the cache stores, so cached and compiled materials are built the same way
+	static SpirvCache::Entry compileProgram(const std::string& materialModuleName, const std::string& materialTypeName, const SlangCompiler& compiler, const Renderer& app);
+	static std::vector<std::vector<uint32_t>> generateSpirv(const Slang::ComPtr<slang::IComponentType>& program);
+	// Modules the program of the material is composed of
+	static std::array<Slang::ComPtr<slang::IModule>, 3> loadModules(const std::string& materialModuleName, const SlangCompiler& compiler);
+	static std::vector<std::filesystem::path> getSourceFiles(std::span<const Slang::ComPtr<slang::IModule>> modules);
 	static std::pair<Slang::ComPtr<slang::IComponentType>, std::vector<slang::TypeLayoutReflection*>> compileMaterialProgram(const Slang::ComPtr<slang::IModule>& materialModule, slang::TypeReflection* materialType,
 	                                                                                                     const SlangCompiler& compiler);
-	static vk::raii::PipelineLayout createPipelineLayout(const VulkanShaderObjectLayout& layout, const Renderer& app);
-	static vk::raii::Pipeline createPipeline(const Spirv &spirv, const vk::raii::PipelineLayout& layout, const Renderer& app);
-	static vk::raii::ShaderModule createShaderModule(const Slang::ComPtr<slang::IBlob>& codeBlob, const vk::raii::Device& device);
+	static vk::raii::PipelineLayout createPipelineLayout(const std::vector<const VulkanShaderObjectLayout*>& layouts, const std::vector<vk::PushConstantRange>& pushConstantRanges,
+	                                                     const Renderer& app);
+	static vk::raii::Pipeline createPipeline(std::span<const uint32_t> vertSpirv, std::span<const uint32_t> fragSpirv, const vk::raii::PipelineLayout& layout, const Renderer& app);
+	static vk::raii::ShaderModule createShaderModule(std::span<const uint32_t> code, const vk::raii::Device& device);
 };
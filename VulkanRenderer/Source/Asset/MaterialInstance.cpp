@@ -4,15 +4,48 @@
 
 #include "MaterialInstance.hpp"
 
+#include <stdexcept>
+
 #include "Material.hpp"
 #include "ShaderCompilation/ShaderCursor.hpp"
 
 MaterialInstance::MaterialInstance(const AssetHandle<Material>& parentMaterial, const std::string& name)
-	: AssetBase(name), parentMaterial(parentMaterial), shaderObject(parentMaterial->shaderLayout)
+	: AssetBase(name), parentMaterial(parentMaterial)
+{
+	prepare();
+}
+
+bool MaterialInstance::prepare()
 {
+	if (!shaderObject && parentMaterial->isCompiled())
+	{
+		shaderObject.emplace(parentMaterial->shaderLayout);
+
+		const ShaderCursor cursor{&*shaderObject};
+		for (const auto& write : pendingWrites)
+		{
+			write(cursor);
+		}
+		pendingWrites.clear();
+	}
+	return shaderObject.has_value();
 }
 
 ShaderCursor MaterialInstance::getShaderCursor()
 {
-	return ShaderCursor{&shaderObject};
+	if (!prepare())
+	{
+		throw std::runtime_error("Material instance " + name + " is written before its material has compiled");
+	}
+	return ShaderCursor{&*shaderObject};
+}
+
+void MaterialInstance::writeWhenReady(std::function<void(const ShaderCursor&)>&& write)
+{
+	if (prepare())
+	{
+		write(ShaderCursor{&*shaderObject});
+		return;
+	}
+	pendingWrites.push_back(std::move(write));
 }
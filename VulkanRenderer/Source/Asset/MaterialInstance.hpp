@@ -1,4 +1,8 @@
 ﻿#pragma once
+#include <functional>
+#include <optional>
+#include <vector>
+
 #include "AssetBase.hpp"
 #include "Material.hpp"
 #include "AssetSystem/AssetHandle.hpp"
@@ -9,10 +13,21 @@ struct ShaderCursor;
 class MaterialInstance : public AssetBase
 {
 public:
+	// The parent material may still be compiling. The instance can only be drawn and written once it has compiled
 	explicit MaterialInstance(const AssetHandle<Material>& parentMaterial, const std::string& name);
 
+	// Creates the shader object once the parent material has compiled, and applies the writes queued until then. Returns whether the instance can be drawn
+	bool prepare();
+
+	// Throws until prepare returns true. Instances whose material may still be compiling are written through writeWhenReady instead
 	ShaderCursor getShaderCursor();
+	// Calls write with the cursor of the instance right away if the material has compiled. Otherwise write is queued and called by prepare,
+	// which runs before the instance is first drawn. Queued writes are called in the order they were queued
+	void writeWhenReady(std::function<void(const ShaderCursor&)>&& write);
 
 	AssetHandle<Material> parentMaterial;
-	VulkanShaderObject shaderObject;
+	std::optional<VulkanShaderObject> shaderObject; // Empty until the parent material has compiled
+
+private:
+	std::vector<std::function<void(const ShaderCursor&)>> pendingWrites;
 };
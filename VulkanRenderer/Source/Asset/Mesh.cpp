@@ -1,11 +1,14 @@
 ﻿#include "Mesh.hpp"
 
+#include <algorithm>
+#include <cmath>
 #include <assimp/Importer.hpp>
 
 //#define TINYOBJLOADER_IMPLEMENTATION
 //#include "tiny_obj_loader.h"
 #include "assimp/postprocess.h"
 #include "assimp/scene.h"
+#include "Renderer.hpp"
 
 RawMesh::RawMesh(const std::filesystem::path& sourcePath)
 	: RawMesh(loadFromFile(sourcePath))
@@ -110,9 +113,92 @@ RawMesh RawMesh::loadFromFile(const std::filesystem::path& sourcePath)
 
 
 Mesh::Mesh(const Renderer& app, const std::filesystem::path& sourcePath)
+	: Mesh(app, sourcePath, RawMesh{sourcePath})
+{
+}
+
+Mesh::Mesh(const Renderer& app, const std::filesystem::path& sourcePath, RawMesh&& rawMesh)
 	: AssetBase(sourcePath.filename().string()),
-	  rawMesh(sourcePath),
-	  vertexBuffer(app, rawMesh.vertices, vk::BufferUsageFlagBits::eVertexBuffer, vk::MemoryPropertyFlagBits::eDeviceLocal),
-	  indexBuffer(app, rawMesh.indices, vk::BufferUsageFlagBits::eIndexBuffer, vk::MemoryPropertyFlagBits::eDeviceLocal)
+	  indexCount(static_cast<uint32_t>(rawMesh.indices.size())),
+	  boundingBox(computeBoundingBox(rawMesh)),
+	  boundingSphere(computeBoundingSphere(rawMesh, boundingBox)),
+	  buffers(std::make_unique<MeshBuffers>(app, rawMesh))
+{
+}
+
+void Mesh::markUsed() const
+{
+	buffers->markUsed();
+}
+
+const Buffer& Mesh::getVertexBuffer() const
+{
+	return *buffers->vertexBuffer;
+}
+
+const Buffer& Mesh::getIndexBuffer() const
+{
+	return *buffers->indexBuffer;
+}
+
+MeshBuffers::MeshBuffers(const Renderer& app, const RawMesh& rawMesh)
+	: EvictableResource(app.residencyManager, rawMesh.vertices.size() * sizeof(Vertex) + rawMesh.indices.size() * sizeof(Index)),
+	  app(app), blob({std::as_bytes(std::span{rawMesh.vertices}), std::as_bytes(std::span{rawMesh.indices})}), vertexBytes(rawMesh.vertices.size() * sizeof(Vertex))
+{
+}
+
+vk::DeviceSize MeshBuffers::restore()
 {
+	// The raw mesh is not kept after the import, and the blob moves to disk once the buffers are evicted
+	const std::vector<std::byte> data{blob.read()};
+	const std::span<const std::byte> bytes{data};
+
+	Buffer newVertexBuffer{
+		app, vertexBytes, vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eVertexBuffer, vk::MemoryPropertyFlagBits::eDeviceLocal, MemoryCategory::Mesh
+	};
+	Buffer newIndexBuffer{
+		app, bytes.size() - vertexBytes, vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eIndexBuffer, vk::MemoryPropertyFlagBits::eDeviceLocal, MemoryCategory::Mesh
+	};
+	Buffer::copySpanToBufferStaged(app, bytes.first(vertexBytes), newVertexBuffer);
+	Buffer::copySpanToBufferStaged(app, bytes.subspan(vertexBytes), newIndexBuffer);
+
+	vertexBuffer = std::move(newVertexBuffer);
+	indexBuffer = std::move(newIndexBuffer);
+	return vertexBuffer->allocation.getSize() + indexBuffer->allocation.getSize();
+}
+
+void MeshBuffers::evict()
+{
+	blob.spill();
+	vertexBuffer.reset();
+	indexBuffer.reset();
+}
+
+BoundingBox Mesh::computeBoundingBox(const RawMesh& rawMesh)
+{
+	if (rawMesh.vertices.empty())
+	{
+		return {};
+	}
+
+	BoundingBox boundingBox{rawMesh.vertices.front().position, rawMesh.vertices.front().position};
+	for (const Vertex& vertex : rawMesh.vertices)
+	{
+		boundingBox.minimum = glm::min(boundingBox.minimum, vertex.position);
+		boundingBox.maximum = glm::max(boundingBox.maximum, vertex.position);
+	}
+	return boundingBox;
+}
+
+glm::vec4 Mesh::computeBoundingSphere(const RawMesh& rawMesh, const BoundingBox& boundingBox)
+{
+	// Centered on the bounding box. Not minimal, but cheap and good enough for culling
+	const glm::vec3 center{boundingBox.getCenter()};
+	float radiusSquared{0.f};
+	for (const Vertex& vertex : rawMesh.vertices)
+	{
+		const glm::vec3 offset{vertex.position - center};
+		radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+	}
+	return glm::vec4{center, std::sqrt(radiusSquared)};
 }
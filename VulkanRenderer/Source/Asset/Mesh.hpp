@@ -1,10 +1,15 @@
 ﻿#pragma once
 #include <vector>
 #include <filesystem>
+#include <memory>
+#include <optional>
 
 #include "AssetBase.hpp"
 #include "Buffer.hpp"
 #include "Vertex.hpp"
+#include "Renderer/ResidencyBlob.hpp"
+#include "Renderer/ResidencyManager.hpp"
+#include "Scene/Core/BoundingBox.hpp"
 
 using Index = uint32_t;
 
@@ -21,12 +26,49 @@ private:
 	RawMesh(std::vector<Vertex>&& vertices, std::vector<Index>&& indices);
 };
 
+// Vertex and index buffers of a mesh. Evicted by the residency manager when they are not drawn, and uploaded again from a blob of the imported data once they are
+class MeshBuffers : public EvictableResource
+{
+public:
+	MeshBuffers(const Renderer& app, const RawMesh& rawMesh);
+
+	// Only valid while resident
+	std::optional<Buffer> vertexBuffer;
+	std::optional<Buffer> indexBuffer;
+
+protected:
+	vk::DeviceSize restore() override;
+	void evict() override;
+
+private:
+	const Renderer& app;
+	// Vertices followed by indices
+	ResidencyBlob blob;
+	size_t vertexBytes;
+};
+
 class Mesh : public AssetBase
 {
 public:
 	Mesh(const Renderer& app, const std::filesystem::path& sourcePath);
 
-	RawMesh rawMesh;
-	Buffer vertexBuffer;
-	Buffer indexBuffer;
+	uint32_t indexCount;
+	// Bounds in model space, computed on import
+	BoundingBox boundingBox;
+	glm::vec4 boundingSphere; // xyz is the center, w the radius
+
+	// Has to be called in every frame drawing the mesh before the draws are recorded. Uploads the buffers again if they were evicted
+	void markUsed() const;
+
+	[[nodiscard]] const Buffer& getVertexBuffer() const;
+	[[nodiscard]] const Buffer& getIndexBuffer() const;
+
+private:
+	// Kept on the heap, so the residency manager can refer to them while the asset moves
+	std::unique_ptr<MeshBuffers> buffers;
+
+	Mesh(const Renderer& app, const std::filesystem::path& sourcePath, RawMesh&& rawMesh);
+
+	static BoundingBox computeBoundingBox(const RawMesh& rawMesh);
+	static glm::vec4 computeBoundingSphere(const RawMesh& rawMesh, const BoundingBox& boundingBox);
 };
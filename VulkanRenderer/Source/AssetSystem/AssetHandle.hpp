@@ -20,6 +20,8 @@ public:
 
 	[[nodiscard]] AssetManager& getAssetManager() {return assetManager;}
 	[[nodiscard]] const AssetManager& getAssetManager() const {return assetManager;}
+	// Identifies the asset without a lookup in the asset manager
+	[[nodiscard]] UUID getUUID() const {return uuid;}
 
 private:
 	AssetManager& assetManager;
@@ -4,6 +4,17 @@
 
 #include "AssetManager.hpp"
 
+AssetManager::AssetManager(DeletionQueue& deletionQueue)
+	: deletionQueue(deletionQueue)
+{
+}
+
+AssetManager::~AssetManager()
+{
+	// Unloaded assets may hold handles to other assets, which have to be released while this manager still exists. The device is idle by now
+	deletionQueue.flush();
+}
+
 void AssetManager::increaseRefCount(const size_t assetUUID)
 {
 	if (assetUUID != 0)
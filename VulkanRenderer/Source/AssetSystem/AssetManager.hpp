@@ -4,6 +4,7 @@
 
 #include "AssetArray.hpp"
 #include "AssetSystemStructs.h"
+#include "Renderer/DeletionQueue.hpp"
 
 template <Asset T>
 struct AssetHandle;
@@ -11,6 +12,10 @@ struct AssetHandle;
 class AssetManager
 {
 public:
+	// Unloaded assets are destroyed through deletionQueue, as frames in flight may still use their GPU resources
+	explicit AssetManager(DeletionQueue& deletionQueue);
+	~AssetManager();
+
 	template <Asset T, typename... Args>
 	AssetHandle<T> createAsset(Args&&... args);
 
@@ -36,6 +41,8 @@ private:
 
 	size_t currentUUID{1};
 
+	DeletionQueue& deletionQueue;
+
 	template <Asset T>
 	friend struct AssetHandle;
 };
@@ -108,7 +115,9 @@ void AssetManager::decreaseRefCount(const size_t assetUUID)
 		assetInfo.refCount -= 1;
 		if (assetInfo.refCount == 0)
 		{
-			const UUID lastAssetUUID{assets.find(assetInfo.type)->second.destruct<T>(assetInfo.index)};
+			AssetArray& array{assets.find(assetInfo.type)->second};
+			deletionQueue.push(std::move(array.at<T>(assetInfo.index)));
+			const UUID lastAssetUUID{array.destruct<T>(assetInfo.index)};
 			if (lastAssetUUID.value > 0)
 			{
 				auto& lastAssetInfo{assetInfosByUUID.find(lastAssetUUID.value)->second};
@@ -16,7 +16,7 @@ void SimplePBRMaterial::DrawImGui()
 	{
 		ImGui::SeparatorText("Simple PBR Material");
 
-		const ShaderCursor materialCursor{(*materialHandle)->getShaderCursor().field("gMaterial")};
+		const ShaderCursor materialCursor{(*materialHandle)->getShaderCursor().field("material")};
 
 		ImGui::Text("Albedo:");
 		if (ImGui::ColorEdit3("##albedo", reinterpret_cast<float*>(&albedo)))
@@ -54,7 +54,7 @@ void SimplePBRMaterial::Initialize(AssetHandle<MaterialInstance>&& material)
 {
 	materialHandle = std::move(material);
 
-	const ShaderCursor materialCursor{(*materialHandle)->getShaderCursor().field("gMaterial")};
+	const ShaderCursor materialCursor{(*materialHandle)->getShaderCursor().field("material")};
 	materialCursor.field("albedo").write(albedo);
 	materialCursor.field("f0").write(f0);
 	materialCursor.field("f90").write(f90);
@@ -68,7 +68,7 @@ void SimpleHorizontalBlendDemo::DrawImGui()
 	{
 		ImGui::SeparatorText("Simple Horizontal Blend Material");
 
-		const ShaderCursor materialCursor{(*materialHandle)->getShaderCursor().field("gMaterial")};
+		const ShaderCursor materialCursor{(*materialHandle)->getShaderCursor().field("material")};
 
 		ImGui::Text("Albedo1:");
 		if (ImGui::ColorEdit3("##albedo1", reinterpret_cast<float*>(&albedo1)))
@@ -118,7 +118,7 @@ void SimpleHorizontalBlendDemo::Initialize(AssetHandle<MaterialInstance>&& mater
 {
 	materialHandle = std::move(material);
 
-	const ShaderCursor materialCursor{(*materialHandle)->getShaderCursor().field("gMaterial")};
+	const ShaderCursor materialCursor{(*materialHandle)->getShaderCursor().field("material")};
 	materialCursor.field("albedo1").write(albedo1);
 	materialCursor.field("metallic1").write(metallic1);
 	materialCursor.field("roughness1").write(roughness1);
@@ -136,7 +136,7 @@ void SimpleVerticalBlendDemo::DrawImGui()
 
 		ImGui::SeparatorText("Simple Vertical Layer Material");
 
-		const ShaderCursor materialCursor{(*materialHandle)->getShaderCursor().field("gMaterial")};
+		const ShaderCursor materialCursor{(*materialHandle)->getShaderCursor().field("material")};
 
 		ImGui::Text("Bottom Albedo:");
 		if (ImGui::ColorEdit3("##bottomAlbedo", reinterpret_cast<float*>(&bottomAlbedo)))
@@ -207,7 +207,7 @@ void SimpleVerticalBlendDemo::Initialize(AssetHandle<MaterialInstance>&& materia
 {
 	materialHandle = std::move(material);
 
-	const ShaderCursor materialCursor{(*materialHandle)->getShaderCursor().field("gMaterial")};
+	const ShaderCursor materialCursor{(*materialHandle)->getShaderCursor().field("material")};
 	materialCursor.field("bottomAlbedo").write(bottomAlbedo);
 	materialCursor.field("bottomMetallic").write(bottomMetallic);
 	materialCursor.field("bottomRoughness").write(bottomRoughness);
@@ -228,7 +228,7 @@ void OpalDemo::DrawImGui()
 
 		ImGui::SeparatorText("Opal Material");
 
-		const ShaderCursor materialCursor{(*materialHandle)->getShaderCursor().field("gMaterial")};
+		const ShaderCursor materialCursor{(*materialHandle)->getShaderCursor().field("material")};
 
 		ImGui::Text("Texture Tiling:");
 		if (ImGui::DragFloat("##textureTiling", &textureTiling, .1f, 0.f, 0.f))
@@ -341,7 +341,7 @@ void OpalDemo::Initialize(AssetHandle<MaterialInstance>&& material)
 {
 	materialHandle = std::move(material);
 
-	const ShaderCursor materialCursor{(*materialHandle)->getShaderCursor().field("gMaterial")};
+	const ShaderCursor materialCursor{(*materialHandle)->getShaderCursor().field("material")};
 	materialCursor.field("textureTiling").write(textureTiling);
 	materialCursor.field("normalMap").writeTexture(normalMap);
 	materialCursor.field("armMap").writeTexture(armMap);
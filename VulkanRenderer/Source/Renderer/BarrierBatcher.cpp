@@ -0,0 +1,54 @@
+#include "BarrierBatcher.hpp"
+
+void BarrierBatcher::addImageBarrier(const vk::ImageMemoryBarrier2& barrier)
+{
+	if (imageBarriers.empty() || !tryMerge(imageBarriers.back(), barrier))
+	{
+		imageBarriers.push_back(barrier);
+	}
+}
+
+bool BarrierBatcher::isEmpty() const
+{
+	return imageBarriers.empty();
+}
+
+void BarrierBatcher::flush(const vk::raii::CommandBuffer& commandBuffer)
+{
+	if (isEmpty())
+	{
+		return;
+	}
+
+	commandBuffer.pipelineBarrier2(vk::DependencyInfo{{}, nullptr, nullptr, imageBarriers});
+	imageBarriers.clear();
+}
+
+bool BarrierBatcher::tryMerge(vk::ImageMemoryBarrier2& previous, const vk::ImageMemoryBarrier2& barrier)
+{
+	// Everything but the subresource range has to match
+	vk::ImageMemoryBarrier2 comparable{barrier};
+	comparable.subresourceRange = previous.subresourceRange;
+	if (comparable != previous || barrier.subresourceRange.aspectMask != previous.subresourceRange.aspectMask)
+	{
+		return false;
+	}
+
+	vk::ImageSubresourceRange& range{previous.subresourceRange};
+	const vk::ImageSubresourceRange& other{barrier.subresourceRange};
+
+	const bool sameLayers{range.baseArrayLayer == other.baseArrayLayer && range.layerCount == other.layerCount};
+	if (sameLayers && range.baseMipLevel + range.levelCount == other.baseMipLevel)
+	{
+		range.levelCount += other.levelCount;
+		return true;
+	}
+
+	const bool sameLevels{range.baseMipLevel == other.baseMipLevel && range.levelCount == other.levelCount};
+	if (sameLevels && range.baseArrayLayer + range.layerCount == other.baseArrayLayer)
+	{
+		range.layerCount += other.layerCount;
+		return true;
+	}
+	return false;
+}
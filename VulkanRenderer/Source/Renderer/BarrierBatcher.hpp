@@ -0,0 +1,24 @@
+#pragma once
+
+#include <vector>
+
+#include "VulkanBackend.hpp"
+
+// Collects the image barriers of Image::transition until the commands that need them are recorded, then records all of them with a single vkCmdPipelineBarrier2
+// The upload context keeps one per batch, so the transitions of all images uploaded in the batch share a barrier
+class BarrierBatcher
+{
+public:
+	// Merged into the previous image barrier if it only differs in the adjacent mip levels or array layers
+	void addImageBarrier(const vk::ImageMemoryBarrier2& barrier);
+
+	[[nodiscard]] bool isEmpty() const;
+
+	// Records and clears the pending barriers. Does nothing if there are none
+	void flush(const vk::raii::CommandBuffer& commandBuffer);
+
+private:
+	std::vector<vk::ImageMemoryBarrier2> imageBarriers;
+
+	static bool tryMerge(vk::ImageMemoryBarrier2& previous, const vk::ImageMemoryBarrier2& barrier);
+};
@@ -0,0 +1,44 @@
+#include "DeletionQueue.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+DeletionQueue::DeletionQueue(const uint32_t frameCount)
+	: frames(frameCount)
+{
+}
+
+void DeletionQueue::beginFrame(const uint32_t frameIndex)
+{
+	std::vector<std::unique_ptr<Entry>> released{};
+	{
+		std::lock_guard lock{mutex};
+		released.swap(frames[frameIndex]);
+		currentFrame = frameIndex;
+	}
+
+	// Destroyed outside the lock, so destructors may release further resources
+	released.clear();
+}
+
+void DeletionQueue::flush()
+{
+	while (true)
+	{
+		std::vector<std::unique_ptr<Entry>> released{};
+		{
+			std::lock_guard lock{mutex};
+			for (std::vector<std::unique_ptr<Entry>>& frame : frames)
+			{
+				std::ranges::move(frame, std::back_inserter(released));
+				frame.clear();
+			}
+		}
+
+		if (released.empty())
+		{
+			return;
+		}
+		released.clear();
+	}
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Keeps released GPU resources alive until the frames that may still use them have finished
+// Resources released while a frame is recorded or in flight are destroyed once that frame's fence has signaled again
+class DeletionQueue
+{
+public:
+	explicit DeletionQueue(uint32_t frameCount);
+
+	// Destroys the resources released during the frame's last use. Its fence has to be signaled
+	void beginFrame(uint32_t frameIndex);
+
+	// Destroys all released resources right away, including those released by the destroyed ones. The device has to be idle
+	void flush();
+
+	// Takes ownership of resource and destroys it once the current frame has finished on the GPU
+	template <typename T>
+	void push(T resource);
+
+private:
+	struct Entry
+	{
+		virtual ~Entry() = default;
+	};
+
+	template <typename T>
+	struct ResourceEntry final : Entry
+	{
+		explicit ResourceEntry(T&& resource) : resource(std::move(resource))
+		{
+		}
+
+		T resource;
+	};
+
+	std::vector<std::vector<std::unique_ptr<Entry>>> frames;
+	uint32_t currentFrame{0};
+
+	std::mutex mutex;
+};
+
+template <typename T>
+void DeletionQueue::push(T resource)
+{
+	std::unique_ptr<Entry> entry{std::make_unique<ResourceEntry<T>>(std::move(resource))};
+
+	std::lock_guard lock{mutex};
+	frames[currentFrame].push_back(std::move(entry));
+}
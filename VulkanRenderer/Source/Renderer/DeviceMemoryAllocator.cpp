@@ -0,0 +1,381 @@
+#include "DeviceMemoryAllocator.hpp"
+
+#include <algorithm>
+#include <imgui.h>
+#include <iostream>
+#include <ranges>
+#include <utility>
+
+#include "DeviceExtensions.hpp"
+
+float DeviceMemoryStats::getFragmentation() const
+{
+	const vk::DeviceSize freeBytes{blockBytes - usedBlockBytes};
+	if (freeBytes == 0)
+	{
+		return 0.f;
+	}
+	return 1.f - static_cast<float>(largestFreeRange) / static_cast<float>(freeBytes);
+}
+
+void DeviceMemoryStats::drawImGui() const
+{
+	constexpr float mebibyte{1024.f * 1024.f};
+
+	ImGui::SeparatorText("Device memory");
+	ImGui::Text("Device allocations: %u / %u", deviceAllocationCount, maxDeviceAllocationCount);
+	ImGui::Text("Blocks: %u, %.2f / %.2f MiB used", blockCount, static_cast<float>(usedBlockBytes) / mebibyte, static_cast<float>(blockBytes) / mebibyte);
+	ImGui::Text("Sub-allocations: %u", subAllocationCount);
+	ImGui::Text("Dedicated: %u, %.2f MiB", dedicatedAllocationCount, static_cast<float>(dedicatedBytes) / mebibyte);
+	ImGui::Text("Free ranges: %u, largest %.2f MiB", freeRangeCount, static_cast<float>(largestFreeRange) / mebibyte);
+	ImGui::Text("Fragmentation: %.1f%%", getFragmentation() * 100.f);
+
+	ImGui::TextUnformatted(hasMemoryBudget ? "Heaps (usage of the process / budget):" : "Heaps (allocated / size, no VK_EXT_memory_budget):");
+	for (const auto& [index, heap] : heaps | std::views::enumerate)
+	{
+		const bool isOverBudget{heap.usage > heap.budget};
+		const ImVec4 color{isOverBudget ? ImVec4{1.f, .3f, .3f, 1.f} : ImGui::GetStyleColorVec4(ImGuiCol_Text)};
+		ImGui::TextColored(color, "  %lld%s: %.2f / %.2f MiB, %.2f MiB ours", static_cast<long long>(index), heap.isDeviceLocal ? " (device local)" : "",
+		                   static_cast<float>(heap.usage) / mebibyte, static_cast<float>(heap.budget) / mebibyte, static_cast<float>(heap.allocatedBytes) / mebibyte);
+	}
+}
+
+DeviceAllocation::DeviceAllocation(DeviceAllocation&& other) noexcept
+	: allocator(std::exchange(other.allocator, nullptr)), block(std::exchange(other.block, nullptr)), offset(other.offset), size(other.size), category(other.category)
+{
+}
+
+DeviceAllocation& DeviceAllocation::operator=(DeviceAllocation&& other) noexcept
+{
+	if (this != &other)
+	{
+		release();
+		allocator = std::exchange(other.allocator, nullptr);
+		block = std::exchange(other.block, nullptr);
+		offset = other.offset;
+		size = other.size;
+		category = other.category;
+	}
+	return *this;
+}
+
+DeviceAllocation::~DeviceAllocation()
+{
+	release();
+}
+
+vk::DeviceMemory DeviceAllocation::getMemory() const
+{
+	return block ? *block->memory : vk::DeviceMemory{};
+}
+
+vk::DeviceSize DeviceAllocation::getOffset() const
+{
+	return offset;
+}
+
+vk::DeviceSize DeviceAllocation::getSize() const
+{
+	return size;
+}
+
+void* DeviceAllocation::getMappedData() const
+{
+	return block && block->mappedData ? block->mappedData + offset : nullptr;
+}
+
+void DeviceAllocation::release()
+{
+	if (allocator)
+	{
+		allocator->free(*this);
+		allocator = nullptr;
+		block = nullptr;
+	}
+}
+
+DeviceMemoryAllocator::DeviceMemoryAllocator(const vk::raii::Device& device, const vk::raii::PhysicalDevice& physicalDevice, const vk::DeviceSize preferredBlockSize)
+	: device(device), physicalDevice(physicalDevice), hasMemoryBudget(supportsMemoryBudget(physicalDevice)), memoryProperties(physicalDevice.getMemoryProperties()), bufferImageGranularity(physicalDevice.getProperties().limits.bufferImageGranularity),
+	  maxDeviceAllocationCount(physicalDevice.getProperties().limits.maxMemoryAllocationCount), preferredBlockSize(preferredBlockSize)
+{
+}
+
+DeviceAllocation DeviceMemoryAllocator::allocateForBuffer(const vk::raii::Buffer& buffer, const vk::MemoryPropertyFlags properties, const MemoryCategory category)
+{
+	const auto requirements{
+		device.getBufferMemoryRequirements2<vk::MemoryRequirements2, vk::MemoryDedicatedRequirements>(vk::BufferMemoryRequirementsInfo2{buffer})
+	};
+	const vk::MemoryDedicatedRequirements& dedicatedRequirements{requirements.get<vk::MemoryDedicatedRequirements>()};
+
+	const vk::MemoryDedicatedAllocateInfo dedicatedInfo{nullptr, buffer};
+	DeviceAllocation allocation{
+		allocateMemory(requirements.get<vk::MemoryRequirements2>().memoryRequirements, properties, true,
+		               dedicatedRequirements.requiresDedicatedAllocation || dedicatedRequirements.prefersDedicatedAllocation, &dedicatedInfo, category)
+	};
+
+	buffer.bindMemory(allocation.getMemory(), allocation.getOffset());
+	return allocation;
+}
+
+DeviceAllocation DeviceMemoryAllocator::allocateForImage(const vk::raii::Image& image, const vk::ImageTiling tiling, const vk::MemoryPropertyFlags properties,
+                                                         const MemoryCategory category)
+{
+	const auto requirements{
+		device.getImageMemoryRequirements2<vk::MemoryRequirements2, vk::MemoryDedicatedRequirements>(vk::ImageMemoryRequirementsInfo2{image})
+	};
+	const vk::MemoryDedicatedRequirements& dedicatedRequirements{requirements.get<vk::MemoryDedicatedRequirements>()};
+
+	const vk::MemoryDedicatedAllocateInfo dedicatedInfo{image, nullptr};
+	DeviceAllocation allocation{
+		allocateMemory(requirements.get<vk::MemoryRequirements2>().memoryRequirements, properties, tiling == vk::ImageTiling::eLinear,
+		               dedicatedRequirements.requiresDedicatedAllocation || dedicatedRequirements.prefersDedicatedAllocation, &dedicatedInfo, category)
+	};
+
+	image.bindMemory(allocation.getMemory(), allocation.getOffset());
+	return allocation;
+}
+
+DeviceAllocation DeviceMemoryAllocator::allocate(const vk::MemoryRequirements& requirements, const vk::MemoryPropertyFlags properties, const bool isLinear,
+                                                 const MemoryCategory category)
+{
+	return allocateMemory(requirements, properties, isLinear, false, nullptr, category);
+}
+
+DeviceMemoryStats DeviceMemoryAllocator::getStats() const
+{
+	std::lock_guard lock{mutex};
+
+	DeviceMemoryStats stats{};
+	stats.deviceAllocationCount = static_cast<uint32_t>(blocks.size());
+	stats.maxDeviceAllocationCount = maxDeviceAllocationCount;
+	stats.categoryBytes = categoryBytes;
+	stats.hasMemoryBudget = hasMemoryBudget;
+
+	const vk::PhysicalDeviceMemoryBudgetPropertiesEXT budget{hasMemoryBudget ? queryMemoryBudget() : vk::PhysicalDeviceMemoryBudgetPropertiesEXT{}};
+	for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; ++i)
+	{
+		const vk::MemoryHeap& heap{memoryProperties.memoryHeaps[i]};
+		stats.heaps.emplace_back(heap.size, static_cast<bool>(heap.flags & vk::MemoryHeapFlagBits::eDeviceLocal), 0, budget.heapUsage[i],
+		                         hasMemoryBudget ? budget.heapBudget[i] : heap.size);
+	}
+
+	for (const auto& block : blocks)
+	{
+		stats.heaps[memoryProperties.memoryTypes[block->memoryTypeIndex].heapIndex].allocatedBytes += block->size;
+
+		if (block->isDedicated)
+		{
+			++stats.dedicatedAllocationCount;
+			stats.dedicatedBytes += block->size;
+			continue;
+		}
+
+		++stats.blockCount;
+		stats.subAllocationCount += block->allocationCount;
+		stats.blockBytes += block->size;
+		stats.usedBlockBytes += block->size;
+		for (const auto& [offset, size] : block->freeRanges)
+		{
+			++stats.freeRangeCount;
+			stats.usedBlockBytes -= size;
+			stats.largestFreeRange = std::max(stats.largestFreeRange, size);
+		}
+	}
+
+	if (!hasMemoryBudget)
+	{
+		for (DeviceHeapStats& heap : stats.heaps)
+		{
+			heap.usage = heap.allocatedBytes;
+		}
+	}
+	return stats;
+}
+
+DeviceAllocation DeviceMemoryAllocator::allocateMemory(const vk::MemoryRequirements& requirements, const vk::MemoryPropertyFlags properties, bool isLinear,
+                                                       const bool dedicated, const vk::MemoryDedicatedAllocateInfo* dedicatedInfo, const MemoryCategory category)
+{
+	std::lock_guard lock{mutex};
+
+	const uint32_t memoryTypeIndex{findMemoryType(requirements.memoryTypeBits, properties)};
+	const vk::DeviceSize blockSize{getBlockSize(memoryTypeIndex)};
+
+	// Without a granularity linear and optimal resources may be neighbours, so they share blocks
+	if (bufferImageGranularity <= 1)
+	{
+		isLinear = false;
+	}
+
+	// The allocator is only set once nothing can throw anymore, an empty allocation frees nothing
+	const auto makeAllocation{[&](DeviceMemoryBlock& block, const vk::DeviceSize offset)
+	{
+		DeviceAllocation allocation{};
+		allocation.allocator = this;
+		allocation.block = &block;
+		allocation.offset = offset;
+		allocation.size = requirements.size;
+		allocation.category = category;
+		categoryBytes[static_cast<size_t>(category)] += requirements.size;
+		return allocation;
+	}};
+
+	if (dedicated || requirements.size > blockSize / 2)
+	{
+		DeviceMemoryBlock& block{createBlock(requirements.size, memoryTypeIndex, isLinear, true, dedicatedInfo)};
+		block.allocationCount = 1;
+		return makeAllocation(block, 0);
+	}
+
+	for (const auto& block : blocks)
+	{
+		if (block->isDedicated || block->memoryTypeIndex != memoryTypeIndex || block->isLinear != isLinear)
+		{
+			continue;
+		}
+
+		if (const std::optional<vk::DeviceSize> offset{allocateFromBlock(*block, requirements.size, requirements.alignment)})
+		{
+			return makeAllocation(*block, *offset);
+		}
+	}
+
+	DeviceMemoryBlock& block{createBlock(blockSize, memoryTypeIndex, isLinear, false, nullptr)};
+	return makeAllocation(block, *allocateFromBlock(block, requirements.size, requirements.alignment));
+}
+
+void DeviceMemoryAllocator::free(const DeviceAllocation& allocation)
+{
+	std::lock_guard lock{mutex};
+
+	DeviceMemoryBlock& block{*allocation.block};
+	--block.allocationCount;
+	categoryBytes[static_cast<size_t>(allocation.category)] -= allocation.size;
+
+	if (!block.isDedicated)
+	{
+		auto range{block.freeRanges.emplace(allocation.offset, allocation.size).first};
+
+		const auto next{std::next(range)};
+		if (next != block.freeRanges.end() && range->first + range->second == next->first)
+		{
+			range->second += next->second;
+			block.freeRanges.erase(next);
+		}
+
+		if (range != block.freeRanges.begin())
+		{
+			const auto previous{std::prev(range)};
+			if (previous->first + previous->second == range->first)
+			{
+				previous->second += range->second;
+				block.freeRanges.erase(range);
+			}
+		}
+	}
+
+	if (block.allocationCount > 0)
+	{
+		return;
+	}
+
+	// Keep the last empty block of its kind around, so a single resource being recreated does not allocate every time
+	const bool isLastOfItsKind{
+		std::ranges::none_of(blocks, [&](const auto& other)
+		{
+			return other.get() != &block && !other->isDedicated && other->memoryTypeIndex == block.memoryTypeIndex && other->isLinear == block.isLinear;
+		})
+	};
+	if (block.isDedicated || !isLastOfItsKind)
+	{
+		std::erase_if(blocks, [&](const auto& other) { return other.get() == &block; });
+	}
+}
+
+DeviceMemoryBlock& DeviceMemoryAllocator::createBlock(const vk::DeviceSize size, const uint32_t memoryTypeIndex, const bool isLinear, const bool isDedicated,
+                                                      const vk::MemoryDedicatedAllocateInfo* dedicatedInfo)
+{
+	if (blocks.size() >= maxDeviceAllocationCount)
+	{
+		throw std::runtime_error("Exceeded maxMemoryAllocationCount");
+	}
+
+	// Going over the budget still works on most drivers, but memory gets paged out or other applications suffer
+	const uint32_t heapIndex{memoryProperties.memoryTypes[memoryTypeIndex].heapIndex};
+	if (hasMemoryBudget)
+	{
+		const vk::PhysicalDeviceMemoryBudgetPropertiesEXT budget{queryMemoryBudget()};
+		if (budget.heapUsage[heapIndex] + size > budget.heapBudget[heapIndex])
+		{
+			std::cerr << "Allocating " << size << " bytes exceeds the budget of memory heap " << heapIndex << " (" << budget.heapUsage[heapIndex] << " of "
+				<< budget.heapBudget[heapIndex] << " bytes used)" << std::endl;
+		}
+	}
+
+	const vk::MemoryAllocateInfo memoryAllocateInfo{size, memoryTypeIndex, isDedicated ? dedicatedInfo : nullptr};
+	vk::raii::DeviceMemory memory{device, memoryAllocateInfo};
+
+	const bool isHostVisible{static_cast<bool>(memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & vk::MemoryPropertyFlagBits::eHostVisible)};
+	std::byte* mappedData{isHostVisible ? static_cast<std::byte*>(memory.mapMemory(0, vk::WholeSize, {})) : nullptr};
+
+	auto block{std::make_unique<DeviceMemoryBlock>(std::move(memory), size, memoryTypeIndex, isLinear, isDedicated, mappedData)};
+	if (!isDedicated)
+	{
+		block->freeRanges.emplace(0, size);
+	}
+	return *blocks.emplace_back(std::move(block));
+}
+
+uint32_t DeviceMemoryAllocator::findMemoryType(const uint32_t typeBits, const vk::MemoryPropertyFlags properties) const
+{
+	for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i)
+	{
+		if ((typeBits & (1 << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+		{
+			return i;
+		}
+	}
+
+	throw std::runtime_error("Failed to find suitable memory type!");
+}
+
+vk::DeviceSize DeviceMemoryAllocator::getBlockSize(const uint32_t memoryTypeIndex) const
+{
+	// Small heaps, e.g. host visible device memory, are not filled by a single block
+	const vk::DeviceSize heapSize{memoryProperties.memoryHeaps[memoryProperties.memoryTypes[memoryTypeIndex].heapIndex].size};
+	return std::min(preferredBlockSize, heapSize / 8);
+}
+
+vk::PhysicalDeviceMemoryBudgetPropertiesEXT DeviceMemoryAllocator::queryMemoryBudget() const
+{
+	const auto properties{physicalDevice.getMemoryProperties2<vk::PhysicalDeviceMemoryProperties2, vk::PhysicalDeviceMemoryBudgetPropertiesEXT>()};
+	return properties.get<vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+}
+
+std::optional<vk::DeviceSize> DeviceMemoryAllocator::allocateFromBlock(DeviceMemoryBlock& block, const vk::DeviceSize size, const vk::DeviceSize alignment)
+{
+	for (auto range{block.freeRanges.begin()}; range != block.freeRanges.end(); ++range)
+	{
+		const auto [rangeOffset, rangeSize]{*range};
+		const vk::DeviceSize offset{(rangeOffset + alignment - 1) / alignment * alignment};
+		const vk::DeviceSize padding{offset - rangeOffset};
+		if (padding + size > rangeSize)
+		{
+			continue;
+		}
+
+		// The padding stays free and is merged back once the allocation is freed
+		block.freeRanges.erase(range);
+		if (padding > 0)
+		{
+			block.freeRanges.emplace(rangeOffset, padding);
+		}
+		if (rangeSize > padding + size)
+		{
+			block.freeRanges.emplace(offset + size, rangeSize - padding - size);
+		}
+
+		++block.allocationCount;
+		return offset;
+	}
+	return std::nullopt;
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#include "MemoryAccounting.hpp"
+#include "VulkanBackend.hpp"
+
+class DeviceMemoryAllocator;
+
+struct DeviceHeapStats
+{
+	vk::DeviceSize size;
+	bool isDeviceLocal;
+	// Memory allocated from the heap by the allocator
+	vk::DeviceSize allocatedBytes;
+	// Usage of the whole process and the budget it should stay below. Without VK_EXT_memory_budget, the allocated bytes and the heap size
+	vk::DeviceSize usage;
+	vk::DeviceSize budget;
+};
+
+struct DeviceMemoryStats
+{
+	uint32_t blockCount{0};
+	uint32_t dedicatedAllocationCount{0};
+	// Buffers and images placed in blocks
+	uint32_t subAllocationCount{0};
+	// Live vkAllocateMemory allocations and the device's limit for them
+	uint32_t deviceAllocationCount{0};
+	uint32_t maxDeviceAllocationCount{0};
+	vk::DeviceSize blockBytes{0};
+	vk::DeviceSize usedBlockBytes{0};
+	vk::DeviceSize dedicatedBytes{0};
+	uint32_t freeRangeCount{0};
+	vk::DeviceSize largestFreeRange{0};
+	// Bytes of the live allocations by owner
+	std::array<vk::DeviceSize, memoryCategoryCount> categoryBytes{};
+	std::vector<DeviceHeapStats> heaps;
+	bool hasMemoryBudget{false};
+
+	// 0 if the free memory of the blocks is one range, approaches 1 the more it is split up
+	[[nodiscard]] float getFragmentation() const;
+
+	void drawImGui() const;
+};
+
+// Large allocation of one memory type that buffers and images are placed in
+// Dedicated allocations are blocks holding a single resource
+struct DeviceMemoryBlock
+{
+	vk::raii::DeviceMemory memory;
+	vk::DeviceSize size;
+	uint32_t memoryTypeIndex;
+	// Whether the block holds buffers and linear images, which must keep bufferImageGranularity from optimal images
+	bool isLinear;
+	bool isDedicated;
+	// Null unless the memory type is host visible. Host visible blocks stay mapped
+	std::byte* mappedData;
+	// Offset to size of every free range. Neighbouring ranges are merged
+	std::map<vk::DeviceSize, vk::DeviceSize> freeRanges;
+	uint32_t allocationCount{0};
+};
+
+// Range of a memory block. Returns itself to the allocator when destroyed
+class DeviceAllocation
+{
+public:
+	DeviceAllocation() = default;
+	DeviceAllocation(DeviceAllocation&& other) noexcept;
+	DeviceAllocation& operator=(DeviceAllocation&& other) noexcept;
+	~DeviceAllocation();
+
+	DeviceAllocation(const DeviceAllocation&) = delete;
+	DeviceAllocation& operator=(const DeviceAllocation&) = delete;
+
+	[[nodiscard]] vk::DeviceMemory getMemory() const;
+	[[nodiscard]] vk::DeviceSize getOffset() const;
+	[[nodiscard]] vk::DeviceSize getSize() const;
+	// Start of the allocation in host memory. Null unless the memory is host visible
+	[[nodiscard]] void* getMappedData() const;
+
+private:
+	friend class DeviceMemoryAllocator;
+
+	DeviceMemoryAllocator* allocator{nullptr};
+	DeviceMemoryBlock* block{nullptr};
+	vk::DeviceSize offset{0};
+	vk::DeviceSize size{0};
+	MemoryCategory category{MemoryCategory::Other};
+
+	void release();
+};
+
+// Places buffers and images in large per memory type blocks instead of allocating memory for each of them
+// Blocks are searched first fit. Resources larger than half a block, or whose driver asks for it, get a dedicated allocation
+// Every allocation is tagged with its owner. New memory is checked against the heap budgets if the device has VK_EXT_memory_budget
+class DeviceMemoryAllocator
+{
+public:
+	DeviceMemoryAllocator(const vk::raii::Device& device, const vk::raii::PhysicalDevice& physicalDevice, vk::DeviceSize preferredBlockSize = defaultBlockSize);
+
+	static constexpr vk::DeviceSize defaultBlockSize{256 * 1024 * 1024};
+
+	// Allocates memory for the resource and binds it
+	DeviceAllocation allocateForBuffer(const vk::raii::Buffer& buffer, vk::MemoryPropertyFlags properties, MemoryCategory category);
+	DeviceAllocation allocateForImage(const vk::raii::Image& image, vk::ImageTiling tiling, vk::MemoryPropertyFlags properties, MemoryCategory category);
+
+	// Memory the caller binds resources to itself, e.g. aliased images. isLinear tells whether buffers or linear images are placed in it
+	DeviceAllocation allocate(const vk::MemoryRequirements& requirements, vk::MemoryPropertyFlags properties, bool isLinear, MemoryCategory category);
+
+	[[nodiscard]] DeviceMemoryStats getStats() const;
+
+private:
+	friend class DeviceAllocation;
+
+	const vk::raii::Device& device;
+	const vk::raii::PhysicalDevice& physicalDevice;
+	bool hasMemoryBudget;
+	vk::PhysicalDeviceMemoryProperties memoryProperties;
+	vk::DeviceSize bufferImageGranularity;
+	uint32_t maxDeviceAllocationCount;
+	vk::DeviceSize preferredBlockSize;
+
+	std::vector<std::unique_ptr<DeviceMemoryBlock>> blocks;
+	std::array<vk::DeviceSize, memoryCategoryCount> categoryBytes{};
+	mutable std::mutex mutex;
+
+	DeviceAllocation allocateMemory(const vk::MemoryRequirements& requirements, vk::MemoryPropertyFlags properties, bool isLinear, bool dedicated,
+	                                const vk::MemoryDedicatedAllocateInfo* dedicatedInfo, MemoryCategory category);
+	void free(const DeviceAllocation& allocation);
+
+	DeviceMemoryBlock& createBlock(vk::DeviceSize size, uint32_t memoryTypeIndex, bool isLinear, bool isDedicated, const vk::MemoryDedicatedAllocateInfo* dedicatedInfo);
+
+	[[nodiscard]] uint32_t findMemoryType(uint32_t typeBits, vk::MemoryPropertyFlags properties) const;
+	[[nodiscard]] vk::DeviceSize getBlockSize(uint32_t memoryTypeIndex) const;
+	// Usage and budget of every heap. Only with VK_EXT_memory_budget
+	[[nodiscard]] vk::PhysicalDeviceMemoryBudgetPropertiesEXT queryMemoryBudget() const;
+
+	static std::optional<vk::DeviceSize> allocateFromBlock(DeviceMemoryBlock& block, vk::DeviceSize size, vk::DeviceSize alignment);
+};
@@ -0,0 +1,137 @@
+#include "FrameAllocator.hpp"
+
+#include <algorithm>
+
+std::atomic<uint64_t> FrameAllocator::nextGeneration{1};
+
+// Arena of the thread in the current frame of an allocator. Only valid while the generation matches
+struct ThreadArenaCache
+{
+	uint64_t generation{0};
+	std::pmr::memory_resource* arena{nullptr};
+};
+
+static thread_local ThreadArenaCache threadArenaCache{};
+
+FrameAllocator::FrameAllocator(const uint32_t frameCount, const size_t chunkSize)
+	: chunkSize(chunkSize), frames(frameCount), generation(nextGeneration.fetch_add(1))
+{
+}
+
+void FrameAllocator::beginFrame(const uint32_t frameIndex)
+{
+	std::lock_guard lock{mutex};
+
+	Frame& frame{frames[frameIndex]};
+	for (Chunk& chunk : frame.chunks)
+	{
+		if (chunk.size == chunkSize)
+		{
+			freeChunks.push_back(std::move(chunk));
+		}
+		else
+		{
+			--chunkCount;
+		}
+	}
+	frame.chunks.clear();
+
+	for (const auto& arena : frame.arenas)
+	{
+		arena->reset();
+	}
+	frame.arenaCount = 0;
+
+	currentFrame = frameIndex;
+	// Unique across allocators, so a cache filled by another allocator never matches
+	generation = nextGeneration.fetch_add(1);
+}
+
+std::pmr::memory_resource* FrameAllocator::getResource()
+{
+	if (threadArenaCache.generation == generation.load(std::memory_order_acquire))
+	{
+		return threadArenaCache.arena;
+	}
+
+	std::lock_guard lock{mutex};
+
+	Frame& frame{frames[currentFrame]};
+	if (frame.arenaCount == frame.arenas.size())
+	{
+		frame.arenas.push_back(std::make_unique<ThreadArena>(*this, currentFrame));
+	}
+	ThreadArena* arena{frame.arenas[frame.arenaCount++].get()};
+
+	threadArenaCache = ThreadArenaCache{generation.load(std::memory_order_relaxed), arena};
+	return arena;
+}
+
+size_t FrameAllocator::getChunkCount() const
+{
+	std::lock_guard lock{mutex};
+
+	return chunkCount;
+}
+
+std::span<std::byte> FrameAllocator::acquireChunk(const uint32_t frameIndex, const size_t size)
+{
+	std::lock_guard lock{mutex};
+
+	// Other threads may add chunks to the frame once the lock is released, so only the memory is returned
+	Frame& frame{frames[frameIndex]};
+	if (size <= chunkSize && !freeChunks.empty())
+	{
+		const Chunk& chunk{frame.chunks.emplace_back(std::move(freeChunks.back()))};
+		freeChunks.pop_back();
+		return {chunk.memory.get(), chunk.size};
+	}
+
+	// Allocations larger than a chunk get a chunk of their own
+	const size_t newChunkSize{std::max(size, chunkSize)};
+	++chunkCount;
+	const Chunk& chunk{frame.chunks.emplace_back(std::make_unique_for_overwrite<std::byte[]>(newChunkSize), newChunkSize)};
+	return {chunk.memory.get(), chunk.size};
+}
+
+FrameAllocator::ThreadArena::ThreadArena(FrameAllocator& allocator, const uint32_t frameIndex)
+	: allocator(allocator), frameIndex(frameIndex)
+{
+}
+
+void FrameAllocator::ThreadArena::reset()
+{
+	current = nullptr;
+	end = nullptr;
+}
+
+void* FrameAllocator::ThreadArena::do_allocate(const size_t bytes, const size_t alignment)
+{
+	const auto alignUp{[&](std::byte* pointer)
+	{
+		const uintptr_t address{reinterpret_cast<uintptr_t>(pointer)};
+		return pointer + ((address + alignment - 1) / alignment * alignment - address);
+	}};
+
+	std::byte* allocation{current ? alignUp(current) : nullptr};
+	if (!allocation || allocation + bytes > end)
+	{
+		// The rest of the current chunk is wasted, it is reused with the chunk in a later frame
+		const std::span<std::byte> chunk{allocator.acquireChunk(frameIndex, bytes + alignment)};
+		current = chunk.data();
+		end = current + chunk.size();
+		allocation = alignUp(current);
+	}
+
+	current = allocation + bytes;
+	return allocation;
+}
+
+void FrameAllocator::ThreadArena::do_deallocate(void* pointer, size_t bytes, size_t alignment)
+{
+}
+
+bool FrameAllocator::ThreadArena::do_is_equal(const memory_resource& other) const noexcept
+{
+	return this == &other;
+}
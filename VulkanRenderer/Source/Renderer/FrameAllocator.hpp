@@ -0,0 +1,88 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <span>
+#include <vector>
+
+// Bump allocator for memory that only lives for one frame. Every frame in flight has its own memory, which is reused once the frame's fence has signaled
+// Each thread bumps through chunks of its own, so allocating takes no lock. Deallocating does nothing, beginFrame frees all memory of a frame at once
+// Containers using it must not outlive their frame and must only grow on the thread that created them
+class FrameAllocator
+{
+public:
+	explicit FrameAllocator(uint32_t frameCount, size_t chunkSize = defaultChunkSize);
+
+	static constexpr size_t defaultChunkSize{256 * 1024};
+
+	// Frees the memory of the frame and directs later allocations to it. Its fence has to be signaled and no other thread may allocate meanwhile
+	void beginFrame(uint32_t frameIndex);
+
+	// Memory of the current frame for the calling thread
+	[[nodiscard]] std::pmr::memory_resource* getResource();
+
+	template <typename T>
+	[[nodiscard]] std::pmr::vector<T> makeVector();
+
+	// Chunks ever allocated from the heap. Stops growing once the frames reach their steady state
+	[[nodiscard]] size_t getChunkCount() const;
+
+private:
+	struct Chunk
+	{
+		std::unique_ptr<std::byte[]> memory;
+		size_t size;
+	};
+
+	class ThreadArena : public std::pmr::memory_resource
+	{
+	public:
+		ThreadArena(FrameAllocator& allocator, uint32_t frameIndex);
+
+		void reset();
+
+	private:
+		FrameAllocator& allocator;
+		uint32_t frameIndex;
+		std::byte* current{nullptr};
+		std::byte* end{nullptr};
+
+		void* do_allocate(size_t bytes, size_t alignment) override;
+		void do_deallocate(void* pointer, size_t bytes, size_t alignment) override;
+		bool do_is_equal(const memory_resource& other) const noexcept override;
+	};
+
+	struct Frame
+	{
+		// Arenas are kept across frames, the first arenaCount of them belong to threads in the current frame
+		std::vector<std::unique_ptr<ThreadArena>> arenas;
+		uint32_t arenaCount{0};
+		std::vector<Chunk> chunks;
+	};
+
+	size_t chunkSize;
+	std::vector<Frame> frames;
+	uint32_t currentFrame{0};
+	// Changes with every beginFrame, so threads notice that their cached arena belongs to an earlier frame
+	std::atomic<uint64_t> generation;
+	// Chunks of chunkSize that no frame uses. Larger chunks are freed with their frame
+	std::vector<Chunk> freeChunks;
+	size_t chunkCount{0};
+
+	mutable std::mutex mutex;
+
+	// Hands a chunk of at least size bytes to the frame
+	std::span<std::byte> acquireChunk(uint32_t frameIndex, size_t size);
+
+	static std::atomic<uint64_t> nextGeneration;
+};
+
+template <typename T>
+std::pmr::vector<T> FrameAllocator::makeVector()
+{
+	return std::pmr::vector<T>{getResource()};
+}
@@ -0,0 +1,154 @@
+#include "FrustumCuller.hpp"
+
+#include <cmath>
+#include <imgui.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+#include "Scene/Core/BoundingBox.hpp"
+
+uint32_t CullingStats::getCulledCount() const
+{
+	return testedCount - visibleCount;
+}
+
+void CullingStats::drawImGui() const
+{
+	ImGui::SeparatorText("Frustum culling");
+	ImGui::Text("Tested: %u", testedCount);
+	ImGui::Text("Visible: %u", visibleCount);
+	ImGui::Text("Culled: %u", getCulledCount());
+}
+
+void FrustumCuller::clear()
+{
+	boxCount = 0;
+	centerX.clear();
+	centerY.clear();
+	centerZ.clear();
+	extentX.clear();
+	extentY.clear();
+	extentZ.clear();
+}
+
+void FrustumCuller::addBox(const BoundingBox& box)
+{
+	const glm::vec3 center{box.getCenter()};
+	const glm::vec3 extent{box.getExtent()};
+
+	centerX.push_back(center.x);
+	centerY.push_back(center.y);
+	centerZ.push_back(center.z);
+	extentX.push_back(extent.x);
+	extentY.push_back(extent.y);
+	extentZ.push_back(extent.z);
+	++boxCount;
+}
+
+void FrustumCuller::cull(const std::array<glm::vec4, 6>& frustumPlanes)
+{
+	// Padding boxes are tested like all others, their results are never read
+	const size_t paddedCount{(boxCount + batchSize - 1) / batchSize * batchSize};
+	centerX.resize(paddedCount);
+	centerY.resize(paddedCount);
+	centerZ.resize(paddedCount);
+	extentX.resize(paddedCount);
+	extentY.resize(paddedCount);
+	extentZ.resize(paddedCount);
+	visibility.resize(paddedCount);
+
+	cullBatches(frustumPlanes);
+
+	stats.testedCount = static_cast<uint32_t>(boxCount);
+	stats.visibleCount = 0;
+	for (size_t i = 0; i < boxCount; ++i)
+	{
+		stats.visibleCount += visibility[i];
+	}
+}
+
+bool FrustumCuller::isVisible(const size_t index) const
+{
+	return visibility[index] != 0;
+}
+
+std::array<glm::vec4, 6> FrustumCuller::extractFrustumPlanes(const glm::mat4& viewProjection)
+{
+	// Gribb-Hartmann: The clip space conditions -w <= x <= w etc. are linear combinations of the matrix rows
+	const glm::mat4 rows{transpose(viewProjection)};
+
+	std::array planes{
+		rows[3] + rows[0], // Left
+		rows[3] - rows[0], // Right
+		rows[3] + rows[1], // Bottom
+		rows[3] - rows[1], // Top
+		rows[2], // Near. Vulkan clips depth to [0, w]
+		rows[3] - rows[2] // Far
+	};
+
+	for (glm::vec4& plane : planes)
+	{
+		plane /= glm::length(glm::vec3{plane});
+	}
+	return planes;
+}
+
+// A box is outside of a plane if its center is further behind it than the box's extent projected onto the plane normal
+// The box is visible if it is not outside of any plane
+#if defined(__SSE2__) || defined(_M_X64)
+void FrustumCuller::cullBatches(const std::array<glm::vec4, 6>& frustumPlanes)
+{
+	const __m128 signMask{_mm_set1_ps(-0.f)};
+	const __m128 zero{_mm_setzero_ps()};
+
+	for (size_t i = 0; i < visibility.size(); i += batchSize)
+	{
+		const __m128 boxCenterX{_mm_loadu_ps(&centerX[i])};
+		const __m128 boxCenterY{_mm_loadu_ps(&centerY[i])};
+		const __m128 boxCenterZ{_mm_loadu_ps(&centerZ[i])};
+		const __m128 boxExtentX{_mm_loadu_ps(&extentX[i])};
+		const __m128 boxExtentY{_mm_loadu_ps(&extentY[i])};
+		const __m128 boxExtentZ{_mm_loadu_ps(&extentZ[i])};
+
+		__m128 inside{_mm_castsi128_ps(_mm_set1_epi32(-1))};
+		for (const glm::vec4& plane : frustumPlanes)
+		{
+			const __m128 normalX{_mm_set1_ps(plane.x)};
+			const __m128 normalY{_mm_set1_ps(plane.y)};
+			const __m128 normalZ{_mm_set1_ps(plane.z)};
+
+			const __m128 distance{
+				_mm_add_ps(_mm_add_ps(_mm_mul_ps(boxCenterX, normalX), _mm_mul_ps(boxCenterY, normalY)), _mm_add_ps(_mm_mul_ps(boxCenterZ, normalZ), _mm_set1_ps(plane.w)))
+			};
+			const __m128 radius{
+				_mm_add_ps(_mm_add_ps(_mm_mul_ps(boxExtentX, _mm_andnot_ps(signMask, normalX)), _mm_mul_ps(boxExtentY, _mm_andnot_ps(signMask, normalY))),
+				           _mm_mul_ps(boxExtentZ, _mm_andnot_ps(signMask, normalZ)))
+			};
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, radius), zero));
+		}
+
+		const int mask{_mm_movemask_ps(inside)};
+		for (size_t j = 0; j < batchSize; ++j)
+		{
+			visibility[i + j] = static_cast<uint8_t>((mask >> j) & 1);
+		}
+	}
+}
+#else
+void FrustumCuller::cullBatches(const std::array<glm::vec4, 6>& frustumPlanes)
+{
+	for (size_t i = 0; i < visibility.size(); ++i)
+	{
+		bool inside{true};
+		for (const glm::vec4& plane : frustumPlanes)
+		{
+			const float distance{centerX[i] * plane.x + centerY[i] * plane.y + centerZ[i] * plane.z + plane.w};
+			const float radius{extentX[i] * std::abs(plane.x) + extentY[i] * std::abs(plane.y) + extentZ[i] * std::abs(plane.z)};
+			inside = inside && distance + radius >= 0.f;
+		}
+		visibility[i] = inside;
+	}
+}
+#endif
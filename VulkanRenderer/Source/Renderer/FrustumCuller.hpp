@@ -0,0 +1,59 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+struct BoundingBox;
+
+struct CullingStats
+{
+	uint32_t testedCount{0};
+	uint32_t visibleCount{0};
+
+	[[nodiscard]] uint32_t getCulledCount() const;
+
+	void drawImGui() const;
+};
+
+// Tests world space bounding boxes against the view frustum
+// Boxes are stored as structure of arrays, so that SSE tests a batch of them against a plane at once
+// SSE2 is part of every x86-64 target, so no flags or runtime dispatch are needed for it
+class FrustumCuller
+{
+public:
+	static constexpr size_t batchSize{4};
+
+	// Removes all boxes. Boxes of the next cull can be added afterwards
+	void clear();
+	void addBox(const BoundingBox& box);
+
+	// Tests all added boxes against the planes. Boxes that intersect the frustum count as visible
+	void cull(const std::array<glm::vec4, 6>& frustumPlanes);
+
+	// Result of the last cull for the box added at index
+	[[nodiscard]] bool isVisible(size_t index) const;
+
+	// Planes of the frustum in world space, pointing inwards. xyz is the normal, w the distance
+	static std::array<glm::vec4, 6> extractFrustumPlanes(const glm::mat4& viewProjection);
+
+	// Stats of the last cull
+	CullingStats stats{};
+
+private:
+	size_t boxCount{0};
+
+	// Padded to a multiple of batchSize
+	std::vector<float> centerX;
+	std::vector<float> centerY;
+	std::vector<float> centerZ;
+	std::vector<float> extentX;
+	std::vector<float> extentY;
+	std::vector<float> extentZ;
+
+	std::vector<uint8_t> visibility;
+
+	void cullBatches(const std::array<glm::vec4, 6>& frustumPlanes);
+};
@@ -0,0 +1,227 @@
+#include "GpuProfiler.hpp"
+
+#include <algorithm>
+#include <imgui.h>
+#include <numeric>
+
+GpuProfiler::GpuProfiler(const vk::raii::Device& device, const vk::raii::PhysicalDevice& physicalDevice, const uint32_t queueFamilyIndex, const uint32_t frameCount)
+{
+	const vk::PhysicalDeviceLimits limits{physicalDevice.getProperties().limits};
+	const uint32_t validBits{physicalDevice.getQueueFamilyProperties()[queueFamilyIndex].timestampValidBits};
+
+	supported = limits.timestampComputeAndGraphics && validBits > 0;
+	timestampPeriod = limits.timestampPeriod;
+	timestampMask = validBits >= 64 ? ~uint64_t{0} : (uint64_t{1} << validBits) - 1;
+
+	if (supported)
+	{
+		frames = createFrameQueries(device, frameCount);
+	}
+}
+
+void GpuProfiler::beginFrame(const vk::raii::CommandBuffer& commandBuffer, const uint32_t frameIndex)
+{
+	if (!supported)
+	{
+		return;
+	}
+
+	currentFrame = frameIndex;
+	FrameQueries& frame{frames[frameIndex]};
+
+	resolveFrame(frame);
+
+	commandBuffer.resetQueryPool(frame.queryPool, 0, maxScopesPerFrame * 2);
+	frame.frameNumber = frameCounter++;
+}
+
+uint32_t GpuProfiler::beginScope(const vk::raii::CommandBuffer& commandBuffer, const std::string& name)
+{
+	if (!supported)
+	{
+		return 0;
+	}
+
+	FrameQueries& frame{frames[currentFrame]};
+	if (frame.scopeNames.size() >= maxScopesPerFrame)
+	{
+		throw std::runtime_error("Too many GPU profiler scopes in one frame");
+	}
+
+	const uint32_t scope{static_cast<uint32_t>(frame.scopeNames.size())};
+	frame.scopeNames.push_back(name);
+
+	commandBuffer.writeTimestamp2(vk::PipelineStageFlagBits2::eTopOfPipe, frame.queryPool, scope * 2);
+	return scope;
+}
+
+void GpuProfiler::endScope(const vk::raii::CommandBuffer& commandBuffer, const uint32_t scope)
+{
+	if (!supported)
+	{
+		return;
+	}
+
+	commandBuffer.writeTimestamp2(vk::PipelineStageFlagBits2::eBottomOfPipe, frames[currentFrame].queryPool, scope * 2 + 1);
+}
+
+void GpuProfiler::resolvePendingFrames()
+{
+	// Older frames first, so the CSV stays ordered
+	std::vector<FrameQueries*> pendingFrames{};
+	for (FrameQueries& frame : frames)
+	{
+		pendingFrames.push_back(&frame);
+	}
+	std::ranges::sort(pendingFrames, {}, &FrameQueries::frameNumber);
+
+	for (FrameQueries* frame : pendingFrames)
+	{
+		resolveFrame(*frame);
+	}
+}
+
+void GpuProfiler::startCsvCapture(const std::filesystem::path& path)
+{
+	csvFile = std::ofstream{path};
+	if (!csvFile.is_open())
+	{
+		throw std::runtime_error("Failed to open file " + path.string());
+	}
+	csvFile << "frame,scope,milliseconds\n";
+}
+
+void GpuProfiler::stopCsvCapture()
+{
+	csvFile.close();
+}
+
+void GpuProfiler::drawImGui()
+{
+	if (!supported)
+	{
+		ImGui::Text("Timestamp queries are not supported on the graphics queue");
+		return;
+	}
+
+	if (csvFile.is_open())
+	{
+		if (ImGui::Button("Stop CSV capture"))
+		{
+			stopCsvCapture();
+		}
+	}
+	else if (ImGui::Button("Start CSV capture"))
+	{
+		startCsvCapture("gpu_profile.csv");
+	}
+
+	if (!ImGui::BeginTable("GPU scopes", 6, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+	{
+		return;
+	}
+
+	ImGui::TableSetupColumn("Scope");
+	ImGui::TableSetupColumn("Last ms");
+	ImGui::TableSetupColumn("Avg ms");
+	ImGui::TableSetupColumn("P50 ms");
+	ImGui::TableSetupColumn("P95 ms");
+	ImGui::TableSetupColumn("P99 ms");
+	ImGui::TableHeadersRow();
+
+	std::vector<float> sortedSamples{};
+	for (const ScopeHistory& history : histories)
+	{
+		sortedSamples = history.samples;
+		std::ranges::sort(sortedSamples);
+
+		const auto percentile{[&](const float fraction) { return sortedSamples[static_cast<size_t>(fraction * static_cast<float>(sortedSamples.size() - 1))]; }};
+		const float average{std::accumulate(sortedSamples.begin(), sortedSamples.end(), 0.f) / static_cast<float>(sortedSamples.size())};
+
+		ImGui::TableNextRow();
+		ImGui::TableNextColumn();
+		ImGui::TextUnformatted(history.name.c_str());
+		ImGui::TableNextColumn();
+		ImGui::Text("%.3f", history.lastSample);
+		ImGui::TableNextColumn();
+		ImGui::Text("%.3f", average);
+		ImGui::TableNextColumn();
+		ImGui::Text("%.3f", percentile(.5f));
+		ImGui::TableNextColumn();
+		ImGui::Text("%.3f", percentile(.95f));
+		ImGui::TableNextColumn();
+		ImGui::Text("%.3f", percentile(.99f));
+	}
+
+	ImGui::EndTable();
+}
+
+bool GpuProfiler::isSupported() const
+{
+	return supported;
+}
+
+void GpuProfiler::resolveFrame(FrameQueries& frame)
+{
+	if (frame.scopeNames.empty())
+	{
+		return;
+	}
+
+	const uint32_t queryCount{static_cast<uint32_t>(frame.scopeNames.size()) * 2};
+	const auto [result, timestamps]{
+		frame.queryPool.getResults<uint64_t>(0, queryCount, queryCount * sizeof(uint64_t), sizeof(uint64_t), vk::QueryResultFlagBits::e64)
+	};
+
+	// Not ready only happens if the frame was never submitted, its timings are dropped
+	if (result == vk::Result::eSuccess)
+	{
+		for (size_t scope = 0; scope < frame.scopeNames.size(); ++scope)
+		{
+			const uint64_t ticks{(timestamps[scope * 2 + 1] - timestamps[scope * 2]) & timestampMask};
+			const float milliseconds{static_cast<float>(ticks) * timestampPeriod / 1e6f};
+
+			addSample(frame.scopeNames[scope], milliseconds);
+			if (csvFile.is_open())
+			{
+				csvFile << frame.frameNumber << ',' << frame.scopeNames[scope] << ',' << milliseconds << '\n';
+			}
+		}
+	}
+
+	frame.scopeNames.clear();
+}
+
+void GpuProfiler::addSample(const std::string& name, const float milliseconds)
+{
+	auto history{std::ranges::find(histories, name, &ScopeHistory::name)};
+	if (history == histories.end())
+	{
+		history = histories.insert(histories.end(), ScopeHistory{name});
+	}
+
+	// Ring buffer once the history is full
+	if (history->samples.size() < historyLength)
+	{
+		history->samples.push_back(milliseconds);
+	}
+	else
+	{
+		history->samples[history->nextSample] = milliseconds;
+	}
+	history->nextSample = (history->nextSample + 1) % historyLength;
+	history->lastSample = milliseconds;
+}
+
+std::vector<GpuProfiler::FrameQueries> GpuProfiler::createFrameQueries(const vk::raii::Device& device, const uint32_t frameCount)
+{
+	const vk::QueryPoolCreateInfo queryPoolCreateInfo{{}, vk::QueryType::eTimestamp, maxScopesPerFrame * 2};
+
+	std::vector<FrameQueries> frameQueries{};
+	frameQueries.reserve(frameCount);
+	for (uint32_t i = 0; i < frameCount; ++i)
+	{
+		frameQueries.push_back(FrameQueries{vk::raii::QueryPool{device, queryPoolCreateInfo}});
+	}
+	return frameQueries;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "VulkanBackend.hpp"
+
+// Measures the GPU time of named scopes with timestamp queries
+// Every frame in flight has its own query pool. Its results are read when the frame is recorded again,
+// at which point its fence has been waited on, so reading never stalls
+class GpuProfiler
+{
+public:
+	GpuProfiler(const vk::raii::Device& device, const vk::raii::PhysicalDevice& physicalDevice, uint32_t queueFamilyIndex, uint32_t frameCount);
+
+	static constexpr uint32_t maxScopesPerFrame{64};
+	// Samples per scope used for the averages and percentiles
+	static constexpr size_t historyLength{240};
+
+	// Collects the timings of the frame's previous submission and resets its queries. Expects the frame's fence to be signaled
+	void beginFrame(const vk::raii::CommandBuffer& commandBuffer, uint32_t frameIndex);
+
+	// Scopes of the current frame. Scopes may be nested
+	uint32_t beginScope(const vk::raii::CommandBuffer& commandBuffer, const std::string& name);
+	void endScope(const vk::raii::CommandBuffer& commandBuffer, uint32_t scope);
+
+	// Collects the timings of all submitted frames. Expects the device to be idle
+	void resolvePendingFrames();
+
+	// Appends the timings of every resolved frame to a CSV file with the columns frame, scope and milliseconds
+	void startCsvCapture(const std::filesystem::path& path);
+	void stopCsvCapture();
+
+	void drawImGui();
+
+	[[nodiscard]] bool isSupported() const;
+
+private:
+	struct FrameQueries
+	{
+		vk::raii::QueryPool queryPool;
+		// Scope i uses the queries 2i and 2i + 1
+		std::vector<std::string> scopeNames;
+		uint64_t frameNumber{0};
+	};
+
+	struct ScopeHistory
+	{
+		std::string name;
+		std::vector<float> samples;
+		size_t nextSample{0};
+		float lastSample{0.f};
+	};
+
+	bool supported;
+	// Nanoseconds per tick
+	float timestampPeriod;
+	uint64_t timestampMask;
+
+	std::vector<FrameQueries> frames;
+	uint32_t currentFrame{0};
+	uint64_t frameCounter{0};
+
+	// In order of first appearance
+	std::vector<ScopeHistory> histories;
+
+	std::ofstream csvFile;
+
+	void resolveFrame(FrameQueries& frame);
+	void addSample(const std::string& name, float milliseconds);
+
+	static std::vector<FrameQueries> createFrameQueries(const vk::raii::Device& device, uint32_t frameCount);
+};
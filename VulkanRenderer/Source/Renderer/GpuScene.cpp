@@ -0,0 +1,336 @@
+#include "GpuScene.hpp"
+
+#include <algorithm>
+#include <imgui.h>
+#include <tuple>
+
+#include "Renderer.hpp"
+#include "FrustumCuller.hpp"
+#include "InstanceBuffer.hpp"
+#include "Asset/Material.hpp"
+#include "Asset/MaterialInstance.hpp"
+#include "Asset/Mesh.hpp"
+#include "Scene/Model.hpp"
+#include "Scene/Scene.hpp"
+#include "ShaderCompilation/PushConstantObject.hpp"
+#include "ShaderCompilation/ShaderCursor.hpp"
+
+void GpuSceneStats::drawImGui() const
+{
+	ImGui::SeparatorText("GPU-driven");
+	ImGui::Text("Instances: %u", instanceCount);
+	ImGui::Text("Buckets: %u", bucketCount);
+	ImGui::Text("Instances written: %u", writtenInstances);
+	ImGui::Text("Indirect draws: %u", indirectDraws);
+	ImGui::Text("Pipeline binds: %u", pipelineBinds);
+}
+
+GpuScene::GpuScene(const Renderer& app, const InstanceBuffer& instanceBuffer)
+	: app(app),
+	  instanceBuffer(instanceBuffer),
+	  cullingProgram(compileCullingProgram(app)),
+	  cullingLayout(std::make_shared<VulkanShaderObjectLayout>(VulkanShaderObjectLayout::reflect(SlangCompiler::findGlobalParameter(cullingProgram, "gCulling"), {}), app)),
+	  cullingConstantsLayout(std::make_shared<const ShaderTypeLayout>(SlangCompiler::findGlobalParameter(cullingProgram, "gCullingConstants")->getTypeLayout()->getElementTypeLayout())),
+	  cullingConstantsRange(PushConstantObject::getRange(SlangCompiler::findGlobalParameter(cullingProgram, "gCullingConstants"), vk::ShaderStageFlagBits::eCompute, app)),
+	  pipelineLayout(app.device, vk::PipelineLayoutCreateInfo{{}, *cullingLayout->descriptorSetLayout, cullingConstantsRange}),
+	  pipeline(createPipeline(cullingProgram, pipelineLayout, app)),
+	  cullingObject(cullingLayout)
+{
+	reserve();
+}
+
+void GpuScene::update(const Scene& scene, const std::optional<AssetHandle<MaterialInstance>>& fallbackMaterial, const uint32_t frameIndex)
+{
+	if (instanceBuffer.getCapacity() != capacity)
+	{
+		reserve();
+	}
+
+	stats = {};
+
+	// Models removed from the end of the scene free their slots
+	const uint32_t modelCount{static_cast<uint32_t>(scene.models.size())};
+	while (instances.size() > modelCount)
+	{
+		removeFromBucket(instances.back());
+		instances.pop_back();
+	}
+	std::erase_if(pendingInstances, [modelCount](const uint32_t slot) { return slot >= modelCount; });
+	instances.resize(modelCount, InstanceSlot{0, noBucket, 0});
+
+	const uint32_t allFrames{(1u << app.maxFramesInFlight) - 1};
+	for (uint32_t slot = 0; slot < modelCount; ++slot)
+	{
+		const Model& model{scene.models[slot]};
+		InstanceSlot& instance{instances[slot]};
+		if (instance.modelVersion == model.getVersion())
+		{
+			continue;
+		}
+
+		instance.modelVersion = model.getVersion();
+		assignBucket(instance, model);
+		if (instance.pendingFrames == 0)
+		{
+			pendingInstances.push_back(slot);
+		}
+		instance.pendingFrames = allFrames;
+	}
+
+	// The regions of the other frames in flight may still be read, they are written once their frame is recorded again
+	const std::span<InstanceData> frameInstances{instanceBuffer.getFrameInstances(frameIndex)};
+	const uint32_t frameBit{1u << frameIndex};
+	for (size_t i = 0; i < pendingInstances.size();)
+	{
+		const uint32_t slot{pendingInstances[i]};
+		InstanceSlot& instance{instances[slot]};
+		if (instance.pendingFrames & frameBit)
+		{
+			const Model& model{scene.models[slot]};
+			const Mesh& mesh{*model.getMesh()};
+			const glm::mat4 modelTransform{model.getTransform().getMatrix()};
+			frameInstances[slot] = InstanceData{modelTransform, inverse(transpose(modelTransform)), mesh.boundingSphere, mesh.indexCount, instance.bucketIndex, {}};
+			instance.pendingFrames &= ~frameBit;
+			++stats.writtenInstances;
+		}
+
+		if (instance.pendingFrames == 0)
+		{
+			pendingInstances[i] = pendingInstances.back();
+			pendingInstances.pop_back();
+		}
+		else
+		{
+			++i;
+		}
+	}
+
+	buildDraws(fallbackMaterial, frameIndex);
+	cullingObject.updateDescriptors(frameIndex);
+
+	stats.instanceCount = modelCount;
+	stats.bucketCount = static_cast<uint32_t>(bucketsByAssets.size());
+}
+
+void GpuScene::recordClearCounts(const vk::raii::CommandBuffer& commandBuffer, const uint32_t frameIndex) const
+{
+	if (draws.empty())
+	{
+		return;
+	}
+
+	const vk::DeviceSize countOffset{vk::DeviceSize{frameIndex} * capacity * sizeof(uint32_t)};
+	commandBuffer.fillBuffer(countBuffer->vkBuffer, countOffset, buckets.size() * sizeof(uint32_t), 0);
+}
+
+void GpuScene::recordCulling(const vk::raii::CommandBuffer& commandBuffer, const uint32_t frameIndex, const glm::mat4& viewProjection) const
+{
+	if (draws.empty())
+	{
+		return;
+	}
+
+	commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline);
+	cullingObject.bind(commandBuffer, vk::PipelineBindPoint::eCompute, pipelineLayout, cullingLayout->getSetIndex(), frameIndex);
+
+	const uint32_t instanceCount{stats.instanceCount};
+
+	PushConstantObject constants{cullingConstantsLayout};
+	ShaderCursor constantsCursor{&constants};
+	constantsCursor.field("frustumPlanes").write(FrustumCuller::extractFrustumPlanes(viewProjection));
+	constantsCursor.field("instanceOffset").write(instanceBuffer.getFrameOffset(frameIndex));
+	constantsCursor.field("instanceCount").write(instanceCount);
+	constantsCursor.field("commandOffset").write(frameIndex * capacity);
+	constantsCursor.field("bucketOffset").write(frameIndex * capacity);
+	constants.push(commandBuffer, pipelineLayout, cullingConstantsRange);
+
+	commandBuffer.dispatch((instanceCount + workgroupSize - 1) / workgroupSize, 1, 1);
+}
+
+void GpuScene::recordDraws(const vk::raii::CommandBuffer& commandBuffer, const uint32_t frameIndex)
+{
+	const vk::DeviceSize frameCommandOffset{vk::DeviceSize{frameIndex} * capacity};
+	const vk::DeviceSize frameCountOffset{vk::DeviceSize{frameIndex} * capacity};
+
+	const GpuDraw* previousDraw{nullptr};
+	for (const GpuDraw& draw : draws)
+	{
+		if (!previousDraw || previousDraw->material != draw.material)
+		{
+			commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, draw.material->indirectPipeline);
+			++stats.pipelineBinds;
+		}
+
+		if (!previousDraw || previousDraw->materialInstance != draw.materialInstance)
+		{
+			draw.materialInstance->shaderObject->bind(commandBuffer, vk::PipelineBindPoint::eGraphics, draw.material->pipelineLayout, materialSetIndex, frameIndex);
+		}
+
+		if (!previousDraw || previousDraw->mesh != draw.mesh)
+		{
+			commandBuffer.bindVertexBuffers(0, *draw.mesh->getVertexBuffer().vkBuffer, {0});
+			commandBuffer.bindIndexBuffer(draw.mesh->getIndexBuffer().vkBuffer, 0, vk::IndexType::eUint32);
+		}
+
+		// The culling pass decides how many of the bucket's commands are actually drawn
+		commandBuffer.drawIndexedIndirectCount(drawCommandBuffer->vkBuffer, (frameCommandOffset + draw.commandOffset) * sizeof(vk::DrawIndexedIndirectCommand),
+		                                       countBuffer->vkBuffer, (frameCountOffset + draw.bucketIndex) * sizeof(uint32_t), draw.instanceCount,
+		                                       sizeof(vk::DrawIndexedIndirectCommand));
+		++stats.indirectDraws;
+
+		previousDraw = &draw;
+	}
+}
+
+const std::vector<GpuDraw>& GpuScene::getDraws() const
+{
+	return draws;
+}
+
+const Buffer& GpuScene::getDrawCommandBuffer() const
+{
+	return *drawCommandBuffer;
+}
+
+const Buffer& GpuScene::getCountBuffer() const
+{
+	return *countBuffer;
+}
+
+void GpuScene::reserve()
+{
+	// Frames in flight keep using the old buffers until they finish, the culling object's descriptors are rewritten per frame
+	if (drawCommandBuffer)
+	{
+		app.deletionQueue.push(std::move(*drawCommandBuffer));
+		app.deletionQueue.push(std::move(*countBuffer));
+		app.deletionQueue.push(std::move(*bucketOffsetBuffer));
+	}
+
+	capacity = instanceBuffer.getCapacity();
+	const vk::DeviceSize regionCount{app.maxFramesInFlight};
+
+	drawCommandBuffer = Buffer{
+		app, regionCount * capacity * sizeof(vk::DrawIndexedIndirectCommand), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer,
+		vk::MemoryPropertyFlagBits::eDeviceLocal, MemoryCategory::Scene
+	};
+	countBuffer = Buffer{
+		app, regionCount * capacity * sizeof(uint32_t), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eTransferDst,
+		vk::MemoryPropertyFlagBits::eDeviceLocal, MemoryCategory::Scene
+	};
+	bucketOffsetBuffer = Buffer{
+		app, regionCount * capacity * sizeof(uint32_t), vk::BufferUsageFlagBits::eStorageBuffer,
+		vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, MemoryCategory::Scene
+	};
+	mappedBucketOffsets = static_cast<uint32_t*>(bucketOffsetBuffer->allocation.getMappedData());
+
+	ShaderCursor cullingCursor{&cullingObject};
+	cullingCursor.field("instances").writeBuffer(instanceBuffer.getBuffer());
+	cullingCursor.field("drawCommands").writeBuffer(*drawCommandBuffer);
+	cullingCursor.field("drawCounts").writeBuffer(*countBuffer);
+	cullingCursor.field("bucketCommandOffsets").writeBuffer(*bucketOffsetBuffer);
+
+	// The new instance buffer holds none of the instances
+	const uint32_t allFrames{(1u << app.maxFramesInFlight) - 1};
+	for (uint32_t slot = 0; slot < instances.size(); ++slot)
+	{
+		if (instances[slot].pendingFrames == 0)
+		{
+			pendingInstances.push_back(slot);
+		}
+		instances[slot].pendingFrames = allFrames;
+	}
+}
+
+void GpuScene::assignBucket(InstanceSlot& instance, const Model& model)
+{
+	const auto [bucketIt, inserted]{bucketsByAssets.try_emplace({model.getMaterial().getUUID().value, model.getMesh().getUUID().value}, 0)};
+	if (inserted)
+	{
+		if (freeBuckets.empty())
+		{
+			bucketIt->second = static_cast<uint32_t>(buckets.size());
+			buckets.emplace_back();
+		}
+		else
+		{
+			bucketIt->second = freeBuckets.back();
+			freeBuckets.pop_back();
+		}
+		buckets[bucketIt->second].emplace(model.getMaterial(), model.getMesh(), 0);
+	}
+
+	// Added before removing it from its old bucket, so a bucket the instance stays in is not freed
+	++buckets[bucketIt->second]->instanceCount;
+	removeFromBucket(instance);
+	instance.bucketIndex = bucketIt->second;
+}
+
+void GpuScene::removeFromBucket(const InstanceSlot& instance)
+{
+	if (instance.bucketIndex == noBucket)
+	{
+		return;
+	}
+
+	std::optional<GpuBucket>& bucket{buckets[instance.bucketIndex]};
+	if (--bucket->instanceCount == 0)
+	{
+		bucketsByAssets.erase({bucket->materialInstance.getUUID().value, bucket->mesh.getUUID().value});
+		bucket.reset();
+		freeBuckets.push_back(instance.bucketIndex);
+	}
+}
+
+void GpuScene::buildDraws(const std::optional<AssetHandle<MaterialInstance>>& fallbackMaterial, const uint32_t frameIndex)
+{
+	draws.clear();
+	MaterialInstance* fallback{fallbackMaterial ? &**fallbackMaterial : nullptr};
+
+	// Every instance of a bucket may add a command, so the commands of the buckets follow each other in bucket order
+	// Handles are resolved every frame, as assets move in memory when others are destroyed
+	uint32_t commandOffset{0};
+	for (uint32_t bucketIndex = 0; bucketIndex < buckets.size(); ++bucketIndex)
+	{
+		const std::optional<GpuBucket>& bucket{buckets[bucketIndex]};
+		if (!bucket)
+		{
+			continue;
+		}
+
+		mappedBucketOffsets[frameIndex * capacity + bucketIndex] = commandOffset;
+		const uint32_t bucketCommandOffset{commandOffset};
+		commandOffset += bucket->instanceCount;
+
+		MaterialInstance* materialInstance{&*bucket->materialInstance};
+		if (!materialInstance->prepare())
+		{
+			if (!fallback)
+			{
+				continue;
+			}
+			materialInstance = fallback;
+		}
+		draws.emplace_back(&*materialInstance->parentMaterial, materialInstance, &*bucket->mesh, bucketIndex, bucketCommandOffset, bucket->instanceCount);
+	}
+
+	// Buckets sharing state are drawn one after another, so their binds are skipped
+	std::ranges::sort(draws, {}, [](const GpuDraw& draw) { return std::tuple{draw.material, draw.materialInstance, draw.mesh}; });
+}
+
+Slang::ComPtr<slang::IComponentType> GpuScene::compileCullingProgram(const Renderer& app)
+{
+	auto cullingModule{app.compiler.loadModule("Core/culling")};
+	auto cullingEntry{SlangCompiler::findEntryPoint(cullingModule, "cullInstances")};
+	return app.compiler.composeProgram({cullingModule, cullingEntry});
+}
+
+vk::raii::Pipeline GpuScene::createPipeline(const Slang::ComPtr<slang::IComponentType>& program, const vk::raii::PipelineLayout& layout, const Renderer& app)
+{
+	const auto spirv{SlangCompiler::getSprirV(SlangCompiler::linkProgram(program), 0)};
+	const vk::raii::ShaderModule shaderModule{app.device, vk::ShaderModuleCreateInfo{{}, spirv->getBufferSize(), static_cast<const uint32_t*>(spirv->getBufferPointer())}};
+
+	const vk::ComputePipelineCreateInfo pipelineCreateInfo{{}, vk::PipelineShaderStageCreateInfo{{}, vk::ShaderStageFlagBits::eCompute, shaderModule, "main", nullptr}, layout};
+
+	return app.pipelineCache.createComputePipeline(pipelineCreateInfo);
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <slang/slang-com-ptr.h>
+
+#include "Buffer.hpp"
+#include "VulkanBackend.hpp"
+#include "Asset/MaterialInstance.hpp"
+#include "Asset/Mesh.hpp"
+#include "AssetSystem/AssetHandle.hpp"
+#include "ShaderCompilation/VulkanShaderObject.hpp"
+#include "ShaderCompilation/VulkanShaderObjectLayout.hpp"
+
+class InstanceBuffer;
+class Material;
+class Model;
+class Renderer;
+class Scene;
+
+// Instances sharing material instance and mesh. They are drawn by a single indirect draw with count
+// Buckets keep their index while they have instances, as the instances reference them by it
+struct GpuBucket
+{
+	AssetHandle<MaterialInstance> materialInstance;
+	AssetHandle<Mesh> mesh;
+	uint32_t instanceCount;
+};
+
+// A bucket resolved for the current frame
+struct GpuDraw
+{
+	const Material* material;
+	MaterialInstance* materialInstance;
+	const Mesh* mesh;
+	uint32_t bucketIndex;
+	// First draw command of the bucket, relative to the frame's region
+	uint32_t commandOffset;
+	uint32_t instanceCount;
+};
+
+struct GpuSceneStats
+{
+	uint32_t instanceCount{0};
+	uint32_t bucketCount{0};
+	uint32_t writtenInstances{0};
+	uint32_t indirectDraws{0};
+	uint32_t pipelineBinds{0};
+
+	void drawImGui() const;
+};
+
+// Persistent scene for GPU-driven rendering, and the compute pass that turns its instances into indirect draws
+// Every model keeps the instance slot of its index in the scene. Only the instances of models that changed are written
+// Like the instance buffer, the command and bucket buffers have a region per frame in flight
+class GpuScene
+{
+public:
+	GpuScene(const Renderer& app, const InstanceBuffer& instanceBuffer);
+
+	// Writes the instances of the models that changed since they were last written to this frame's region, and resolves the buckets to draw
+	// Expects the instance buffer to have room for all models. fallbackMaterial replaces material instances that are not compiled yet
+	void update(const Scene& scene, const std::optional<AssetHandle<MaterialInstance>>& fallbackMaterial, uint32_t frameIndex);
+
+	// Zeroes the frame's draw counts with a transfer. Must be recorded in its own pass before the culling
+	void recordClearCounts(const vk::raii::CommandBuffer& commandBuffer, uint32_t frameIndex) const;
+
+	// Culls all instances of the frame against the frustum and fills the draw commands. Must be recorded outside of a render pass
+	// Barriers to the cleared counts and to the indirect draws are left to the render graph
+	void recordCulling(const vk::raii::CommandBuffer& commandBuffer, uint32_t frameIndex, const glm::mat4& viewProjection) const;
+
+	// Issues one indirect draw per bucket. Expects set 0 to be bound already
+	void recordDraws(const vk::raii::CommandBuffer& commandBuffer, uint32_t frameIndex);
+
+	// Buckets drawn this frame, sorted by material, material instance and mesh
+	[[nodiscard]] const std::vector<GpuDraw>& getDraws() const;
+
+	// Stats of the last recorded frame
+	GpuSceneStats stats{};
+
+	[[nodiscard]] const Buffer& getDrawCommandBuffer() const;
+	[[nodiscard]] const Buffer& getCountBuffer() const;
+
+	static constexpr uint32_t workgroupSize{64};
+
+private:
+	struct InstanceSlot
+	{
+		uint64_t modelVersion;
+		uint32_t bucketIndex;
+		// Frames in flight whose region still holds an older version of the instance, one bit per frame
+		uint32_t pendingFrames;
+	};
+
+	static constexpr uint32_t noBucket{~0u};
+
+	const Renderer& app;
+	const InstanceBuffer& instanceBuffer;
+
+	Slang::ComPtr<slang::IComponentType> cullingProgram;
+	std::shared_ptr<VulkanShaderObjectLayout> cullingLayout;
+	std::shared_ptr<const ShaderTypeLayout> cullingConstantsLayout;
+	vk::PushConstantRange cullingConstantsRange{};
+	vk::raii::PipelineLayout pipelineLayout;
+	vk::raii::Pipeline pipeline;
+	VulkanShaderObject cullingObject;
+
+	// Capacity of the instance buffer the buffers were created for. Buckets and commands never outnumber instances, so they use the same capacity
+	uint32_t capacity{0};
+	std::optional<Buffer> drawCommandBuffer;
+	std::optional<Buffer> countBuffer;
+	std::optional<Buffer> bucketOffsetBuffer; // First draw command of every bucket, written every frame
+	uint32_t* mappedBucketOffsets{nullptr};
+
+	std::vector<InstanceSlot> instances; // By model index
+	std::vector<uint32_t> pendingInstances; // Slots with pending frames
+
+	std::vector<std::optional<GpuBucket>> buckets; // Empty buckets are freed and their index reused
+	std::vector<uint32_t> freeBuckets;
+	std::map<std::pair<size_t, size_t>, uint32_t> bucketsByAssets; // By UUID of material instance and mesh
+
+	std::vector<GpuDraw> draws;
+
+	// Follows reallocations of the instance buffer. All instances are written again afterwards
+	void reserve();
+
+	// Moves the instance to the bucket of the model's material instance and mesh
+	void assignBucket(InstanceSlot& instance, const Model& model);
+	void removeFromBucket(const InstanceSlot& instance);
+
+	// Resolves the buckets and assigns their draw commands
+	void buildDraws(const std::optional<AssetHandle<MaterialInstance>>& fallbackMaterial, uint32_t frameIndex);
+
+	static Slang::ComPtr<slang::IComponentType> compileCullingProgram(const Renderer& app);
+	static vk::raii::Pipeline createPipeline(const Slang::ComPtr<slang::IComponentType>& program, const vk::raii::PipelineLayout& layout, const Renderer& app);
+};
@@ -0,0 +1,56 @@
+#include "InstanceBuffer.hpp"
+
+#include <algorithm>
+#include <bit>
+
+#include "Renderer.hpp"
+
+InstanceBuffer::InstanceBuffer(const Renderer& app)
+	: app(app)
+{
+	reserve(minCapacity);
+}
+
+bool InstanceBuffer::reserve(const uint32_t instanceCount)
+{
+	if (instanceCount <= capacity)
+	{
+		return false;
+	}
+
+	// Frames in flight keep reading the old buffer through their descriptor sets, which are only rewritten once their frame is recorded again
+	if (buffer)
+	{
+		app.deletionQueue.push(std::move(*buffer));
+	}
+
+	capacity = std::bit_ceil(std::max(instanceCount, minCapacity));
+	buffer = Buffer{
+		app, vk::DeviceSize{app.maxFramesInFlight} * capacity * sizeof(InstanceData), vk::BufferUsageFlagBits::eStorageBuffer,
+		vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, MemoryCategory::Scene
+	};
+
+	// Stays mapped for the lifetime of the buffer
+	mappedInstances = static_cast<InstanceData*>(buffer->allocation.getMappedData());
+	return true;
+}
+
+std::span<InstanceData> InstanceBuffer::getFrameInstances(const uint32_t frameIndex) const
+{
+	return {mappedInstances + getFrameOffset(frameIndex), capacity};
+}
+
+uint32_t InstanceBuffer::getFrameOffset(const uint32_t frameIndex) const
+{
+	return frameIndex * capacity;
+}
+
+uint32_t InstanceBuffer::getCapacity() const
+{
+	return capacity;
+}
+
+const Buffer& InstanceBuffer::getBuffer() const
+{
+	return *buffer;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <span>
+
+#include <glm/glm.hpp>
+
+#include "Buffer.hpp"
+
+class Renderer;
+
+// Mirrors InstanceData of Core/globalData.slang
+struct InstanceData
+{
+	glm::mat4 modelTransform;
+	glm::mat4 inverseTransposeModelTransform;
+	glm::vec4 boundingSphere;
+	uint32_t indexCount;
+	uint32_t bucketIndex;
+	uint32_t padding[2];
+};
+
+static_assert(sizeof(InstanceData) == 160);
+
+// Per-instance data of all models drawn in a frame. Shaders read it through FrameData::instances
+// The render queue writes all of its instances every frame, the GPU scene keeps them and only writes the ones that changed
+// Every frame in flight owns a region of the buffer, so the CPU never writes data that the GPU still reads
+class InstanceBuffer
+{
+public:
+	explicit InstanceBuffer(const Renderer& app);
+
+	static constexpr uint32_t minCapacity{64};
+
+	// Makes room for instanceCount instances per frame
+	// Returns true if the buffer was reallocated. Descriptors referencing it must then be rewritten. The old buffer is released through the deletion queue
+	bool reserve(uint32_t instanceCount);
+
+	// Region of the frame. Stays mapped, writes are visible to the next submit
+	[[nodiscard]] std::span<InstanceData> getFrameInstances(uint32_t frameIndex) const;
+	// Index of the first instance of the frame's region in the whole buffer
+	[[nodiscard]] uint32_t getFrameOffset(uint32_t frameIndex) const;
+	// Instances per frame in flight
+	[[nodiscard]] uint32_t getCapacity() const;
+	[[nodiscard]] const Buffer& getBuffer() const;
+
+private:
+	const Renderer& app;
+
+	uint32_t capacity{0};
+	std::optional<Buffer> buffer;
+	InstanceData* mappedInstances{nullptr};
+};
@@ -0,0 +1,120 @@
+#include "MemoryAccounting.hpp"
+
+#include <cstdlib>
+#include <imgui.h>
+#include <utility>
+
+const char* getMemoryCategoryName(const MemoryCategory category)
+{
+	switch (category)
+	{
+	case MemoryCategory::Other:
+		return "Other";
+	case MemoryCategory::Mesh:
+		return "Mesh";
+	case MemoryCategory::Texture:
+		return "Texture";
+	case MemoryCategory::ShaderObject:
+		return "Shader object";
+	case MemoryCategory::RenderTarget:
+		return "Render target";
+	case MemoryCategory::Scene:
+		return "Scene";
+	case MemoryCategory::Staging:
+		return "Staging";
+	case MemoryCategory::ImGui:
+		return "ImGui";
+	default:
+		return "Unknown";
+	}
+}
+
+void HostMemoryTracker::add(const MemoryCategory category, const size_t size)
+{
+	bytes[static_cast<size_t>(category)].fetch_add(size, std::memory_order_relaxed);
+}
+
+void HostMemoryTracker::remove(const MemoryCategory category, const size_t size)
+{
+	bytes[static_cast<size_t>(category)].fetch_sub(size, std::memory_order_relaxed);
+}
+
+std::array<size_t, memoryCategoryCount> HostMemoryTracker::getBytes() const
+{
+	std::array<size_t, memoryCategoryCount> result{};
+	for (size_t i = 0; i < memoryCategoryCount; ++i)
+	{
+		result[i] = bytes[i].load(std::memory_order_relaxed);
+	}
+	return result;
+}
+
+// ImGui does not pass the size when freeing, so it is stored in front of the allocation
+static constexpr size_t imGuiHeaderSize{alignof(std::max_align_t)};
+
+static void* allocateForImGui(const size_t size, void* userData)
+{
+	void* allocation{std::malloc(imGuiHeaderSize + size)};
+	if (!allocation)
+	{
+		return nullptr;
+	}
+
+	*static_cast<size_t*>(allocation) = size;
+	static_cast<HostMemoryTracker*>(userData)->add(MemoryCategory::ImGui, size);
+	return static_cast<std::byte*>(allocation) + imGuiHeaderSize;
+}
+
+static void freeForImGui(void* pointer, void* userData)
+{
+	if (!pointer)
+	{
+		return;
+	}
+
+	void* allocation{static_cast<std::byte*>(pointer) - imGuiHeaderSize};
+	static_cast<HostMemoryTracker*>(userData)->remove(MemoryCategory::ImGui, *static_cast<size_t*>(allocation));
+	std::free(allocation);
+}
+
+void HostMemoryTracker::trackImGuiAllocations()
+{
+	ImGui::SetAllocatorFunctions(allocateForImGui, freeForImGui, this);
+}
+
+TrackedHostMemory::TrackedHostMemory(HostMemoryTracker& tracker, const MemoryCategory category, const size_t size)
+	: tracker(&tracker), category(category), size(size)
+{
+	tracker.add(category, size);
+}
+
+TrackedHostMemory::TrackedHostMemory(TrackedHostMemory&& other) noexcept
+	: tracker(std::exchange(other.tracker, nullptr)), category(other.category), size(other.size)
+{
+}
+
+TrackedHostMemory& TrackedHostMemory::operator=(TrackedHostMemory&& other) noexcept
+{
+	if (this != &other)
+	{
+		release();
+		tracker = std::exchange(other.tracker, nullptr);
+		category = other.category;
+		size = other.size;
+	}
+	return *this;
+}
+
+TrackedHostMemory::~TrackedHostMemory()
+{
+	release();
+}
+
+void TrackedHostMemory::release()
+{
+	if (tracker)
+	{
+		tracker->remove(category, size);
+		tracker = nullptr;
+	}
+}
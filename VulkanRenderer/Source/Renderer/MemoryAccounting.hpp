@@ -0,0 +1,62 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Owner of an allocation, used to break the memory usage down
+enum class MemoryCategory : uint8_t
+{
+	Other,
+	Mesh,
+	Texture,
+	ShaderObject,
+	// Depth images, offscreen targets and transient render graph images. Swapchain images belong to the driver and are not counted
+	RenderTarget,
+	// Per-instance data and GPU-driven draw buffers
+	Scene,
+	Staging,
+	ImGui,
+	Count
+};
+
+constexpr size_t memoryCategoryCount{static_cast<size_t>(MemoryCategory::Count)};
+
+const char* getMemoryCategoryName(MemoryCategory category);
+
+// Counts the long-lived host allocations per category. Owners report them, usually through TrackedHostMemory
+class HostMemoryTracker
+{
+public:
+	void add(MemoryCategory category, size_t size);
+	void remove(MemoryCategory category, size_t size);
+
+	[[nodiscard]] std::array<size_t, memoryCategoryCount> getBytes() const;
+
+	// Routes the allocations of ImGui through the tracker. Has to be called before the ImGui context is created
+	void trackImGuiAllocations();
+
+private:
+	std::array<std::atomic<size_t>, memoryCategoryCount> bytes{};
+};
+
+// Adds its size to a tracker for as long as it lives
+class TrackedHostMemory
+{
+public:
+	TrackedHostMemory(HostMemoryTracker& tracker, MemoryCategory category, size_t size);
+	TrackedHostMemory(TrackedHostMemory&& other) noexcept;
+	TrackedHostMemory& operator=(TrackedHostMemory&& other) noexcept;
+	~TrackedHostMemory();
+
+	TrackedHostMemory(const TrackedHostMemory&) = delete;
+	TrackedHostMemory& operator=(const TrackedHostMemory&) = delete;
+
+private:
+	HostMemoryTracker* tracker;
+	MemoryCategory category;
+	size_t size;
+
+	void release();
+};
@@ -0,0 +1,80 @@
+#include "MemoryReport.hpp"
+
+#include <fstream>
+#include <imgui.h>
+#include <ranges>
+#include <stdexcept>
+
+void MemoryReport::drawImGui() const
+{
+	constexpr float mebibyte{1024.f * 1024.f};
+
+	device.drawImGui();
+
+	ImGui::SeparatorText("Memory by owner");
+
+	if (ImGui::Button("Write memory.json"))
+	{
+		writeJson("memory.json");
+	}
+
+	if (!ImGui::BeginTable("Memory by owner", 3, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+	{
+		return;
+	}
+
+	ImGui::TableSetupColumn("Owner");
+	ImGui::TableSetupColumn("Device MiB");
+	ImGui::TableSetupColumn("Host MiB");
+	ImGui::TableHeadersRow();
+
+	for (size_t i = 0; i < memoryCategoryCount; ++i)
+	{
+		ImGui::TableNextRow();
+		ImGui::TableNextColumn();
+		ImGui::TextUnformatted(getMemoryCategoryName(static_cast<MemoryCategory>(i)));
+		ImGui::TableNextColumn();
+		ImGui::Text("%.2f", static_cast<float>(device.categoryBytes[i]) / mebibyte);
+		ImGui::TableNextColumn();
+		ImGui::Text("%.2f", static_cast<float>(hostBytes[i]) / mebibyte);
+	}
+
+	ImGui::EndTable();
+
+	ImGui::Text("Frame allocator chunks: %zu", frameAllocatorChunks);
+}
+
+void MemoryReport::writeJson(const std::filesystem::path& path) const
+{
+	std::ofstream file{path};
+	if (!file.is_open())
+	{
+		throw std::runtime_error("Failed to open memory report file " + path.string());
+	}
+
+	file << "{\n";
+	file << "  \"categories\": [\n";
+	for (size_t i = 0; i < memoryCategoryCount; ++i)
+	{
+		file << "    {\"name\": \"" << getMemoryCategoryName(static_cast<MemoryCategory>(i)) << "\", \"deviceBytes\": " << device.categoryBytes[i]
+			<< ", \"hostBytes\": " << hostBytes[i] << "}" << (i + 1 < memoryCategoryCount ? "," : "") << "\n";
+	}
+	file << "  ],\n";
+
+	file << "  \"hasMemoryBudget\": " << (device.hasMemoryBudget ? "true" : "false") << ",\n";
+	file << "  \"heaps\": [\n";
+	for (const auto& [index, heap] : device.heaps | std::views::enumerate)
+	{
+		file << "    {\"size\": " << heap.size << ", \"deviceLocal\": " << (heap.isDeviceLocal ? "true" : "false") << ", \"allocatedBytes\": " << heap.allocatedBytes
+			<< ", \"usage\": " << heap.usage << ", \"budget\": " << heap.budget << "}" << (index + 1 < std::ssize(device.heaps) ? "," : "") << "\n";
+	}
+	file << "  ],\n";
+
+	file << "  \"deviceAllocations\": " << device.deviceAllocationCount << ",\n";
+	file << "  \"blockBytes\": " << device.blockBytes << ",\n";
+	file << "  \"usedBlockBytes\": " << device.usedBlockBytes << ",\n";
+	file << "  \"dedicatedBytes\": " << device.dedicatedBytes << ",\n";
+	file << "  \"fragmentation\": " << device.getFragmentation() << ",\n";
+	file << "  \"frameAllocatorChunks\": " << frameAllocatorChunks << "\n";
+	file << "}\n";
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <array>
+#include <filesystem>
+
+#include "DeviceMemoryAllocator.hpp"
+#include "MemoryAccounting.hpp"
+
+// Device and host memory of the renderer by owner, together with the heap budgets
+struct MemoryReport
+{
+	DeviceMemoryStats device;
+	std::array<size_t, memoryCategoryCount> hostBytes{};
+	// Chunks the frame allocator took from the heap. Stays the same once the frames reach their steady state
+	size_t frameAllocatorChunks{0};
+
+	void drawImGui() const;
+	void writeJson(const std::filesystem::path& path) const;
+};
@@ -0,0 +1,58 @@
+#include "OffscreenTarget.hpp"
+
+#include <fstream>
+#include <vector>
+
+OffscreenTarget::OffscreenTarget(const vk::raii::Device& device, DeviceMemoryAllocator& allocator, const vk::Extent2D extent)
+	: colorImage(device, allocator, extent.width, extent.height, colorFormat, vk::ImageTiling::eOptimal, vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc,
+	             vk::MemoryPropertyFlagBits::eDeviceLocal, MemoryCategory::RenderTarget, vk::ImageAspectFlagBits::eColor),
+	  readbackBuffer(device, allocator, vk::DeviceSize{extent.width} * extent.height * 4, vk::BufferUsageFlagBits::eTransferDst,
+	                 vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, MemoryCategory::RenderTarget)
+{
+}
+
+void OffscreenTarget::recordReadback(const vk::raii::CommandBuffer& commandBuffer) const
+{
+	const vk::BufferImageCopy copyRegion{
+		0, 0, 0, vk::ImageSubresourceLayers{vk::ImageAspectFlagBits::eColor, 0, 0, 1}, vk::Offset3D{0, 0, 0}, vk::Extent3D{colorImage.width, colorImage.height, 1}
+	};
+	commandBuffer.copyImageToBuffer(colorImage.image, vk::ImageLayout::eTransferSrcOptimal, readbackBuffer.vkBuffer, copyRegion);
+
+	// The host reads the buffer after waiting for the frame's fence
+	const vk::BufferMemoryBarrier barrier{
+		vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eHostRead, vk::QueueFamilyIgnored, vk::QueueFamilyIgnored, readbackBuffer.vkBuffer, 0, vk::WholeSize
+	};
+	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost, {}, nullptr, barrier, nullptr);
+}
+
+void OffscreenTarget::writeToFile(const std::filesystem::path& path) const
+{
+	std::ofstream file{path, std::ios::binary};
+	if (!file.is_open())
+	{
+		throw std::runtime_error("Failed to open file " + path.string());
+	}
+
+	file << "P6\n" << colorImage.width << ' ' << colorImage.height << "\n255\n";
+
+	const auto* pixels{static_cast<const char*>(readbackBuffer.allocation.getMappedData())};
+
+	// PPM has no alpha channel, so we drop it row by row
+	std::vector<char> row(static_cast<size_t>(colorImage.width) * 3);
+	for (uint32_t y = 0; y < colorImage.height; ++y)
+	{
+		const char* srcRow{pixels + static_cast<size_t>(y) * colorImage.width * 4};
+		for (uint32_t x = 0; x < colorImage.width; ++x)
+		{
+			row[x * 3 + 0] = srcRow[x * 4 + 0];
+			row[x * 3 + 1] = srcRow[x * 4 + 1];
+			row[x * 3 + 2] = srcRow[x * 4 + 2];
+		}
+		file.write(row.data(), static_cast<std::streamsize>(row.size()));
+	}
+}
+
+vk::DeviceSize OffscreenTarget::getReadbackSize() const
+{
+	return vk::DeviceSize{colorImage.width} * colorImage.height * 4;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <filesystem>
+
+#include "Buffer.hpp"
+#include "Image.hpp"
+
+// Color target used instead of a swapchain image when rendering headless
+// Every frame is copied into a host visible buffer so that it can be written to disk
+class OffscreenTarget
+{
+public:
+	OffscreenTarget(const vk::raii::Device& device, DeviceMemoryAllocator& allocator, vk::Extent2D extent);
+
+	static constexpr vk::Format colorFormat{vk::Format::eR8G8B8A8Srgb};
+
+	Image colorImage;
+	Buffer readbackBuffer;
+
+	// Copies the color image into the readback buffer. Expects the color image to be in eTransferSrcOptimal
+	void recordReadback(const vk::raii::CommandBuffer& commandBuffer) const;
+
+	// Writes the content of the readback buffer as binary PPM. The frame that recorded the readback must have finished
+	void writeToFile(const std::filesystem::path& path) const;
+
+private:
+	[[nodiscard]] vk::DeviceSize getReadbackSize() const;
+};
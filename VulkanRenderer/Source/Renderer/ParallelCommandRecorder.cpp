@@ -0,0 +1,140 @@
+#include "ParallelCommandRecorder.hpp"
+
+ParallelCommandRecorder::ParallelCommandRecorder(const vk::raii::Device& device, const uint32_t queueFamilyIndex, const uint32_t framesInFlight, const uint32_t workerCount)
+{
+	workers.reserve(workerCount);
+	for (uint32_t i = 0; i < workerCount; ++i)
+	{
+		workers.push_back(createWorker(device, queueFamilyIndex, framesInFlight));
+	}
+
+	threads.reserve(workerCount);
+	for (uint32_t i = 0; i < workerCount; ++i)
+	{
+		threads.emplace_back(&ParallelCommandRecorder::runWorker, this, i);
+	}
+}
+
+ParallelCommandRecorder::~ParallelCommandRecorder()
+{
+	{
+		std::lock_guard lock{mutex};
+		stopping = true;
+	}
+	workAvailable.notify_all();
+
+	// Joined here, the workers still use the mutex while stopping
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+}
+
+uint32_t ParallelCommandRecorder::getWorkerCount() const
+{
+	return static_cast<uint32_t>(workers.size());
+}
+
+void ParallelCommandRecorder::resetFrame(const uint32_t frameIndex)
+{
+	for (Worker& worker : workers)
+	{
+		worker.commandPools[frameIndex].reset({});
+	}
+}
+
+std::pmr::vector<vk::CommandBuffer> ParallelCommandRecorder::record(const uint32_t frameIndex, const vk::CommandBufferInheritanceInfo& inheritanceInfo,
+                                                                   std::pmr::memory_resource* memoryResource, const RecordFunction& record)
+{
+	{
+		std::lock_guard lock{mutex};
+		currentRecord = &record;
+		currentFrame = frameIndex;
+		currentInheritanceInfo = inheritanceInfo;
+		workerException = nullptr;
+		pendingWorkers = getWorkerCount();
+		++generation;
+	}
+	workAvailable.notify_all();
+
+	{
+		std::unique_lock lock{mutex};
+		workDone.wait(lock, [this] { return pendingWorkers == 0; });
+		currentRecord = nullptr;
+		if (workerException)
+		{
+			std::rethrow_exception(workerException);
+		}
+	}
+
+	std::pmr::vector<vk::CommandBuffer> commandBuffers{memoryResource};
+	commandBuffers.reserve(workers.size());
+	for (const Worker& worker : workers)
+	{
+		// Executing empty command buffers still costs the driver
+		if (worker.recorded)
+		{
+			commandBuffers.push_back(worker.commandBuffers[frameIndex]);
+		}
+	}
+	return commandBuffers;
+}
+
+void ParallelCommandRecorder::runWorker(const uint32_t workerIndex)
+{
+	uint64_t finishedGeneration{0};
+	while (true)
+	{
+		std::unique_lock lock{mutex};
+		workAvailable.wait(lock, [&] { return stopping || generation != finishedGeneration; });
+		if (stopping)
+		{
+			return;
+		}
+		finishedGeneration = generation;
+
+		const RecordFunction& record{*currentRecord};
+		const vk::CommandBufferInheritanceInfo inheritanceInfo{currentInheritanceInfo};
+		Worker& worker{workers[workerIndex]};
+		const vk::raii::CommandBuffer& commandBuffer{worker.commandBuffers[currentFrame]};
+		lock.unlock();
+
+		worker.recorded = false;
+		try
+		{
+			commandBuffer.begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit | vk::CommandBufferUsageFlagBits::eRenderPassContinue, &inheritanceInfo});
+			const bool recorded{record(workerIndex, commandBuffer)};
+			commandBuffer.end();
+			worker.recorded = recorded;
+		}
+		catch (...)
+		{
+			lock.lock();
+			if (!workerException)
+			{
+				workerException = std::current_exception();
+			}
+			lock.unlock();
+		}
+
+		lock.lock();
+		if (--pendingWorkers == 0)
+		{
+			workDone.notify_one();
+		}
+	}
+}
+
+ParallelCommandRecorder::Worker ParallelCommandRecorder::createWorker(const vk::raii::Device& device, const uint32_t queueFamilyIndex, const uint32_t framesInFlight)
+{
+	Worker worker{};
+	worker.commandPools.reserve(framesInFlight);
+	worker.commandBuffers.reserve(framesInFlight);
+	for (uint32_t i = 0; i < framesInFlight; ++i)
+	{
+		// Command buffers are never reset on their own, the whole pool is reset at the start of its frame
+		const vk::raii::CommandPool& commandPool{worker.commandPools.emplace_back(device, vk::CommandPoolCreateInfo{vk::CommandPoolCreateFlagBits::eTransient, queueFamilyIndex})};
+		worker.commandBuffers.push_back(std::move(device.allocateCommandBuffers({commandPool, vk::CommandBufferLevel::eSecondary, 1}).front()));
+	}
+	return worker;
+}
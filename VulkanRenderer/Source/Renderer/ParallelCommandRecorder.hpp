@@ -0,0 +1,66 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory_resource>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "VulkanBackend.hpp"
+
+// Worker threads recording secondary command buffers that the primary command buffer executes inside the render pass
+// Every worker owns a command pool per frame in flight. Pools are reset once per frame instead of resetting single command buffers
+class ParallelCommandRecorder
+{
+public:
+	// Returns false if nothing was recorded, the command buffer is then left out
+	using RecordFunction = std::function<bool(uint32_t workerIndex, const vk::raii::CommandBuffer& commandBuffer)>;
+
+	ParallelCommandRecorder(const vk::raii::Device& device, uint32_t queueFamilyIndex, uint32_t framesInFlight, uint32_t workerCount);
+	~ParallelCommandRecorder();
+
+	ParallelCommandRecorder(const ParallelCommandRecorder&) = delete;
+	ParallelCommandRecorder& operator=(const ParallelCommandRecorder&) = delete;
+
+	[[nodiscard]] uint32_t getWorkerCount() const;
+
+	// Resets the command pools of a frame. The GPU must have finished the frame
+	void resetFrame(uint32_t frameIndex);
+
+	// Calls record on every worker with the worker's secondary command buffer of the frame, begun to continue the render pass of inheritanceInfo
+	// Blocks until all workers are done and returns the command buffers that were recorded into in worker order. Exceptions of workers are rethrown here
+	// The returned vector allocates from memoryResource
+	std::pmr::vector<vk::CommandBuffer> record(uint32_t frameIndex, const vk::CommandBufferInheritanceInfo& inheritanceInfo, std::pmr::memory_resource* memoryResource,
+	                                           const RecordFunction& record);
+
+private:
+	struct Worker
+	{
+		std::vector<vk::raii::CommandPool> commandPools; // One per frame in flight
+		std::vector<vk::raii::CommandBuffer> commandBuffers; // One per frame in flight, allocated from the pool of the frame
+		bool recorded{false}; // Result of the last record call
+	};
+
+	std::vector<Worker> workers;
+	std::vector<std::thread> threads;
+
+	std::mutex mutex;
+	std::condition_variable workAvailable;
+	std::condition_variable workDone;
+	// Incremented for every call to record, so that workers notice new work
+	uint64_t generation{0};
+	uint32_t pendingWorkers{0};
+	bool stopping{false};
+
+	const RecordFunction* currentRecord{nullptr};
+	uint32_t currentFrame{0};
+	vk::CommandBufferInheritanceInfo currentInheritanceInfo{};
+	std::exception_ptr workerException;
+
+	void runWorker(uint32_t workerIndex);
+
+	static Worker createWorker(const vk::raii::Device& device, uint32_t queueFamilyIndex, uint32_t framesInFlight);
+};
@@ -0,0 +1,180 @@
+#include "PipelineCache.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <imgui.h>
+#include <iterator>
+#include <random>
+
+static constexpr uint32_t fileMagic{0x43505643}; // "CVPC"
+
+// Header the driver writes at the start of its data, see VkPipelineCacheHeaderVersionOne
+struct DriverHeader
+{
+	uint32_t headerSize;
+	vk::PipelineCacheHeaderVersion headerVersion;
+	uint32_t vendorID;
+	uint32_t deviceID;
+	std::array<uint8_t, vk::UuidSize> pipelineCacheUUID;
+};
+
+static bool matchesDevice(const DriverHeader& header, const vk::PhysicalDeviceProperties& properties)
+{
+	return header.headerSize >= sizeof(DriverHeader) && header.headerVersion == vk::PipelineCacheHeaderVersion::eOne && header.vendorID == properties.vendorID &&
+		header.deviceID == properties.deviceID && std::ranges::equal(header.pipelineCacheUUID, properties.pipelineCacheUUID);
+}
+
+void PipelineCacheStats::drawImGui() const
+{
+	ImGui::SeparatorText("Pipeline cache");
+	ImGui::Text("Pipelines: %u, hits: %u, misses: %u", pipelineCount, hits, misses);
+	ImGui::Text("Creation time: %.2f ms", creationMilliseconds);
+	ImGui::Text("Loaded: %.2f KiB", static_cast<float>(loadedBytes) / 1024.f);
+}
+
+PipelineCache::PipelineCache(const vk::raii::Device& device, const vk::raii::PhysicalDevice& physicalDevice, const std::optional<std::filesystem::path>& path)
+	: device(device), path(path), fileHeader{}, cache(nullptr)
+{
+	const vk::PhysicalDeviceProperties properties{physicalDevice.getProperties()};
+	fileHeader = {fileMagic, properties.vendorID, properties.deviceID, properties.driverVersion, properties.pipelineCacheUUID};
+
+	const std::vector<char> data{loadData(properties)};
+	stats.loadedBytes = data.size();
+	cache = vk::raii::PipelineCache{device, vk::PipelineCacheCreateInfo{{}, data.size(), data.data()}};
+}
+
+PipelineCache::~PipelineCache()
+{
+	save();
+}
+
+vk::raii::Pipeline PipelineCache::createGraphicsPipeline(vk::GraphicsPipelineCreateInfo createInfo)
+{
+	vk::PipelineCreationFeedback feedback{};
+	const vk::PipelineCreationFeedbackCreateInfo feedbackCreateInfo{&feedback, 0, nullptr, createInfo.pNext};
+	createInfo.pNext = &feedbackCreateInfo;
+
+	const auto start{std::chrono::steady_clock::now()};
+	vk::raii::Pipeline pipeline{device, cache, createInfo};
+	recordFeedback(feedback, std::chrono::steady_clock::now() - start);
+	return pipeline;
+}
+
+vk::raii::Pipeline PipelineCache::createComputePipeline(vk::ComputePipelineCreateInfo createInfo)
+{
+	vk::PipelineCreationFeedback feedback{};
+	const vk::PipelineCreationFeedbackCreateInfo feedbackCreateInfo{&feedback, 0, nullptr, createInfo.pNext};
+	createInfo.pNext = &feedbackCreateInfo;
+
+	const auto start{std::chrono::steady_clock::now()};
+	vk::raii::Pipeline pipeline{device, cache, createInfo};
+	recordFeedback(feedback, std::chrono::steady_clock::now() - start);
+	return pipeline;
+}
+
+void PipelineCache::save() const
+{
+	if (!path)
+	{
+		return;
+	}
+
+	std::vector<uint8_t> data;
+	try
+	{
+		data = cache.getData();
+	}
+	catch (const vk::SystemError&)
+	{
+		return;
+	}
+
+	// Written next to the file and renamed into place, so other processes never load a partial cache
+	std::filesystem::path temporaryPath{*path};
+	temporaryPath += std::format(".{:08x}.tmp", std::random_device{}());
+
+	std::error_code error;
+	if (path->has_parent_path())
+	{
+		std::filesystem::create_directories(path->parent_path(), error);
+	}
+	{
+		std::ofstream file{temporaryPath, std::ios::binary};
+		if (!file)
+		{
+			return;
+		}
+		file.write(reinterpret_cast<const char*>(&fileHeader), sizeof(FileHeader));
+		file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+		if (!file.flush())
+		{
+			file.close();
+			std::filesystem::remove(temporaryPath, error);
+			return;
+		}
+	}
+
+	std::filesystem::rename(temporaryPath, *path, error);
+	if (error)
+	{
+		std::filesystem::remove(temporaryPath, error);
+	}
+}
+
+PipelineCacheStats PipelineCache::getStats() const
+{
+	std::lock_guard lock{statsMutex};
+	return stats;
+}
+
+std::vector<char> PipelineCache::loadData(const vk::PhysicalDeviceProperties& properties)
+{
+	if (!path)
+	{
+		return {};
+	}
+
+	std::ifstream file{*path, std::ios::binary};
+	FileHeader header{};
+	if (!file || !file.read(reinterpret_cast<char*>(&header), sizeof(FileHeader)) || std::memcmp(&header, &fileHeader, sizeof(FileHeader)) != 0)
+	{
+		return {};
+	}
+
+	std::vector<char> data{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+
+	// Drivers are required to reject foreign data themselves, but some crash on it instead
+	DriverHeader driverHeader{};
+	if (data.size() < sizeof(DriverHeader))
+	{
+		return {};
+	}
+	std::memcpy(&driverHeader, data.data(), sizeof(DriverHeader));
+	if (!matchesDevice(driverHeader, properties))
+	{
+		return {};
+	}
+	return data;
+}
+
+void PipelineCache::recordFeedback(const vk::PipelineCreationFeedback& feedback, const std::chrono::steady_clock::duration creationTime)
+{
+	std::lock_guard lock{statsMutex};
+	++stats.pipelineCount;
+	stats.creationMilliseconds += std::chrono::duration<double, std::milli>{creationTime}.count();
+	if (!(feedback.flags & vk::PipelineCreationFeedbackFlagBits::eValid))
+	{
+		return;
+	}
+
+	if (feedback.flags & vk::PipelineCreationFeedbackFlagBits::eApplicationPipelineCacheHit)
+	{
+		++stats.hits;
+	}
+	else
+	{
+		++stats.misses;
+	}
+}
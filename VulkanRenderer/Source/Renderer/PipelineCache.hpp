@@ -0,0 +1,70 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#include "VulkanBackend.hpp"
+
+struct PipelineCacheStats
+{
+	// Reported by the driver through pipeline creation feedback. Pipelines without feedback count as neither
+	uint32_t hits{0};
+	uint32_t misses{0};
+	uint32_t pipelineCount{0};
+	// Host time spent creating pipelines, including hits
+	double creationMilliseconds{0.};
+	// Size of the data loaded at startup. 0 if there was none or it was created by another device or driver
+	size_t loadedBytes{0};
+
+	void drawImGui() const;
+};
+
+// Pipeline cache shared by every pipeline of the renderer. Loaded from disk at startup and saved again when destroyed
+// Vulkan pipeline caches are internally synchronized, so pipelines may be created from several threads
+class PipelineCache
+{
+public:
+	// Without a path the cache only lives as long as the renderer
+	PipelineCache(const vk::raii::Device& device, const vk::raii::PhysicalDevice& physicalDevice, const std::optional<std::filesystem::path>& path);
+	~PipelineCache();
+
+	PipelineCache(const PipelineCache&) = delete;
+	PipelineCache& operator=(const PipelineCache&) = delete;
+
+	[[nodiscard]] vk::raii::Pipeline createGraphicsPipeline(vk::GraphicsPipelineCreateInfo createInfo);
+	[[nodiscard]] vk::raii::Pipeline createComputePipeline(vk::ComputePipelineCreateInfo createInfo);
+
+	// Writes the cache to its path. Failing to write is not an error, the pipelines are just created from scratch next time
+	void save() const;
+
+	[[nodiscard]] PipelineCacheStats getStats() const;
+
+private:
+	// Precedes the driver's data in the file. The driver's own header has no driver version, so updated drivers would get stale data otherwise
+	struct FileHeader
+	{
+		uint32_t magic;
+		uint32_t vendorID;
+		uint32_t deviceID;
+		uint32_t driverVersion;
+		std::array<uint8_t, vk::UuidSize> pipelineCacheUUID;
+	};
+
+	const vk::raii::Device& device;
+	std::optional<std::filesystem::path> path;
+	FileHeader fileHeader;
+	vk::raii::PipelineCache cache;
+
+	mutable std::mutex statsMutex;
+	PipelineCacheStats stats;
+
+	// Empty if the file is missing, from another device or driver, or corrupt
+	[[nodiscard]] std::vector<char> loadData(const vk::PhysicalDeviceProperties& properties);
+
+	void recordFeedback(const vk::PipelineCreationFeedback& feedback, std::chrono::steady_clock::duration creationTime);
+};
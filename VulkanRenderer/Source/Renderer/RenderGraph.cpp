@@ -0,0 +1,589 @@
+#include "RenderGraph.hpp"
+
+#include <algorithm>
+#include <imgui.h>
+#include <numeric>
+
+#include "GpuProfiler.hpp"
+#include "Image.hpp"
+#include "Renderer.hpp"
+
+struct RenderGraphUsageInfo
+{
+	vk::PipelineStageFlags2 stages;
+	vk::AccessFlags2 access;
+	vk::ImageLayout layout;
+	vk::ImageUsageFlags imageUsage;
+};
+
+static RenderGraphUsageInfo getUsageInfo(const RenderGraphUsage usage)
+{
+	switch (usage)
+	{
+	case RenderGraphUsage::ColorAttachment:
+		return {
+			vk::PipelineStageFlagBits2::eColorAttachmentOutput, vk::AccessFlagBits2::eColorAttachmentRead | vk::AccessFlagBits2::eColorAttachmentWrite,
+			vk::ImageLayout::eColorAttachmentOptimal, vk::ImageUsageFlagBits::eColorAttachment
+		};
+	case RenderGraphUsage::DepthAttachment:
+		return {
+			vk::PipelineStageFlagBits2::eEarlyFragmentTests | vk::PipelineStageFlagBits2::eLateFragmentTests,
+			vk::AccessFlagBits2::eDepthStencilAttachmentRead | vk::AccessFlagBits2::eDepthStencilAttachmentWrite, vk::ImageLayout::eDepthStencilAttachmentOptimal,
+			vk::ImageUsageFlagBits::eDepthStencilAttachment
+		};
+	case RenderGraphUsage::FragmentShaderRead:
+		return {vk::PipelineStageFlagBits2::eFragmentShader, vk::AccessFlagBits2::eShaderRead, vk::ImageLayout::eShaderReadOnlyOptimal, vk::ImageUsageFlagBits::eSampled};
+	case RenderGraphUsage::ComputeShaderRead:
+		return {vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderRead, vk::ImageLayout::eShaderReadOnlyOptimal, vk::ImageUsageFlagBits::eSampled};
+	case RenderGraphUsage::ComputeShaderWrite:
+		return {
+			vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderRead | vk::AccessFlagBits2::eShaderWrite, vk::ImageLayout::eGeneral,
+			vk::ImageUsageFlagBits::eStorage
+		};
+	case RenderGraphUsage::IndirectRead:
+		return {vk::PipelineStageFlagBits2::eDrawIndirect, vk::AccessFlagBits2::eIndirectCommandRead, vk::ImageLayout::eUndefined, {}};
+	case RenderGraphUsage::TransferRead:
+		return {vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferRead, vk::ImageLayout::eTransferSrcOptimal, vk::ImageUsageFlagBits::eTransferSrc};
+	case RenderGraphUsage::TransferWrite:
+		return {vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite, vk::ImageLayout::eTransferDstOptimal, vk::ImageUsageFlagBits::eTransferDst};
+	}
+	throw std::runtime_error("Unknown render graph usage");
+}
+
+// Only writes have to be made available to later accesses
+static constexpr vk::AccessFlags2 writeAccessMask{
+	vk::AccessFlagBits2::eShaderWrite | vk::AccessFlagBits2::eColorAttachmentWrite | vk::AccessFlagBits2::eDepthStencilAttachmentWrite | vk::AccessFlagBits2::eTransferWrite
+};
+
+void RenderGraphStats::drawImGui() const
+{
+	constexpr float mebibyte{1024.f * 1024.f};
+
+	ImGui::SeparatorText("Render graph");
+	ImGui::Text("Passes: %u (%u culled)", passCount, culledPassCount);
+	ImGui::Text("Image barriers: %u", imageBarrierCount);
+	ImGui::Text("Buffer barriers: %u", bufferBarrierCount);
+	ImGui::Text("Transient images: %u", transientImageCount);
+	ImGui::Text("Transient memory: %.2f MiB (%.2f MiB without aliasing)", static_cast<float>(transientMemorySize) / mebibyte, static_cast<float>(unaliasedMemorySize) / mebibyte);
+}
+
+RenderGraphPass::RenderGraphPass(std::string name)
+	: name(std::move(name))
+{
+}
+
+RenderGraphPass& RenderGraphPass::read(const RenderGraphResource resource, const RenderGraphUsage usage)
+{
+	accesses.emplace_back(resource, usage, true, false);
+	return *this;
+}
+
+RenderGraphPass& RenderGraphPass::write(const RenderGraphResource resource, const RenderGraphUsage usage)
+{
+	accesses.emplace_back(resource, usage, false, true);
+	return *this;
+}
+
+RenderGraphPass& RenderGraphPass::addColorAttachment(const RenderGraphResource image, const vk::AttachmentLoadOp loadOp, const vk::ClearValue& clearValue,
+                                                     const vk::AttachmentStoreOp storeOp)
+{
+	colorAttachments.emplace_back(image, loadOp, storeOp, clearValue);
+	// Loading the previous content makes the pass depend on the passes that wrote it
+	accesses.emplace_back(image, RenderGraphUsage::ColorAttachment, loadOp == vk::AttachmentLoadOp::eLoad, true);
+	return *this;
+}
+
+RenderGraphPass& RenderGraphPass::setDepthAttachment(const RenderGraphResource image, const vk::AttachmentLoadOp loadOp, const vk::ClearValue& clearValue,
+                                                     const vk::AttachmentStoreOp storeOp)
+{
+	depthAttachment.emplace(image, loadOp, storeOp, clearValue);
+	accesses.emplace_back(image, RenderGraphUsage::DepthAttachment, loadOp == vk::AttachmentLoadOp::eLoad, true);
+	return *this;
+}
+
+RenderGraphPass& RenderGraphPass::useSecondaryCommandBuffers()
+{
+	secondaryCommandBuffers = true;
+	return *this;
+}
+
+RenderGraphPass& RenderGraphPass::markSideEffect()
+{
+	sideEffect = true;
+	return *this;
+}
+
+RenderGraphPass& RenderGraphPass::setExecute(std::function<void(const RenderGraphContext&)> execute)
+{
+	this->execute = std::move(execute);
+	return *this;
+}
+
+RenderGraph::RenderGraph(const Renderer& app)
+	: app(app)
+{
+}
+
+void RenderGraph::reset()
+{
+	resources.clear();
+	passes.clear();
+	finalBarriers.clear();
+}
+
+RenderGraphResource RenderGraph::importImage(const std::string& name, const vk::Image image, const vk::ImageView imageView, const RenderGraphImageInfo& info,
+                                             const vk::ImageLayout initialLayout, const vk::ImageLayout finalLayout)
+{
+	resources.push_back(Resource{name, true, true, image, imageView, nullptr, info, initialLayout, finalLayout});
+	return {static_cast<uint32_t>(resources.size() - 1)};
+}
+
+RenderGraphResource RenderGraph::importBuffer(const std::string& name, const vk::Buffer buffer)
+{
+	resources.push_back(Resource{name, true, false, nullptr, nullptr, buffer, {}, vk::ImageLayout::eUndefined, vk::ImageLayout::eUndefined});
+	return {static_cast<uint32_t>(resources.size() - 1)};
+}
+
+RenderGraphResource RenderGraph::createImage(const std::string& name, const RenderGraphImageInfo& info)
+{
+	// Image and view are assigned once the graph is compiled
+	resources.push_back(Resource{name, false, true, nullptr, nullptr, nullptr, info, vk::ImageLayout::eUndefined, vk::ImageLayout::eUndefined});
+	return {static_cast<uint32_t>(resources.size() - 1)};
+}
+
+RenderGraphPass& RenderGraph::addPass(const std::string& name)
+{
+	passes.push_back(RenderGraphPass{name});
+	return passes.back();
+}
+
+void RenderGraph::compile()
+{
+	stats = {};
+	stats.passCount = static_cast<uint32_t>(passes.size());
+
+	cullPasses();
+	computeLifetimes();
+	allocateTransientImages();
+	computeBarriers();
+}
+
+void RenderGraph::execute(const vk::raii::CommandBuffer& commandBuffer, GpuProfiler* profiler) const
+{
+	for (const RenderGraphPass& pass : passes)
+	{
+		if (pass.culled)
+		{
+			continue;
+		}
+
+		const uint32_t profilerScope{profiler ? profiler->beginScope(commandBuffer, pass.name) : 0};
+		executePass(commandBuffer, pass);
+		if (profiler)
+		{
+			profiler->endScope(commandBuffer, profilerScope);
+		}
+	}
+
+	if (!finalBarriers.empty())
+	{
+		commandBuffer.pipelineBarrier2(vk::DependencyInfo{{}, nullptr, nullptr, finalBarriers});
+	}
+}
+
+void RenderGraph::executePass(const vk::raii::CommandBuffer& commandBuffer, const RenderGraphPass& pass) const
+{
+	if (!pass.imageBarriers.empty() || !pass.bufferBarriers.empty())
+	{
+		commandBuffer.pipelineBarrier2(vk::DependencyInfo{{}, nullptr, pass.bufferBarriers, pass.imageBarriers});
+	}
+
+	if (pass.colorAttachments.empty() && !pass.depthAttachment)
+	{
+		if (pass.execute)
+		{
+			pass.execute({commandBuffer, nullptr});
+		}
+		return;
+	}
+
+	vk::Extent2D extent{};
+	std::pmr::vector<vk::RenderingAttachmentInfo> colorAttachmentInfos{app.frameAllocator.makeVector<vk::RenderingAttachmentInfo>()};
+	std::pmr::vector<vk::Format> colorFormats{app.frameAllocator.makeVector<vk::Format>()};
+	for (const RenderGraphAttachment& attachment : pass.colorAttachments)
+	{
+		const Resource& image{resources[attachment.image.index]};
+		colorAttachmentInfos.emplace_back(image.imageView, vk::ImageLayout::eColorAttachmentOptimal, vk::ResolveModeFlagBits::eNone, nullptr, vk::ImageLayout::eUndefined,
+		                                  attachment.loadOp, attachment.storeOp, attachment.clearValue);
+		colorFormats.push_back(image.info.format);
+		extent = image.info.extent;
+	}
+
+	std::optional<vk::RenderingAttachmentInfo> depthAttachmentInfo{};
+	vk::Format depthFormat{vk::Format::eUndefined};
+	if (pass.depthAttachment)
+	{
+		const Resource& image{resources[pass.depthAttachment->image.index]};
+		depthAttachmentInfo.emplace(image.imageView, vk::ImageLayout::eDepthStencilAttachmentOptimal, vk::ResolveModeFlagBits::eNone, nullptr, vk::ImageLayout::eUndefined,
+		                            pass.depthAttachment->loadOp, pass.depthAttachment->storeOp, pass.depthAttachment->clearValue);
+		depthFormat = image.info.format;
+		extent = image.info.extent;
+	}
+
+	const vk::RenderingFlags renderingFlags{pass.secondaryCommandBuffers ? vk::RenderingFlagBits::eContentsSecondaryCommandBuffers : vk::RenderingFlags{}};
+	const vk::RenderingInfo renderingInfo{
+		renderingFlags, vk::Rect2D{{0, 0}, extent}, 1, 0, colorAttachmentInfos, depthAttachmentInfo ? &*depthAttachmentInfo : nullptr, nullptr
+	};
+
+	// Secondary command buffers have to know the formats of the attachments they render to. They must not inherit the flag that they are used
+	const vk::CommandBufferInheritanceRenderingInfo inheritanceRenderingInfo{vk::RenderingFlags{}, 0, colorFormats, depthFormat, vk::Format::eUndefined, vk::SampleCountFlagBits::e1};
+	const vk::CommandBufferInheritanceInfo inheritanceInfo{nullptr, 0, nullptr, false, {}, {}, &inheritanceRenderingInfo};
+
+	commandBuffer.beginRendering(renderingInfo);
+	if (pass.execute)
+	{
+		pass.execute({commandBuffer, pass.secondaryCommandBuffers ? &inheritanceInfo : nullptr});
+	}
+	commandBuffer.endRendering();
+}
+
+void RenderGraph::cullPasses()
+{
+	// Walk the passes backwards, so the readers of a resource are known before its writers are visited
+	std::pmr::vector<bool> needed(resources.size(), app.frameAllocator.getResource());
+	for (size_t i = 0; i < resources.size(); ++i)
+	{
+		needed[i] = resources[i].imported;
+	}
+
+	for (auto pass = passes.rbegin(); pass != passes.rend(); ++pass)
+	{
+		pass->culled = !pass->sideEffect && std::ranges::none_of(pass->accesses, [&](const RenderGraphPass::Access& access)
+		{
+			return access.isWrite && needed[access.resource.index];
+		});
+
+		if (pass->culled)
+		{
+			++stats.culledPassCount;
+			continue;
+		}
+
+		for (const RenderGraphPass::Access& access : pass->accesses)
+		{
+			if (access.isRead)
+			{
+				needed[access.resource.index] = true;
+			}
+		}
+	}
+}
+
+void RenderGraph::computeLifetimes()
+{
+	for (uint32_t passIndex = 0; passIndex < passes.size(); ++passIndex)
+	{
+		const RenderGraphPass& pass{passes[passIndex]};
+		if (pass.culled)
+		{
+			continue;
+		}
+
+		for (const RenderGraphPass::Access& access : pass.accesses)
+		{
+			Resource& resource{resources[access.resource.index]};
+			const RenderGraphUsageInfo usageInfo{getUsageInfo(access.usage)};
+
+			if (!resource.firstPass)
+			{
+				resource.firstPass = passIndex;
+			}
+			resource.lastPass = passIndex;
+			resource.usage |= usageInfo.imageUsage;
+			resource.usedStages |= usageInfo.stages;
+			if (access.isWrite)
+			{
+				resource.writtenAccess |= usageInfo.access & writeAccessMask;
+			}
+		}
+	}
+}
+
+void RenderGraph::allocateTransientImages()
+{
+	// Transients that no remaining pass uses are never created
+	std::pmr::vector<uint32_t> transientResources{app.frameAllocator.makeVector<uint32_t>()};
+	for (uint32_t i = 0; i < resources.size(); ++i)
+	{
+		if (!resources[i].imported && resources[i].firstPass)
+		{
+			transientResources.push_back(i);
+		}
+	}
+
+	if (!matchesTransientImages(transientResources))
+	{
+		// Earlier frames may still render to the old images
+		app.deletionQueue.push(std::move(transientImages));
+		app.deletionQueue.push(std::move(transientMemory));
+		transientImages.clear();
+		transientMemory = {};
+
+		uint32_t memoryTypeBits{~0u};
+		vk::DeviceSize memoryAlignment{1};
+		for (const uint32_t resourceIndex : transientResources)
+		{
+			const Resource& resource{resources[resourceIndex]};
+			TransientImage& transientImage{transientImages.emplace_back(resource.info, resource.usage, *resource.firstPass, resource.lastPass)};
+
+			const vk::ImageCreateInfo imageCreateInfo{
+				{}, vk::ImageType::e2D, resource.info.format, vk::Extent3D{resource.info.extent.width, resource.info.extent.height, 1}, 1, 1, vk::SampleCountFlagBits::e1,
+				vk::ImageTiling::eOptimal, resource.usage, vk::SharingMode::eExclusive, nullptr, vk::ImageLayout::eUndefined
+			};
+			transientImage.image = vk::raii::Image{app.device, imageCreateInfo};
+
+			const vk::MemoryRequirements memoryRequirements{transientImage.image.getMemoryRequirements()};
+			transientImage.memorySize = memoryRequirements.size;
+			memoryTypeBits &= memoryRequirements.memoryTypeBits;
+			memoryAlignment = std::max(memoryAlignment, memoryRequirements.alignment);
+		}
+
+		// Largest images are placed first. Every image starts at the lowest offset where it does not overlap
+		// an already placed image whose lifetime overlaps its own
+		std::vector<uint32_t> placementOrder(transientImages.size());
+		std::iota(placementOrder.begin(), placementOrder.end(), 0u);
+		std::ranges::sort(placementOrder, [&](const uint32_t a, const uint32_t b) { return transientImages[a].memorySize > transientImages[b].memorySize; });
+
+		vk::DeviceSize memorySize{0};
+		for (size_t i = 0; i < placementOrder.size(); ++i)
+		{
+			TransientImage& transientImage{transientImages[placementOrder[i]]};
+			const vk::DeviceSize alignment{transientImage.image.getMemoryRequirements().alignment};
+
+			bool moved{true};
+			while (moved)
+			{
+				moved = false;
+				for (size_t j = 0; j < i; ++j)
+				{
+					const TransientImage& placedImage{transientImages[placementOrder[j]]};
+					const bool lifetimesOverlap{transientImage.firstPass <= placedImage.lastPass && placedImage.firstPass <= transientImage.lastPass};
+					const bool memoryOverlaps{
+						transientImage.memoryOffset < placedImage.memoryOffset + placedImage.memorySize && placedImage.memoryOffset < transientImage.memoryOffset + transientImage.memorySize
+					};
+					if (lifetimesOverlap && memoryOverlaps)
+					{
+						transientImage.memoryOffset = (placedImage.memoryOffset + placedImage.memorySize + alignment - 1) / alignment * alignment;
+						moved = true;
+					}
+				}
+			}
+			memorySize = std::max(memorySize, transientImage.memoryOffset + transientImage.memorySize);
+		}
+
+		if (memorySize > 0)
+		{
+			transientMemory = app.memoryAllocator.allocate(vk::MemoryRequirements{memorySize, memoryAlignment, memoryTypeBits}, vk::MemoryPropertyFlagBits::eDeviceLocal, false,
+			                                               MemoryCategory::RenderTarget);
+		}
+
+		for (TransientImage& transientImage : transientImages)
+		{
+			transientImage.image.bindMemory(transientMemory.getMemory(), transientMemory.getOffset() + transientImage.memoryOffset);
+			transientImage.imageView = Image::createImageView(app.device, transientImage.image, transientImage.info.format, transientImage.info.aspect);
+		}
+	}
+
+	for (uint32_t i = 0; i < transientResources.size(); ++i)
+	{
+		Resource& resource{resources[transientResources[i]]};
+		resource.transientIndex = i;
+		resource.image = *transientImages[i].image;
+		resource.imageView = *transientImages[i].imageView;
+
+		stats.unaliasedMemorySize += transientImages[i].memorySize;
+		stats.transientMemorySize = std::max(stats.transientMemorySize, transientImages[i].memoryOffset + transientImages[i].memorySize);
+	}
+	stats.transientImageCount = static_cast<uint32_t>(transientResources.size());
+}
+
+void RenderGraph::computeBarriers()
+{
+	std::pmr::vector<ResourceState> states(resources.size(), app.frameAllocator.getResource());
+	for (size_t i = 0; i < resources.size(); ++i)
+	{
+		const Resource& resource{resources[i]};
+		if (resource.imported)
+		{
+			// Nothing is known about earlier uses, so the first access waits for all earlier commands
+			states[i] = ResourceState{resource.initialLayout, vk::PipelineStageFlagBits2::eAllCommands, {}, {}, {}};
+			continue;
+		}
+		if (!resource.transientIndex)
+		{
+			continue;
+		}
+
+		// The memory was last used by an image aliasing it, either earlier in this frame or in the previous frame
+		ResourceState& state{states[i]};
+		state.layout = vk::ImageLayout::eUndefined;
+		const TransientImage& transientImage{transientImages[*resource.transientIndex]};
+		for (const Resource& other : resources)
+		{
+			if (!other.transientIndex)
+			{
+				continue;
+			}
+			const TransientImage& otherImage{transientImages[*other.transientIndex]};
+			if (transientImage.memoryOffset < otherImage.memoryOffset + otherImage.memorySize && otherImage.memoryOffset < transientImage.memoryOffset + transientImage.memorySize)
+			{
+				state.writeStages |= other.usedStages;
+				state.writeAccess |= other.writtenAccess;
+			}
+		}
+	}
+
+	struct MergedAccess
+	{
+		uint32_t resource;
+		vk::PipelineStageFlags2 stages;
+		vk::AccessFlags2 access;
+		vk::ImageLayout layout;
+		bool isWrite;
+	};
+
+	for (RenderGraphPass& pass : passes)
+	{
+		pass.imageBarriers.clear();
+		pass.bufferBarriers.clear();
+		if (pass.culled)
+		{
+			continue;
+		}
+
+		// A pass may access a resource several times, e.g. a buffer cleared by a transfer and then written by a compute shader
+		std::pmr::vector<MergedAccess> mergedAccesses{app.frameAllocator.makeVector<MergedAccess>()};
+		for (const RenderGraphPass::Access& access : pass.accesses)
+		{
+			const RenderGraphUsageInfo usageInfo{getUsageInfo(access.usage)};
+			const auto merged{std::ranges::find(mergedAccesses, access.resource.index, &MergedAccess::resource)};
+			if (merged == mergedAccesses.end())
+			{
+				mergedAccesses.emplace_back(access.resource.index, usageInfo.stages, usageInfo.access, usageInfo.layout, access.isWrite);
+				continue;
+			}
+
+			if (resources[access.resource.index].isImage && merged->layout != usageInfo.layout)
+			{
+				throw std::runtime_error("Render graph pass " + pass.name + " accesses " + resources[access.resource.index].name + " in conflicting layouts");
+			}
+			merged->stages |= usageInfo.stages;
+			merged->access |= usageInfo.access;
+			merged->isWrite |= access.isWrite;
+		}
+
+		for (const MergedAccess& access : mergedAccesses)
+		{
+			addBarrier(pass, resources[access.resource], states[access.resource], access.stages, access.access, access.layout, access.isWrite);
+		}
+
+		stats.imageBarrierCount += static_cast<uint32_t>(pass.imageBarriers.size());
+		stats.bufferBarrierCount += static_cast<uint32_t>(pass.bufferBarriers.size());
+	}
+
+	for (size_t i = 0; i < resources.size(); ++i)
+	{
+		const Resource& resource{resources[i]};
+		const ResourceState& state{states[i]};
+		if (!resource.imported || !resource.isImage || resource.finalLayout == vk::ImageLayout::eUndefined || resource.finalLayout == state.layout)
+		{
+			continue;
+		}
+
+		finalBarriers.emplace_back(state.writeStages | state.readStages, state.writeAccess, vk::PipelineStageFlagBits2::eNone, vk::AccessFlagBits2::eNone, state.layout,
+		                           resource.finalLayout, vk::QueueFamilyIgnored, vk::QueueFamilyIgnored, resource.image, getSubresourceRange(resource));
+	}
+	stats.imageBarrierCount += static_cast<uint32_t>(finalBarriers.size());
+}
+
+bool RenderGraph::matchesTransientImages(const std::span<const uint32_t> transientResources) const
+{
+	if (transientResources.size() != transientImages.size())
+	{
+		return false;
+	}
+
+	for (size_t i = 0; i < transientResources.size(); ++i)
+	{
+		const Resource& resource{resources[transientResources[i]]};
+		const TransientImage& transientImage{transientImages[i]};
+		if (resource.info != transientImage.info || resource.usage != transientImage.usage || *resource.firstPass != transientImage.firstPass ||
+			resource.lastPass != transientImage.lastPass)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void RenderGraph::addBarrier(RenderGraphPass& pass, const Resource& resource, ResourceState& state, const vk::PipelineStageFlags2 stages, const vk::AccessFlags2 access,
+                             const vk::ImageLayout layout, const bool isWrite)
+{
+	const bool layoutChanges{resource.isImage && layout != state.layout};
+
+	if (isWrite || layoutChanges)
+	{
+		// Writes and layout transitions have to wait for all earlier accesses
+		const vk::PipelineStageFlags2 sourceStages{state.writeStages | state.readStages};
+		if (sourceStages || layoutChanges)
+		{
+			if (resource.isImage)
+			{
+				pass.imageBarriers.emplace_back(sourceStages, state.writeAccess, stages, access, state.layout, layout, vk::QueueFamilyIgnored, vk::QueueFamilyIgnored,
+				                                resource.image, getSubresourceRange(resource));
+			}
+			else
+			{
+				pass.bufferBarriers.emplace_back(sourceStages, state.writeAccess, stages, access, vk::QueueFamilyIgnored, vk::QueueFamilyIgnored, resource.buffer, 0, vk::WholeSize);
+			}
+		}
+
+		if (resource.isImage)
+		{
+			state.layout = layout;
+		}
+		// A layout transition counts as a write that is already visible to the stages of this access
+		state.writeStages = stages;
+		state.writeAccess = isWrite ? access & writeAccessMask : vk::AccessFlags2{};
+		state.readStages = isWrite ? vk::PipelineStageFlags2{} : stages;
+		state.visibleStages = isWrite ? vk::PipelineStageFlags2{} : stages;
+		return;
+	}
+
+	// Reads after reads only need a barrier if the last write is not yet visible to their stages
+	if (state.writeStages && (stages & ~state.visibleStages))
+	{
+		if (resource.isImage)
+		{
+			pass.imageBarriers.emplace_back(state.writeStages, state.writeAccess, stages, access, layout, layout, vk::QueueFamilyIgnored, vk::QueueFamilyIgnored, resource.image,
+			                                getSubresourceRange(resource));
+		}
+		else
+		{
+			pass.bufferBarriers.emplace_back(state.writeStages, state.writeAccess, stages, access, vk::QueueFamilyIgnored, vk::QueueFamilyIgnored, resource.buffer, 0, vk::WholeSize);
+		}
+		state.visibleStages |= stages;
+	}
+	state.readStages |= stages;
+}
+
+vk::ImageSubresourceRange RenderGraph::getSubresourceRange(const Resource& resource)
+{
+	// Layout transitions of depth stencil images have to include both aspects
+	vk::ImageAspectFlags aspect{resource.info.aspect};
+	if ((aspect & vk::ImageAspectFlagBits::eDepth) && Image::hasStencilComponent(resource.info.format))
+	{
+		aspect |= vk::ImageAspectFlagBits::eStencil;
+	}
+	return {aspect, 0, vk::RemainingMipLevels, 0, vk::RemainingArrayLayers};
+}
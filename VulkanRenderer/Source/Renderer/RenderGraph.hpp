@@ -0,0 +1,221 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "DeviceMemoryAllocator.hpp"
+#include "VulkanBackend.hpp"
+
+class GpuProfiler;
+class Renderer;
+
+// How a pass accesses a resource. Determines the pipeline stages, access mask and image layout of the access
+enum class RenderGraphUsage : uint8_t
+{
+	ColorAttachment,
+	DepthAttachment,
+	FragmentShaderRead,
+	ComputeShaderRead,
+	ComputeShaderWrite,
+	IndirectRead,
+	TransferRead,
+	TransferWrite
+};
+
+// Index of an image or buffer in the graph of the current frame
+struct RenderGraphResource
+{
+	uint32_t index;
+};
+
+// Description of an image that only lives during the frame. Its usage flags are collected from the passes
+struct RenderGraphImageInfo
+{
+	vk::Format format;
+	vk::Extent2D extent;
+	vk::ImageAspectFlags aspect;
+
+	bool operator==(const RenderGraphImageInfo& other) const = default;
+};
+
+struct RenderGraphAttachment
+{
+	RenderGraphResource image;
+	vk::AttachmentLoadOp loadOp;
+	vk::AttachmentStoreOp storeOp;
+	vk::ClearValue clearValue;
+};
+
+struct RenderGraphContext
+{
+	const vk::raii::CommandBuffer& commandBuffer;
+	// Only set for passes that record their rendering into secondary command buffers. Describes the attachments of the pass
+	const vk::CommandBufferInheritanceInfo* inheritanceInfo;
+};
+
+struct RenderGraphStats
+{
+	uint32_t passCount{0};
+	uint32_t culledPassCount{0};
+	uint32_t imageBarrierCount{0};
+	uint32_t bufferBarrierCount{0};
+	uint32_t transientImageCount{0};
+	// Memory of the transient images with and without aliasing
+	vk::DeviceSize transientMemorySize{0};
+	vk::DeviceSize unaliasedMemorySize{0};
+
+	void drawImGui() const;
+};
+
+// Pass of a render graph. Declares the resources it accesses and records its commands once the graph is executed
+// Passes with attachments are recorded inside a dynamic rendering instance
+class RenderGraphPass
+{
+public:
+	RenderGraphPass& read(RenderGraphResource resource, RenderGraphUsage usage);
+	RenderGraphPass& write(RenderGraphResource resource, RenderGraphUsage usage);
+
+	RenderGraphPass& addColorAttachment(RenderGraphResource image, vk::AttachmentLoadOp loadOp, const vk::ClearValue& clearValue = {},
+	                                    vk::AttachmentStoreOp storeOp = vk::AttachmentStoreOp::eStore);
+	RenderGraphPass& setDepthAttachment(RenderGraphResource image, vk::AttachmentLoadOp loadOp, const vk::ClearValue& clearValue = {},
+	                                    vk::AttachmentStoreOp storeOp = vk::AttachmentStoreOp::eDontCare);
+
+	// The rendering of the pass is recorded into secondary command buffers, which are executed by the pass
+	RenderGraphPass& useSecondaryCommandBuffers();
+
+	// Keeps the pass even if none of its results are read, e.g. for readbacks to the host
+	RenderGraphPass& markSideEffect();
+
+	RenderGraphPass& setExecute(std::function<void(const RenderGraphContext&)> execute);
+
+private:
+	friend class RenderGraph;
+
+	struct Access
+	{
+		RenderGraphResource resource;
+		RenderGraphUsage usage;
+		bool isRead;
+		bool isWrite;
+	};
+
+	explicit RenderGraphPass(std::string name);
+
+	std::string name;
+	std::vector<Access> accesses;
+	std::vector<RenderGraphAttachment> colorAttachments;
+	std::optional<RenderGraphAttachment> depthAttachment;
+	bool secondaryCommandBuffers{false};
+	bool sideEffect{false};
+	std::function<void(const RenderGraphContext&)> execute;
+
+	// Filled by the compilation
+	bool culled{false};
+	std::vector<vk::ImageMemoryBarrier2> imageBarriers;
+	std::vector<vk::BufferMemoryBarrier2> bufferBarriers;
+};
+
+// Frame graph that is declared anew every frame
+// Passes declare the images and buffers they access. Compiling the graph culls passes whose results are never used,
+// places transient images with disjoint lifetimes in shared memory and computes the barriers between the passes
+// Imported resources are the outputs of the graph, so every pass contributing to them is kept
+class RenderGraph
+{
+public:
+	explicit RenderGraph(const Renderer& app);
+
+	// Starts the declaration of a new frame. The transient images are kept as long as the next frame declares them the same way
+	void reset();
+
+	// An image owned outside of the graph. It is transitioned to finalLayout after the last pass, unless that is eUndefined
+	RenderGraphResource importImage(const std::string& name, vk::Image image, vk::ImageView imageView, const RenderGraphImageInfo& info, vk::ImageLayout initialLayout,
+	                                vk::ImageLayout finalLayout);
+	RenderGraphResource importBuffer(const std::string& name, vk::Buffer buffer);
+	RenderGraphResource createImage(const std::string& name, const RenderGraphImageInfo& info);
+
+	// The reference stays valid until the next reset
+	RenderGraphPass& addPass(const std::string& name);
+
+	void compile();
+	// Every pass, including its barriers, is measured as a scope of the profiler if one is given
+	void execute(const vk::raii::CommandBuffer& commandBuffer, GpuProfiler* profiler = nullptr) const;
+
+	// Stats of the last compilation
+	RenderGraphStats stats{};
+
+private:
+	struct Resource
+	{
+		std::string name;
+		bool imported;
+		bool isImage;
+		vk::Image image;
+		vk::ImageView imageView;
+		vk::Buffer buffer;
+		RenderGraphImageInfo info;
+		vk::ImageLayout initialLayout;
+		vk::ImageLayout finalLayout;
+
+		// Filled by the compilation
+		vk::ImageUsageFlags usage;
+		vk::PipelineStageFlags2 usedStages;
+		vk::AccessFlags2 writtenAccess;
+		std::optional<uint32_t> firstPass;
+		uint32_t lastPass{0};
+		std::optional<uint32_t> transientIndex;
+	};
+
+	// Image backing a transient resource. Reused by later frames that declare the same transients
+	struct TransientImage
+	{
+		RenderGraphImageInfo info;
+		vk::ImageUsageFlags usage;
+		uint32_t firstPass;
+		uint32_t lastPass;
+		vk::raii::Image image{nullptr};
+		vk::raii::ImageView imageView{nullptr};
+		vk::DeviceSize memoryOffset{0};
+		vk::DeviceSize memorySize{0};
+	};
+
+	// Synchronization state of a resource while walking the passes
+	struct ResourceState
+	{
+		vk::ImageLayout layout;
+		vk::PipelineStageFlags2 writeStages;
+		vk::AccessFlags2 writeAccess;
+		vk::PipelineStageFlags2 readStages;
+		// Stages the last write has already been made visible to
+		vk::PipelineStageFlags2 visibleStages;
+	};
+
+	const Renderer& app;
+
+	std::vector<Resource> resources;
+	std::deque<RenderGraphPass> passes;
+
+	std::vector<TransientImage> transientImages;
+	DeviceAllocation transientMemory;
+
+	std::vector<vk::ImageMemoryBarrier2> finalBarriers;
+
+	void executePass(const vk::raii::CommandBuffer& commandBuffer, const RenderGraphPass& pass) const;
+
+	void cullPasses();
+	void computeLifetimes();
+	void allocateTransientImages();
+	void computeBarriers();
+
+	// Whether the transient images of the current declaration match the existing ones
+	[[nodiscard]] bool matchesTransientImages(std::span<const uint32_t> transientResources) const;
+
+	static void addBarrier(RenderGraphPass& pass, const Resource& resource, ResourceState& state, vk::PipelineStageFlags2 stages, vk::AccessFlags2 access,
+	                       vk::ImageLayout layout, bool isWrite);
+
+	static vk::ImageSubresourceRange getSubresourceRange(const Resource& resource);
+};
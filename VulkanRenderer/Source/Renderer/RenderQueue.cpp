@@ -0,0 +1,245 @@
+#include "RenderQueue.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <imgui.h>
+
+#include "Asset/Material.hpp"
+#include "Asset/MaterialInstance.hpp"
+#include "Asset/Mesh.hpp"
+#include "Renderer/InstanceBuffer.hpp"
+#include "Scene/Model.hpp"
+#include "Scene/Core/BoundingBox.hpp"
+#include "Scene/Scene.hpp"
+
+uint32_t RenderQueueStats::getIssuedBinds() const
+{
+	return pipelineBinds + descriptorSetBinds + vertexBufferBinds + indexBufferBinds;
+}
+
+RenderQueueStats& RenderQueueStats::operator+=(const RenderQueueStats& other)
+{
+	drawCount += other.drawCount;
+	instanceCount += other.instanceCount;
+	pipelineBinds += other.pipelineBinds;
+	descriptorSetBinds += other.descriptorSetBinds;
+	vertexBufferBinds += other.vertexBufferBinds;
+	indexBufferBinds += other.indexBufferBinds;
+	return *this;
+}
+
+uint32_t RenderQueueStats::getSkippedBinds() const
+{
+	// Without sorting and instancing, every model binds pipeline, descriptor set, vertex buffer and index buffer
+	return instanceCount * 4 - getIssuedBinds();
+}
+
+void RenderQueueStats::drawImGui() const
+{
+	ImGui::SeparatorText("Render queue");
+	ImGui::Text("Draws: %u", drawCount);
+	ImGui::Text("Instances: %u", instanceCount);
+	ImGui::Text("Pipeline binds: %u", pipelineBinds);
+	ImGui::Text("Descriptor set binds: %u", descriptorSetBinds);
+	ImGui::Text("Vertex buffer binds: %u", vertexBufferBinds);
+	ImGui::Text("Index buffer binds: %u", indexBufferBinds);
+	ImGui::Text("Redundant binds skipped: %u", getSkippedBinds());
+}
+
+void RenderQueue::build(const Scene& scene, const glm::vec3& viewPosition, const std::optional<std::array<glm::vec4, 6>>& frustumPlanes)
+{
+	items.clear();
+	materialIds.clear();
+	materialInstanceIds.clear();
+	meshIds.clear();
+
+	items.reserve(scene.models.size());
+
+	culler.clear();
+	culler.stats = {};
+	if (frustumPlanes)
+	{
+		for (const Model& model : scene.models)
+		{
+			culler.addBox(model.getMesh()->boundingBox.transformed(model.getTransform().getMatrix()));
+		}
+		culler.cull(*frustumPlanes);
+	}
+
+	MaterialInstance* fallback{fallbackMaterial ? &**fallbackMaterial : nullptr};
+	for (size_t modelIndex = 0; modelIndex < scene.models.size(); ++modelIndex)
+	{
+		if (frustumPlanes && !culler.isVisible(modelIndex))
+		{
+			continue;
+		}
+
+		const Model& model{scene.models[modelIndex]};
+
+		// Resolve the handles once, every dereference is a lookup in the asset manager
+		MaterialInstance* materialInstance{&*model.getMaterial()};
+		if (!materialInstance->prepare())
+		{
+			if (!fallback)
+			{
+				continue;
+			}
+			materialInstance = fallback;
+		}
+		const Material* material{&*materialInstance->parentMaterial};
+		const Mesh* mesh{&*model.getMesh()};
+
+		const uint32_t materialId{getDenseId(materialIds, material, materialBits)};
+		const uint32_t materialInstanceId{getDenseId(materialInstanceIds, materialInstance, materialInstanceBits)};
+		const uint32_t meshId{getDenseId(meshIds, mesh, meshBits)};
+
+		const float viewDistance{glm::length(model.getTransform().translation - viewPosition)};
+
+		items.emplace_back(makeSortKey(materialId, materialInstanceId, meshId, viewDistance), &model, material, materialInstance, mesh);
+	}
+
+	sortItems(items, scratch);
+	buildDraws();
+}
+
+void RenderQueue::writeInstances(const std::span<InstanceData> instances) const
+{
+	for (size_t i = 0; i < items.size(); ++i)
+	{
+		const RenderItem& item{items[i]};
+		const glm::mat4 modelTransform{item.model->transform.getMatrix()};
+		instances[i] = InstanceData{
+			modelTransform, inverse(transpose(modelTransform)), item.mesh->boundingSphere, item.mesh->indexCount, 0, {}
+		};
+	}
+}
+
+const std::vector<RenderItem>& RenderQueue::getItems() const
+{
+	return items;
+}
+
+const std::vector<RenderDraw>& RenderQueue::getDraws() const
+{
+	return draws;
+}
+
+const CullingStats& RenderQueue::getCullingStats() const
+{
+	return culler.stats;
+}
+
+uint64_t RenderQueue::makeSortKey(const uint32_t materialId, const uint32_t materialInstanceId, const uint32_t meshId, const float viewDistance)
+{
+	return static_cast<uint64_t>(materialId) << materialShift
+		| static_cast<uint64_t>(materialInstanceId) << materialInstanceShift
+		| static_cast<uint64_t>(meshId) << meshShift
+		| static_cast<uint64_t>(quantizeDepth(viewDistance)) << depthShift;
+}
+
+uint32_t RenderQueue::quantizeDepth(const float viewDistance)
+{
+	// The bit pattern of a non-negative float grows monotonically with its value,
+	// so the upper bits are a logarithmic quantization that is precise close to the camera
+	const float clampedDistance{std::max(viewDistance, 0.f)};
+	constexpr uint32_t droppedBits{31 - depthBits};
+	return std::bit_cast<uint32_t>(clampedDistance) >> droppedBits;
+}
+
+void RenderQueue::sortItems(std::vector<RenderItem>& items, std::vector<RenderItem>& scratch)
+{
+	scratch.resize(items.size());
+
+	std::vector<RenderItem>* source{&items};
+	std::vector<RenderItem>* destination{&scratch};
+
+	for (uint32_t shift = 0; shift < 64; shift += 8)
+	{
+		std::array<size_t, 256> offsets{};
+		for (const RenderItem& item : *source)
+		{
+			++offsets[(item.sortKey >> shift) & 0xFF];
+		}
+
+		// All keys share this byte, the pass would not change the order
+		if (std::ranges::find(offsets, source->size()) != offsets.end())
+		{
+			continue;
+		}
+
+		size_t offset{0};
+		for (size_t& bucketOffset : offsets)
+		{
+			const size_t count{bucketOffset};
+			bucketOffset = offset;
+			offset += count;
+		}
+
+		for (const RenderItem& item : *source)
+		{
+			(*destination)[offsets[(item.sortKey >> shift) & 0xFF]++] = item;
+		}
+
+		std::swap(source, destination);
+	}
+
+	if (source != &items)
+	{
+		items.swap(scratch);
+	}
+}
+
+uint32_t RenderQueue::getDenseId(std::unordered_map<const void*, uint32_t>& ids, const void* object, const uint32_t bits)
+{
+	const auto [it, inserted]{ids.try_emplace(object, static_cast<uint32_t>(ids.size()))};
+	if (inserted && it->second >= (1u << bits))
+	{
+		throw std::runtime_error("Too many distinct objects for the render queue sort key");
+	}
+	return it->second;
+}
+
+void RenderQueue::buildDraws()
+{
+	draws.clear();
+
+	// Items are sorted by material instance and mesh before depth, so all instances of a draw are adjacent
+	for (uint32_t i = 0; i < items.size(); ++i)
+	{
+		if (draws.empty() || items[i].materialInstance != items[draws.back().firstItem].materialInstance || items[i].mesh != items[draws.back().firstItem].mesh)
+		{
+			draws.emplace_back(i, 0);
+		}
+		++draws.back().instanceCount;
+	}
+}
+
+void RenderQueue::recordDraw(const vk::raii::CommandBuffer& commandBuffer, const uint32_t frameIndex, const RenderItem& item, const RenderItem* previousItem,
+                             const uint32_t instanceCount, RenderQueueStats& recordStats) const
+{
+	// Keys are only used for sorting. Binds compare the objects themselves
+	if (!previousItem || previousItem->material != item.material)
+	{
+		commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, item.material->pipeline);
+		++recordStats.pipelineBinds;
+	}
+
+	if (!previousItem || previousItem->materialInstance != item.materialInstance)
+	{
+		item.materialInstance->shaderObject->bind(commandBuffer, vk::PipelineBindPoint::eGraphics, item.material->pipelineLayout, materialSetIndex, frameIndex);
+		++recordStats.descriptorSetBinds;
+	}
+
+	if (!previousItem || previousItem->mesh != item.mesh)
+	{
+		commandBuffer.bindVertexBuffers(0, *item.mesh->getVertexBuffer().vkBuffer, {0});
+		commandBuffer.bindIndexBuffer(item.mesh->getIndexBuffer().vkBuffer, 0, vk::IndexType::eUint32);
+		++recordStats.vertexBufferBinds;
+		++recordStats.indexBufferBinds;
+	}
+
+	commandBuffer.drawIndexed(item.mesh->indexCount, instanceCount, 0, 0, 0);
+	++recordStats.drawCount;
+	recordStats.instanceCount += instanceCount;
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "VulkanBackend.hpp"
+#include "Asset/MaterialInstance.hpp"
+#include "AssetSystem/AssetHandle.hpp"
+#include "Renderer/FrustumCuller.hpp"
+
+class Material;
+class Mesh;
+class Model;
+class Scene;
+struct InstanceData;
+
+// Counts of the binds issued while recording the queue. Skipped binds are the ones an unsorted, non-instanced per-model loop would have issued
+struct RenderQueueStats
+{
+	uint32_t drawCount{0};
+	uint32_t instanceCount{0};
+	uint32_t pipelineBinds{0};
+	uint32_t descriptorSetBinds{0};
+	uint32_t vertexBufferBinds{0};
+	uint32_t indexBufferBinds{0};
+
+	[[nodiscard]] uint32_t getIssuedBinds() const;
+	[[nodiscard]] uint32_t getSkippedBinds() const;
+
+	RenderQueueStats& operator+=(const RenderQueueStats& other);
+
+	void drawImGui() const;
+};
+
+struct RenderItem
+{
+	uint64_t sortKey;
+	const Model* model;
+	const Material* material;
+	MaterialInstance* materialInstance;
+	const Mesh* mesh;
+};
+
+// Items sharing material instance and mesh, drawn as instances of a single draw
+struct RenderDraw
+{
+	uint32_t firstItem;
+	uint32_t instanceCount;
+};
+
+// Collects the models of a scene into draws sorted by pipeline, material instance, mesh and front-to-back depth
+// Consecutive draws sharing state then only need the binds for the fields that changed
+// Consecutive items sharing material instance and mesh are drawn as instances of a single draw
+class RenderQueue
+{
+public:
+	// Sort key fields from least to most significant bit. Items are ordered by material first and by depth last
+	static constexpr uint32_t depthBits{20};
+	static constexpr uint32_t meshBits{16};
+	static constexpr uint32_t materialInstanceBits{16};
+	static constexpr uint32_t materialBits{12};
+
+	static_assert(depthBits + meshBits + materialInstanceBits + materialBits == 64);
+
+	static constexpr uint32_t depthShift{0};
+	static constexpr uint32_t meshShift{depthShift + depthBits};
+	static constexpr uint32_t materialInstanceShift{meshShift + meshBits};
+	static constexpr uint32_t materialShift{materialInstanceShift + materialInstanceBits};
+
+	// Models whose bounding box lies outside of the frustum planes are left out. Without planes every model is queued
+	void build(const Scene& scene, const glm::vec3& viewPosition, const std::optional<std::array<glm::vec4, 6>>& frustumPlanes);
+
+	// Writes the per-instance data of all items in queue order. The bucket fields used by GPU-driven rendering are left empty
+	void writeInstances(std::span<InstanceData> instances) const;
+
+	// Binds the state of every draw that differs from the previous one and issues it. The first draw binds all of its state
+	// writeDrawData(item, firstInstance) is called before the binds of every draw to write per-draw shader parameters. firstInstance is the index of item in the queue
+	// Does not modify the queue, so disjoint ranges of draws can be recorded on multiple threads
+	template <typename WriteDrawData>
+	RenderQueueStats record(const vk::raii::CommandBuffer& commandBuffer, uint32_t frameIndex, std::span<const RenderDraw> drawRange, WriteDrawData&& writeDrawData) const;
+
+	[[nodiscard]] const std::vector<RenderItem>& getItems() const;
+	[[nodiscard]] const std::vector<RenderDraw>& getDraws() const;
+	[[nodiscard]] const CullingStats& getCullingStats() const;
+
+	// Stats of the last recorded frame
+	RenderQueueStats stats{};
+
+	// Drawn instead of material instances whose material is still being compiled for the first time. Without one, their models are left out
+	std::optional<AssetHandle<MaterialInstance>> fallbackMaterial;
+
+	static uint64_t makeSortKey(uint32_t materialId, uint32_t materialInstanceId, uint32_t meshId, float viewDistance);
+	static uint32_t quantizeDepth(float viewDistance);
+
+	// Stable LSD radix sort on the sort keys. Passes where all keys share the same byte are skipped
+	static void sortItems(std::vector<RenderItem>& items, std::vector<RenderItem>& scratch);
+
+private:
+	std::vector<RenderItem> items;
+	std::vector<RenderItem> scratch;
+	std::vector<RenderDraw> draws;
+	FrustumCuller culler;
+
+	// Dense per-frame ids, so that the key fields stay small regardless of how many assets were ever created
+	std::unordered_map<const void*, uint32_t> materialIds;
+	std::unordered_map<const void*, uint32_t> materialInstanceIds;
+	std::unordered_map<const void*, uint32_t> meshIds;
+
+	static uint32_t getDenseId(std::unordered_map<const void*, uint32_t>& ids, const void* object, uint32_t bits);
+
+	// Groups the sorted items into draws
+	void buildDraws();
+
+	void recordDraw(const vk::raii::CommandBuffer& commandBuffer, uint32_t frameIndex, const RenderItem& item, const RenderItem* previousItem, uint32_t instanceCount,
+	                RenderQueueStats& recordStats) const;
+};
+
+template <typename WriteDrawData>
+RenderQueueStats RenderQueue::record(const vk::raii::CommandBuffer& commandBuffer, const uint32_t frameIndex, const std::span<const RenderDraw> drawRange,
+                                     WriteDrawData&& writeDrawData) const
+{
+	RenderQueueStats recordStats{};
+
+	const RenderItem* previousItem{nullptr};
+	for (const RenderDraw& draw : drawRange)
+	{
+		const RenderItem& item{items[draw.firstItem]};
+
+		writeDrawData(item, draw.firstItem);
+		recordDraw(commandBuffer, frameIndex, item, previousItem, draw.instanceCount, recordStats);
+
+		previousItem = &item;
+	}
+	return recordStats;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <filesystem>
+#include <optional>
+
+#include "VulkanBackend.hpp"
+
+struct RendererSettings
+{
+	// Render into offscreen targets instead of a window. No window, surface, swapchain or ImGui is created
+	bool headless{false};
+	// Size of the window or of the offscreen targets
+	vk::Extent2D extent{1600, 1200};
+	// Cull and draw the scene with a compute pass and indirect draws instead of one draw call per model. Requires drawIndirectCount
+	bool gpuDriven{false};
+	// Threads recording the draws of the render queue into secondary command buffers. 0 uses one per hardware thread
+	uint32_t recordingThreadCount{0};
+	// Threads compiling materials, each with its own Slang session. 0 uses one per hardware thread
+	uint32_t compileThreadCount{0};
+	// Writes the GPU time of every frame and render graph pass to this CSV file
+	std::optional<std::filesystem::path> profilerCsvPath{};
+	// Writes a JSON report of the memory usage by owner to this file at the end of a headless run
+	std::optional<std::filesystem::path> memoryReportPath{};
+	// Device memory that mesh buffers and textures may keep resident. The least recently drawn ones are evicted above it. Unset uses half of the largest device-local heap
+	std::optional<vk::DeviceSize> residencyBudget{};
+	// Compiled material SPIR-V is cached in this directory. Processes may share it. Unset compiles every material from source
+	std::optional<std::filesystem::path> shaderCachePath{"ShaderCache"};
+	// Pipeline cache loaded at startup and saved on shutdown. Ignored if another device or driver version wrote it. Unset keeps it in memory only
+	std::optional<std::filesystem::path> pipelineCachePath{"ShaderCache/pipelines.bin"};
+};
@@ -0,0 +1,139 @@
+#include "ResidencyBlob.hpp"
+
+#include <atomic>
+#include <charconv>
+#include <cstdint>
+#include <format>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+
+ResidencyBlob::ResidencyBlob(const std::initializer_list<std::span<const std::byte>> parts)
+{
+	for (const std::span<const std::byte> part : parts)
+	{
+		size += part.size();
+	}
+
+	// Kept in host memory until the first eviction, so data that stays resident never touches the disk
+	hostCopy.reserve(size);
+	for (const std::span<const std::byte> part : parts)
+	{
+		hostCopy.insert(hostCopy.end(), part.begin(), part.end());
+	}
+}
+
+ResidencyBlob::~ResidencyBlob()
+{
+	if (!path.empty())
+	{
+		std::error_code error;
+		std::filesystem::remove(path, error);
+	}
+}
+
+void ResidencyBlob::spill()
+{
+	if (!path.empty() || spillFailed)
+	{
+		return;
+	}
+
+	std::error_code error;
+	std::filesystem::path newPath{createPath()};
+	if (!newPath.empty())
+	{
+		std::filesystem::create_directories(newPath.parent_path(), error);
+		{
+			std::ofstream file{newPath, std::ios::binary};
+			file.write(reinterpret_cast<const char*>(hostCopy.data()), static_cast<std::streamsize>(hostCopy.size()));
+			if (file.flush())
+			{
+				path = std::move(newPath);
+				hostCopy = {};
+				return;
+			}
+		}
+		std::filesystem::remove(newPath, error);
+	}
+
+	// Do not retry on every eviction
+	spillFailed = true;
+}
+
+std::vector<std::byte> ResidencyBlob::read() const
+{
+	if (path.empty())
+	{
+		return hostCopy;
+	}
+
+	std::vector<std::byte> data(size);
+	std::ifstream file{path, std::ios::binary};
+	if (!file.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(size)))
+	{
+		throw std::runtime_error("Failed to read residency blob " + path.string());
+	}
+	return data;
+}
+
+size_t ResidencyBlob::getSize() const
+{
+	return size;
+}
+
+void ResidencyBlob::removeStaleFiles()
+{
+	const std::filesystem::path directory{getDirectory()};
+	std::error_code error;
+	if (directory.empty() || !std::filesystem::is_directory(directory, error))
+	{
+		return;
+	}
+
+	for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator{directory, error})
+	{
+		// Files are named after the process that wrote them, which removes them again unless it crashed
+		const std::string name{entry.path().filename().string()};
+		const size_t separator{name.find('-')};
+		if (separator == std::string::npos)
+		{
+			continue;
+		}
+		pid_t processId{0};
+		const auto [end, result]{std::from_chars(name.data(), name.data() + separator, processId)};
+		if (result != std::errc{} || end != name.data() + separator)
+		{
+			continue;
+		}
+		if (processId != getpid() && !std::filesystem::exists(std::format("/proc/{}", processId), error))
+		{
+			std::filesystem::remove(entry.path(), error);
+		}
+	}
+}
+
+std::filesystem::path ResidencyBlob::getDirectory()
+{
+	std::error_code error;
+	const std::filesystem::path directory{std::filesystem::temp_directory_path(error)};
+	if (error)
+	{
+		return {};
+	}
+	return directory / "VulkanRendererResidency";
+}
+
+std::filesystem::path ResidencyBlob::createPath()
+{
+	// Unique per process and blob, so several renderers may share the directory
+	static std::atomic<uint64_t> nextIndex{0};
+
+	const std::filesystem::path directory{getDirectory()};
+	if (directory.empty())
+	{
+		return {};
+	}
+	return directory / std::format("{}-{}.bin", getpid(), nextIndex++);
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <initializer_list>
+#include <span>
+#include <vector>
+
+// Copy of the bytes that evicted device data is uploaded from again. Moved to a temporary file on the first eviction, so evicted data holds no host memory either
+// Reading it back is far cheaper than importing the source asset again. Stays in host memory if the file cannot be written
+class ResidencyBlob
+{
+public:
+	// The parts are stored back to back
+	explicit ResidencyBlob(std::initializer_list<std::span<const std::byte>> parts);
+	~ResidencyBlob();
+
+	ResidencyBlob(const ResidencyBlob&) = delete;
+	ResidencyBlob& operator=(const ResidencyBlob&) = delete;
+
+	// Moves the bytes to the temporary file, unless they are already there. Called when the device data is evicted
+	void spill();
+
+	[[nodiscard]] std::vector<std::byte> read() const;
+	[[nodiscard]] size_t getSize() const;
+
+	// Removes the files left behind by renderer processes that are no longer running
+	static void removeStaleFiles();
+
+private:
+	size_t size{0};
+	std::filesystem::path path; // Empty until spilled
+	std::vector<std::byte> hostCopy;
+	bool spillFailed{false};
+
+	// Empty if there is no temporary directory
+	static std::filesystem::path getDirectory();
+	static std::filesystem::path createPath();
+};
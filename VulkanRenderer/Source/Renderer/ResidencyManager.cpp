@@ -0,0 +1,163 @@
+#include "ResidencyManager.hpp"
+
+#include <algorithm>
+#include <imgui.h>
+
+void ResidencyStats::drawImGui() const
+{
+	constexpr float mebibyte{1024.f * 1024.f};
+
+	ImGui::SeparatorText("Residency");
+	ImGui::Text("Resident: %u, %.2f / %.2f MiB", residentCount, static_cast<float>(residentBytes) / mebibyte, static_cast<float>(budget) / mebibyte);
+	ImGui::Text("Evicted: %u", evictedCount);
+	ImGui::Text("Evictions: %u, restores: %u", evictions, restores);
+}
+
+EvictableResource::EvictableResource(ResidencyManager& manager, const vk::DeviceSize expectedSize)
+	: manager(manager), index(0), lastUsedFrame(manager.frameNumber), size(expectedSize)
+{
+	manager.add(*this);
+}
+
+EvictableResource::~EvictableResource()
+{
+	manager.remove(*this);
+}
+
+void EvictableResource::markUsed()
+{
+	lastUsedFrame = manager.frameNumber;
+	if (!resident)
+	{
+		manager.restore(*this);
+	}
+}
+
+bool EvictableResource::isResident() const
+{
+	return resident;
+}
+
+ResidencyManager::ResidencyManager(const uint32_t framesInFlight, const vk::DeviceSize budget)
+	: framesInFlight(framesInFlight), budget(budget)
+{
+}
+
+void ResidencyManager::beginFrame()
+{
+	++frameNumber;
+	evictFor(0);
+}
+
+ResidencyStats ResidencyManager::getStats() const
+{
+	ResidencyStats stats{};
+	stats.residentCount = static_cast<uint32_t>(std::ranges::count_if(resources, &EvictableResource::isResident));
+	stats.evictedCount = static_cast<uint32_t>(resources.size()) - stats.residentCount;
+	stats.residentBytes = residentBytes;
+	stats.budget = budget;
+	stats.evictions = evictions;
+	stats.restores = restores;
+	return stats;
+}
+
+void ResidencyManager::add(EvictableResource& resource)
+{
+	resource.index = resources.size();
+	resources.push_back(&resource);
+}
+
+void ResidencyManager::remove(EvictableResource& resource)
+{
+	if (resource.resident)
+	{
+		residentBytes -= resource.size;
+	}
+
+	EvictableResource* last{resources.back()};
+	resources[resource.index] = last;
+	last->index = resource.index;
+	resources.pop_back();
+}
+
+void ResidencyManager::restore(EvictableResource& resource)
+{
+	// The budget is a target. Data that is used is restored even if nothing can be evicted for it
+	evictFor(resource.size);
+
+	vk::DeviceSize size;
+	try
+	{
+		size = resource.restore();
+	}
+	catch (const vk::OutOfDeviceMemoryError&)
+	{
+		// The budget was too large for the memory actually available. Freeing all unused data is the last resort
+		if (!evictUnused())
+		{
+			throw;
+		}
+		size = resource.restore();
+	}
+
+	resource.size = size;
+	resource.resident = true;
+	residentBytes += size;
+	++restores;
+}
+
+bool ResidencyManager::evictFor(const vk::DeviceSize requiredBytes)
+{
+	if (residentBytes + requiredBytes <= budget)
+	{
+		return true;
+	}
+
+	std::vector<EvictableResource*> candidates{};
+	for (EvictableResource* resource : resources)
+	{
+		if (resource->resident && !isInFlight(*resource))
+		{
+			candidates.push_back(resource);
+		}
+	}
+	std::ranges::sort(candidates, {}, &EvictableResource::lastUsedFrame);
+
+	for (EvictableResource* resource : candidates)
+	{
+		if (residentBytes + requiredBytes <= budget)
+		{
+			break;
+		}
+		evict(*resource);
+	}
+	return residentBytes + requiredBytes <= budget;
+}
+
+bool ResidencyManager::evictUnused()
+{
+	bool evicted{false};
+	for (EvictableResource* resource : resources)
+	{
+		if (resource->resident && !isInFlight(*resource))
+		{
+			evict(*resource);
+			evicted = true;
+		}
+	}
+	return evicted;
+}
+
+void ResidencyManager::evict(EvictableResource& resource)
+{
+	resource.evict();
+	resource.resident = false;
+	residentBytes -= resource.size;
+	++evictions;
+}
+
+bool ResidencyManager::isInFlight(const EvictableResource& resource) const
+{
+	// All frames up to frameNumber - framesInFlight have finished once the current frame has begun
+	return resource.lastUsedFrame + framesInFlight > frameNumber;
+}
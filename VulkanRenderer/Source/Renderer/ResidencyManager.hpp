@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "VulkanBackend.hpp"
+
+class ResidencyManager;
+
+struct ResidencyStats
+{
+	uint32_t residentCount{0};
+	uint32_t evictedCount{0};
+	vk::DeviceSize residentBytes{0};
+	vk::DeviceSize budget{0};
+	// Since the start of the renderer
+	uint32_t evictions{0};
+	uint32_t restores{0};
+
+	void drawImGui() const;
+};
+
+// Device data that the residency manager may evict under memory pressure. It is restored from its source once it is used again
+// Starts out evicted, so only data that is actually used is uploaded
+class EvictableResource
+{
+public:
+	// expectedSize is the size in device memory until the data has been uploaded for the first time
+	EvictableResource(ResidencyManager& manager, vk::DeviceSize expectedSize);
+	virtual ~EvictableResource();
+
+	EvictableResource(const EvictableResource&) = delete;
+	EvictableResource& operator=(const EvictableResource&) = delete;
+
+	// Has to be called in every frame using the data, before it is recorded. Restores the data if it was evicted
+	void markUsed();
+
+	[[nodiscard]] bool isResident() const;
+
+protected:
+	// Uploads the data from its source and returns its size in device memory
+	virtual vk::DeviceSize restore() = 0;
+	// Destroys the device data. No frame in flight uses it anymore
+	virtual void evict() = 0;
+
+private:
+	ResidencyManager& manager;
+	size_t index; // In the resources of the manager
+	uint64_t lastUsedFrame;
+	vk::DeviceSize size;
+	bool resident{false};
+
+	friend class ResidencyManager;
+};
+
+// Keeps the evictable device data within a budget. Data that has not been used for the longest time is evicted first
+// Only data that no frame in flight uses is evicted, so it can be destroyed right away. Not thread safe, resources are used on the main thread
+class ResidencyManager
+{
+public:
+	ResidencyManager(uint32_t framesInFlight, vk::DeviceSize budget);
+
+	// Starts the next frame and evicts data until the budget is met again
+	void beginFrame();
+
+	[[nodiscard]] ResidencyStats getStats() const;
+
+private:
+	uint32_t framesInFlight;
+	vk::DeviceSize budget;
+	uint64_t frameNumber{0};
+	std::vector<EvictableResource*> resources;
+	vk::DeviceSize residentBytes{0};
+	uint32_t evictions{0};
+	uint32_t restores{0};
+
+	void add(EvictableResource& resource);
+	void remove(EvictableResource& resource);
+
+	// Restores the data of the resource, evicting other data first if it would exceed the budget
+	void restore(EvictableResource& resource);
+
+	// Evicts the least recently used data until requiredBytes more fit into the budget. Returns whether they do
+	bool evictFor(vk::DeviceSize requiredBytes);
+	// Evicts all data that no frame in flight uses. Returns whether anything was evicted
+	bool evictUnused();
+	void evict(EvictableResource& resource);
+
+	[[nodiscard]] bool isInFlight(const EvictableResource& resource) const;
+
+	friend class EvictableResource;
+};
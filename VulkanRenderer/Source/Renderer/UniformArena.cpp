@@ -0,0 +1,128 @@
+#include "UniformArena.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+UniformAllocation::UniformAllocation(UniformArena& arena, const Buffer& buffer, const size_t pageIndex, const vk::DeviceSize offset, const vk::DeviceSize size)
+	: arena(&arena), buffer(&buffer), pageIndex(pageIndex), offset(offset), size(size)
+{
+}
+
+UniformAllocation::~UniformAllocation()
+{
+	if (arena)
+	{
+		arena->free(pageIndex, offset, size);
+	}
+}
+
+UniformAllocation::UniformAllocation(UniformAllocation&& other) noexcept
+	: arena(std::exchange(other.arena, nullptr)), buffer(other.buffer), pageIndex(other.pageIndex), offset(other.offset), size(other.size)
+{
+}
+
+UniformAllocation& UniformAllocation::operator=(UniformAllocation&& other) noexcept
+{
+	if (this != &other)
+	{
+		if (arena)
+		{
+			arena->free(pageIndex, offset, size);
+		}
+		arena = std::exchange(other.arena, nullptr);
+		buffer = other.buffer;
+		pageIndex = other.pageIndex;
+		offset = other.offset;
+		size = other.size;
+	}
+	return *this;
+}
+
+const Buffer& UniformAllocation::getBuffer() const
+{
+	return *buffer;
+}
+
+vk::DeviceSize UniformAllocation::getOffset() const
+{
+	return offset;
+}
+
+std::byte* UniformAllocation::getMappedData() const
+{
+	return static_cast<std::byte*>(buffer->allocation.getMappedData()) + offset;
+}
+
+UniformArena::UniformArena(const vk::raii::Device& device, DeviceMemoryAllocator& allocator, const vk::DeviceSize alignment)
+	: device(device), allocator(allocator), alignment(alignment)
+{
+}
+
+UniformAllocation UniformArena::allocate(const vk::DeviceSize size)
+{
+	// Sizes are rounded up, so every free range starts aligned
+	const vk::DeviceSize alignedSize{(size + alignment - 1) / alignment * alignment};
+
+	std::lock_guard lock{mutex};
+	for (size_t pageIndex = 0; pageIndex < pages.size(); ++pageIndex)
+	{
+		Page& page{*pages[pageIndex]};
+		const auto range{std::ranges::find_if(page.freeRanges, [alignedSize](const FreeRange& freeRange) { return freeRange.size >= alignedSize; })};
+		if (range == page.freeRanges.end())
+		{
+			continue;
+		}
+
+		const vk::DeviceSize offset{range->offset};
+		range->offset += alignedSize;
+		range->size -= alignedSize;
+		if (range->size == 0)
+		{
+			page.freeRanges.erase(range);
+		}
+		return {*this, page.buffer, pageIndex, offset, alignedSize};
+	}
+
+	const vk::DeviceSize bufferSize{std::max(pageSize, alignedSize)};
+	Page& page{*pages.emplace_back(std::make_unique<Page>(
+		Buffer{
+			device, allocator, bufferSize, vk::BufferUsageFlagBits::eUniformBuffer, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+			MemoryCategory::ShaderObject
+		},
+		std::vector<FreeRange>{}))};
+	if (bufferSize > alignedSize)
+	{
+		page.freeRanges.emplace_back(alignedSize, bufferSize - alignedSize);
+	}
+	return {*this, page.buffer, pages.size() - 1, 0, alignedSize};
+}
+
+size_t UniformArena::getPageCount() const
+{
+	std::lock_guard lock{mutex};
+	return pages.size();
+}
+
+void UniformArena::free(const size_t pageIndex, const vk::DeviceSize offset, const vk::DeviceSize size)
+{
+	std::lock_guard lock{mutex};
+	std::vector<FreeRange>& freeRanges{pages[pageIndex]->freeRanges};
+
+	const auto inserted{freeRanges.emplace(std::ranges::lower_bound(freeRanges, offset, {}, &FreeRange::offset), offset, size)};
+
+	// Merges with the following range first, so the iterator to the new range stays valid
+	if (const auto following{std::next(inserted)}; following != freeRanges.end() && inserted->offset + inserted->size == following->offset)
+	{
+		inserted->size += following->size;
+		freeRanges.erase(following);
+	}
+	if (inserted != freeRanges.begin())
+	{
+		if (const auto previous{std::prev(inserted)}; previous->offset + previous->size == inserted->offset)
+		{
+			previous->size += inserted->size;
+			freeRanges.erase(inserted);
+		}
+	}
+}
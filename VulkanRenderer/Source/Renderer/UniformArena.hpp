@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "Buffer.hpp"
+#include "VulkanBackend.hpp"
+
+class UniformArena;
+
+// Range of a uniform arena page. Returned to the arena when destroyed
+class UniformAllocation
+{
+public:
+	UniformAllocation(UniformArena& arena, const Buffer& buffer, size_t pageIndex, vk::DeviceSize offset, vk::DeviceSize size);
+	~UniformAllocation();
+
+	UniformAllocation(const UniformAllocation&) = delete;
+	UniformAllocation& operator=(const UniformAllocation&) = delete;
+	UniformAllocation(UniformAllocation&& other) noexcept;
+	UniformAllocation& operator=(UniformAllocation&& other) noexcept;
+
+	[[nodiscard]] const Buffer& getBuffer() const;
+	// Offset into the buffer. A multiple of minUniformBufferOffsetAlignment
+	[[nodiscard]] vk::DeviceSize getOffset() const;
+	// Start of the range in the persistently mapped buffer
+	[[nodiscard]] std::byte* getMappedData() const;
+
+private:
+	UniformArena* arena;
+	const Buffer* buffer;
+	size_t pageIndex;
+	vk::DeviceSize offset;
+	vk::DeviceSize size;
+};
+
+// Suballocates the uniform data of shader objects from a few large host visible buffers, instead of a buffer per shader object
+// Allocations never move, freed ranges are reused first fit. Allocating and freeing are thread safe
+class UniformArena
+{
+public:
+	UniformArena(const vk::raii::Device& device, DeviceMemoryAllocator& allocator, vk::DeviceSize alignment);
+
+	static constexpr vk::DeviceSize pageSize{1024 * 1024};
+
+	// Allocations larger than a page get a page of their own
+	[[nodiscard]] UniformAllocation allocate(vk::DeviceSize size);
+
+	[[nodiscard]] size_t getPageCount() const;
+
+private:
+	struct FreeRange
+	{
+		vk::DeviceSize offset;
+		vk::DeviceSize size;
+	};
+
+	struct Page
+	{
+		Buffer buffer;
+		std::vector<FreeRange> freeRanges; // Sorted by offset, neighbours are merged
+	};
+
+	const vk::raii::Device& device;
+	DeviceMemoryAllocator& allocator;
+	vk::DeviceSize alignment;
+
+	mutable std::mutex mutex;
+	std::vector<std::unique_ptr<Page>> pages; // Pointers keep the buffers in place when pages are added
+
+	void free(size_t pageIndex, vk::DeviceSize offset, vk::DeviceSize size);
+
+	friend UniformAllocation;
+};
@@ -0,0 +1,438 @@
+#include "UploadContext.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <ranges>
+
+#include "check.hpp"
+#include "Image.hpp"
+
+static vk::raii::Semaphore createTimelineSemaphore(const vk::raii::Device& device)
+{
+	const vk::StructureChain<vk::SemaphoreCreateInfo, vk::SemaphoreTypeCreateInfo> createInfo{{}, {vk::SemaphoreType::eTimeline, 0}};
+	return vk::raii::Semaphore{device, createInfo.get<vk::SemaphoreCreateInfo>()};
+}
+
+UploadContext::UploadContext(const vk::raii::Device& device, DeviceMemoryAllocator& allocator, const vk::raii::Queue& graphicsQueue, const uint32_t graphicsQueueFamilyIndex,
+                             const vk::raii::Queue& transferQueue, const uint32_t transferQueueFamilyIndex, const vk::DeviceSize stagingSize)
+	: device(device), allocator(allocator), graphicsQueue(graphicsQueue), graphicsQueueFamilyIndex(graphicsQueueFamilyIndex), transferQueue(transferQueue),
+	  transferQueueFamilyIndex(transferQueueFamilyIndex),
+	  copySemaphore(transferQueueFamilyIndex != graphicsQueueFamilyIndex ? createTimelineSemaphore(device) : vk::raii::Semaphore{nullptr}), stagingSize(stagingSize),
+	  stagingBuffer(device, allocator, stagingSize, vk::BufferUsageFlagBits::eTransferSrc,
+	                vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, MemoryCategory::Staging),
+	  stagingData(static_cast<std::byte*>(stagingBuffer.allocation.getMappedData()))
+{
+}
+
+UploadTicket UploadContext::upload(const std::span<const std::byte> data, const std::function<void(const vk::raii::CommandBuffer&, vk::Buffer, vk::DeviceSize)>& recordCopy)
+{
+	std::lock_guard lock{mutex};
+
+	return stage(data, recordCopy).ticket;
+}
+
+UploadTicket UploadContext::copyToBuffer(const Buffer& destination, const std::span<const std::byte> data, const vk::DeviceSize dstOffset)
+{
+	std::lock_guard lock{mutex};
+
+	Batch& batch{stage(data, [&](const vk::raii::CommandBuffer& commandBuffer, const vk::Buffer buffer, const vk::DeviceSize offset)
+	{
+		const vk::BufferCopy copyRegion{offset, dstOffset, data.size()};
+		commandBuffer.copyBuffer(buffer, destination.vkBuffer, copyRegion);
+	})};
+
+	const bool isTransferred{
+		std::ranges::contains(batch.bufferOwnershipTransfers, *destination.vkBuffer, [](const vk::BufferMemoryBarrier2& barrier) { return barrier.buffer; })
+	};
+	if (hasDedicatedTransferQueue() && !isTransferred)
+	{
+		batch.bufferOwnershipTransfers.emplace_back(
+			vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite,
+			vk::PipelineStageFlagBits2::eAllCommands, vk::AccessFlagBits2::eMemoryRead | vk::AccessFlagBits2::eMemoryWrite,
+			transferQueueFamilyIndex, graphicsQueueFamilyIndex, *destination.vkBuffer, 0, vk::WholeSize);
+	}
+	return batch.ticket;
+}
+
+UploadTicket UploadContext::copyToImage(const Image& destination, const std::span<const std::byte> data, const uint32_t layerCount)
+{
+	std::lock_guard lock{mutex};
+
+	const vk::ImageSubresourceRange copiedRange{vk::ImageAspectFlagBits::eColor, 0, 1, 0, layerCount};
+
+	// Only staged here. The copy is recorded by recordImageWork
+	vk::Buffer stagingSource{};
+	vk::DeviceSize stagingOffset{0};
+	Batch& batch{stage(data, [&](const vk::raii::CommandBuffer&, const vk::Buffer buffer, const vk::DeviceSize offset)
+	{
+		stagingSource = buffer;
+		stagingOffset = offset;
+	})};
+
+	destination.transition(batch.barriers, vk::ImageLayout::eTransferDstOptimal, vk::PipelineStageFlagBits2::eCopy, vk::AccessFlagBits2::eTransferWrite, copiedRange);
+	batch.imageCopies.emplace_back(stagingSource, &destination, vk::BufferImageCopy{
+		stagingOffset, 0, 0, vk::ImageSubresourceLayers{vk::ImageAspectFlagBits::eColor, 0, 0, layerCount}, vk::Offset3D{0, 0, 0},
+		vk::Extent3D{destination.width, destination.height, 1}
+	});
+
+	if (hasDedicatedTransferQueue())
+	{
+		// Only the copied subresources change owner. The graphics queue writes the other mip levels from scratch, so their content need not be kept. The layout stays
+		batch.imageOwnershipTransfers.emplace_back(
+			vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite,
+			vk::PipelineStageFlagBits2::eAllCommands, vk::AccessFlagBits2::eMemoryRead | vk::AccessFlagBits2::eMemoryWrite,
+			vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eTransferDstOptimal, transferQueueFamilyIndex, graphicsQueueFamilyIndex, *destination.image, copiedRange);
+	}
+	return batch.ticket;
+}
+
+UploadTicket UploadContext::generateMipMaps(const Image& image)
+{
+	std::lock_guard lock{mutex};
+
+	Batch& batch{getRecordingBatch()};
+	batch.mipMapImages.push_back(&image);
+	return batch.ticket;
+}
+
+UploadTicket UploadContext::record(const std::function<void(const vk::raii::CommandBuffer&)>& recordCommands, const UploadQueue queue)
+{
+	std::lock_guard lock{mutex};
+
+	Batch& batch{getRecordingBatch()};
+	recordImageWork(batch);
+	const bool onGraphicsQueue{queue == UploadQueue::Graphics && hasDedicatedTransferQueue()};
+	recordCommands(onGraphicsQueue ? batch.graphicsCommandBuffer : batch.commandBuffer);
+	return batch.ticket;
+}
+
+UploadContext::Batch& UploadContext::stage(const std::span<const std::byte> data,
+                                           const std::function<void(const vk::raii::CommandBuffer&, vk::Buffer, vk::DeviceSize)>& recordCopy)
+{
+	if (data.size() > stagingSize)
+	{
+		Buffer dedicatedBuffer{device, allocator, data.size(), vk::BufferUsageFlagBits::eTransferSrc,
+		                       vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, MemoryCategory::Staging};
+
+		std::memcpy(dedicatedBuffer.allocation.getMappedData(), data.data(), data.size());
+
+		Batch& batch{getRecordingBatch()};
+		recordCopy(batch.commandBuffer, dedicatedBuffer.vkBuffer, 0);
+		batch.dedicatedStagingBuffers.push_back(std::move(dedicatedBuffer));
+		return batch;
+	}
+
+	// Allocate before starting the batch, as a full ring submits the current one
+	const vk::DeviceSize offset{allocateStaging(data.size())};
+	std::memcpy(stagingData + offset, data.data(), data.size());
+
+	Batch& batch{getRecordingBatch()};
+	batch.stagingEnd = stagingHead;
+	recordCopy(batch.commandBuffer, stagingBuffer.vkBuffer, offset);
+	return batch;
+}
+
+UploadTicket UploadContext::flush()
+{
+	std::lock_guard lock{mutex};
+
+	retireCompletedBatches();
+	return submitRecordingBatch();
+}
+
+void UploadContext::wait(const UploadTicket ticket)
+{
+	std::lock_guard lock{mutex};
+
+	if (recordingBatch && recordingBatch->ticket <= ticket)
+	{
+		submitRecordingBatch();
+	}
+
+	while (completedTicket < ticket && !submittedBatches.empty())
+	{
+		retireOldestBatch();
+	}
+}
+
+bool UploadContext::isComplete(const UploadTicket ticket)
+{
+	std::lock_guard lock{mutex};
+
+	retireCompletedBatches();
+	return completedTicket >= ticket;
+}
+
+bool UploadContext::hasDedicatedTransferQueue() const
+{
+	return transferQueueFamilyIndex != graphicsQueueFamilyIndex;
+}
+
+void UploadContext::recordVisibilityBarrier(const vk::raii::CommandBuffer& commandBuffer)
+{
+	// Layout transitions of the uploads are done by their own barriers, only the copies have to be made visible
+	const vk::MemoryBarrier2 barrier{
+		vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite,
+		vk::PipelineStageFlagBits2::eAllCommands, vk::AccessFlagBits2::eMemoryRead | vk::AccessFlagBits2::eMemoryWrite
+	};
+	commandBuffer.pipelineBarrier2(vk::DependencyInfo{{}, barrier, nullptr, nullptr});
+}
+
+UploadContext::Batch& UploadContext::getRecordingBatch()
+{
+	if (recordingBatch)
+	{
+		return *recordingBatch;
+	}
+
+	if (freeBatches.empty())
+	{
+		recordingBatch.emplace(createBatch());
+	}
+	else
+	{
+		recordingBatch.emplace(std::move(freeBatches.back()));
+		freeBatches.pop_back();
+	}
+
+	recordingBatch->ticket = nextTicket++;
+	recordingBatch->commandBuffer.begin(vk::CommandBufferBeginInfo{vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+	if (hasDedicatedTransferQueue())
+	{
+		recordingBatch->graphicsCommandBuffer.begin(vk::CommandBufferBeginInfo{vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+	}
+	return *recordingBatch;
+}
+
+UploadTicket UploadContext::submitRecordingBatch()
+{
+	if (!recordingBatch)
+	{
+		return nextTicket - 1;
+	}
+
+	Batch& batch{*recordingBatch};
+	recordImageWork(batch);
+
+	if (!hasDedicatedTransferQueue())
+	{
+		batch.commandBuffer.end();
+
+		const vk::SubmitInfo submitInfo{nullptr, nullptr, *batch.commandBuffer, nullptr};
+		graphicsQueue.submit(submitInfo, batch.fence);
+	}
+	else
+	{
+		// The same barriers release on the transfer queue and acquire on the graphics queue
+		const vk::DependencyInfo ownershipTransfer{{}, nullptr, batch.bufferOwnershipTransfers, batch.imageOwnershipTransfers};
+		batch.commandBuffer.pipelineBarrier2(ownershipTransfer);
+		batch.commandBuffer.end();
+
+		batch.acquireCommandBuffer.begin(vk::CommandBufferBeginInfo{vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+		batch.acquireCommandBuffer.pipelineBarrier2(ownershipTransfer);
+		batch.acquireCommandBuffer.end();
+		batch.graphicsCommandBuffer.end();
+
+		// The graphics queue waits for the copies on the device, frames submitted in the meantime are not held up
+		const vk::SemaphoreSubmitInfo copiesCompleted{*copySemaphore, batch.ticket, vk::PipelineStageFlagBits2::eAllCommands};
+
+		const vk::CommandBufferSubmitInfo transferCommands{*batch.commandBuffer};
+		transferQueue.submit2(vk::SubmitInfo2{{}, nullptr, transferCommands, copiesCompleted}, nullptr);
+
+		const std::array graphicsCommands{vk::CommandBufferSubmitInfo{*batch.acquireCommandBuffer}, vk::CommandBufferSubmitInfo{*batch.graphicsCommandBuffer}};
+		graphicsQueue.submit2(vk::SubmitInfo2{{}, copiesCompleted, graphicsCommands, nullptr}, batch.fence);
+	}
+
+	const UploadTicket ticket{recordingBatch->ticket};
+	submittedBatches.push_back(std::move(*recordingBatch));
+	recordingBatch.reset();
+	return ticket;
+}
+
+void UploadContext::recordImageWork(Batch& batch)
+{
+	batch.barriers.flush(batch.commandBuffer);
+	for (const PendingImageCopy& copy : batch.imageCopies)
+	{
+		batch.commandBuffer.copyBufferToImage(copy.source, copy.destination->image, vk::ImageLayout::eTransferDstOptimal, copy.region);
+	}
+	batch.imageCopies.clear();
+
+	recordMipMapGeneration(batch);
+}
+
+void UploadContext::recordMipMapGeneration(Batch& batch)
+{
+	if (batch.mipMapImages.empty())
+	{
+		return;
+	}
+
+	const vk::raii::CommandBuffer& commandBuffer{hasDedicatedTransferQueue() ? batch.graphicsCommandBuffer : batch.commandBuffer};
+	const uint32_t maxMipLevels{std::ranges::max(batch.mipMapImages | std::views::transform([](const Image* image) { return image->mipLevels; }))};
+
+	for (uint32_t i = 1; i < maxMipLevels; ++i)
+	{
+		// The blit reads the previous mip and writes this one. The transitions of all images go into one barrier
+		for (const Image* image : batch.mipMapImages)
+		{
+			if (i < image->mipLevels)
+			{
+				image->transition(batch.barriers, vk::ImageLayout::eTransferSrcOptimal, vk::PipelineStageFlagBits2::eBlit, vk::AccessFlagBits2::eTransferRead,
+				                  image->getSubresourceRange(i - 1, 1));
+				image->transition(batch.barriers, vk::ImageLayout::eTransferDstOptimal, vk::PipelineStageFlagBits2::eBlit, vk::AccessFlagBits2::eTransferWrite,
+				                  image->getSubresourceRange(i, 1));
+			}
+		}
+		batch.barriers.flush(commandBuffer);
+
+		for (const Image* image : batch.mipMapImages)
+		{
+			if (i >= image->mipLevels)
+			{
+				continue;
+			}
+
+			const int32_t sourceWidth{static_cast<int32_t>(std::max(image->width >> (i - 1), 1u))};
+			const int32_t sourceHeight{static_cast<int32_t>(std::max(image->height >> (i - 1), 1u))};
+			const uint32_t layerCount{image->getArrayLayerCount()};
+			const vk::ImageBlit blit{
+				vk::ImageSubresourceLayers{vk::ImageAspectFlagBits::eColor, i - 1, 0, layerCount}, std::array{vk::Offset3D{0, 0, 0}, vk::Offset3D{sourceWidth, sourceHeight, 1}},
+				vk::ImageSubresourceLayers{vk::ImageAspectFlagBits::eColor, i, 0, layerCount},
+				std::array{vk::Offset3D{0, 0, 0}, vk::Offset3D{std::max(sourceWidth / 2, 1), std::max(sourceHeight / 2, 1), 1}}
+			};
+			commandBuffer.blitImage(image->image, vk::ImageLayout::eTransferSrcOptimal, image->image, vk::ImageLayout::eTransferDstOptimal, blit, vk::Filter::eLinear);
+		}
+	}
+
+	// Make all mips of all images suitable for shaders at once
+	for (const Image* image : batch.mipMapImages)
+	{
+		image->transition(batch.barriers, vk::ImageLayout::eShaderReadOnlyOptimal, vk::PipelineStageFlagBits2::eFragmentShader, vk::AccessFlagBits2::eShaderSampledRead,
+		                  image->getSubresourceRange());
+	}
+	batch.barriers.flush(commandBuffer);
+	batch.mipMapImages.clear();
+}
+
+void UploadContext::retireCompletedBatches()
+{
+	while (!submittedBatches.empty() && submittedBatches.front().fence.getStatus() == vk::Result::eSuccess)
+	{
+		retireBatch(std::move(submittedBatches.front()));
+		submittedBatches.pop_front();
+	}
+}
+
+void UploadContext::retireOldestBatch()
+{
+	check(device.waitForFences(*submittedBatches.front().fence, true, UINT64_MAX), "Fence wait failed");
+
+	retireBatch(std::move(submittedBatches.front()));
+	submittedBatches.pop_front();
+}
+
+void UploadContext::retireBatch(Batch&& batch)
+{
+	if (batch.stagingEnd)
+	{
+		stagingTail = *batch.stagingEnd;
+	}
+	completedTicket = batch.ticket;
+
+	device.resetFences(*batch.fence);
+	batch.commandPool.reset();
+	if (hasDedicatedTransferQueue())
+	{
+		batch.graphicsCommandPool.reset();
+	}
+	batch.stagingEnd.reset();
+	batch.dedicatedStagingBuffers.clear();
+	batch.bufferOwnershipTransfers.clear();
+	batch.imageOwnershipTransfers.clear();
+
+	freeBatches.push_back(std::move(batch));
+}
+
+vk::DeviceSize UploadContext::allocateStaging(const vk::DeviceSize size)
+{
+	while (true)
+	{
+		if (const std::optional<vk::DeviceSize> offset{tryAllocateStaging(size)})
+		{
+			return *offset;
+		}
+
+		// Only submitted batches give space back
+		if (submittedBatches.empty())
+		{
+			submitRecordingBatch();
+		}
+		retireOldestBatch();
+	}
+}
+
+std::optional<vk::DeviceSize> UploadContext::tryAllocateStaging(const vk::DeviceSize size)
+{
+	const bool isEmpty{
+		std::ranges::none_of(submittedBatches, [](const Batch& batch) { return batch.stagingEnd.has_value(); })
+		&& !(recordingBatch && recordingBatch->stagingEnd)
+	};
+	if (isEmpty)
+	{
+		stagingHead = 0;
+		stagingTail = 0;
+	}
+
+	const vk::DeviceSize offset{(stagingHead + stagingAlignment - 1) / stagingAlignment * stagingAlignment};
+
+	if (stagingHead >= stagingTail)
+	{
+		// Free space behind the head and in front of the tail
+		if (offset + size <= stagingSize)
+		{
+			stagingHead = offset + size;
+			return offset;
+		}
+
+		// Wrap around. The head stays below the tail, as equal positions mean the ring is empty
+		if (size < stagingTail)
+		{
+			stagingHead = size;
+			return 0;
+		}
+		return std::nullopt;
+	}
+
+	if (offset + size < stagingTail)
+	{
+		stagingHead = offset + size;
+		return offset;
+	}
+	return std::nullopt;
+}
+
+UploadContext::Batch UploadContext::createBatch() const
+{
+	const vk::CommandPoolCreateInfo commandPoolCreateInfo{vk::CommandPoolCreateFlagBits::eTransient, transferQueueFamilyIndex};
+	vk::raii::CommandPool commandPool{device, commandPoolCreateInfo};
+	vk::raii::CommandBuffer commandBuffer{std::move(device.allocateCommandBuffers({commandPool, vk::CommandBufferLevel::ePrimary, 1}).front())};
+
+	if (!hasDedicatedTransferQueue())
+	{
+		return Batch{
+			std::move(commandPool), std::move(commandBuffer), vk::raii::CommandPool{nullptr}, vk::raii::CommandBuffer{nullptr}, vk::raii::CommandBuffer{nullptr},
+			vk::raii::Fence{device, vk::FenceCreateInfo{}}
+		};
+	}
+
+	const vk::CommandPoolCreateInfo graphicsCommandPoolCreateInfo{vk::CommandPoolCreateFlagBits::eTransient, graphicsQueueFamilyIndex};
+	vk::raii::CommandPool graphicsCommandPool{device, graphicsCommandPoolCreateInfo};
+	vk::raii::CommandBuffers graphicsCommandBuffers{device, {graphicsCommandPool, vk::CommandBufferLevel::ePrimary, 2}};
+
+	return Batch{
+		std::move(commandPool), std::move(commandBuffer), std::move(graphicsCommandPool), std::move(graphicsCommandBuffers[0]), std::move(graphicsCommandBuffers[1]),
+		vk::raii::Fence{device, vk::FenceCreateInfo{}}
+	};
+}
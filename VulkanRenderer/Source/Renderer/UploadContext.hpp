@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "BarrierBatcher.hpp"
+#include "Buffer.hpp"
+#include "VulkanBackend.hpp"
+
+class Image;
+
+// Identifies a batch of uploads. Later batches have larger tickets
+using UploadTicket = uint64_t;
+
+// Queue recorded commands run on. Both are the graphics queue unless the device has a dedicated transfer queue
+enum class UploadQueue
+{
+	Transfer,
+	Graphics
+};
+
+// Records the copies and layout transitions of many uploads into one command buffer, which is submitted once with a fence
+// Source data is staged in a persistently mapped ring buffer. Its space is reclaimed once the batch reading it has completed
+// Work submitted to the graphics queue afterwards only needs recordVisibilityBarrier, nobody has to stall the queue
+// With a dedicated transfer queue, the copies run there. The uploaded resources are then released to the graphics queue family,
+// whose part of the batch waits for the copies on a timeline semaphore, acquires the resources and runs the commands recorded for it
+class UploadContext
+{
+public:
+	UploadContext(const vk::raii::Device& device, DeviceMemoryAllocator& allocator, const vk::raii::Queue& graphicsQueue, uint32_t graphicsQueueFamilyIndex,
+	              const vk::raii::Queue& transferQueue, uint32_t transferQueueFamilyIndex, vk::DeviceSize stagingSize = defaultStagingSize);
+
+	static constexpr vk::DeviceSize defaultStagingSize{64 * 1024 * 1024};
+
+	// Stages the data and records the copy reading it. recordCopy receives the staging buffer and the offset of the data in it
+	// Data larger than the ring gets a staging buffer of its own, which lives until its batch has completed
+	// The destination is not handed over to the graphics queue, copyToBuffer and copyToImage do that
+	UploadTicket upload(std::span<const std::byte> data, const std::function<void(const vk::raii::CommandBuffer&, vk::Buffer, vk::DeviceSize)>& recordCopy);
+	UploadTicket copyToBuffer(const Buffer& destination, std::span<const std::byte> data, vk::DeviceSize dstOffset = 0);
+	// Copies tightly packed texels into mip 0 of the first layerCount layers. They are transitioned to eTransferDstOptimal from their tracked state
+	// The copy is recorded with the other image copies of the batch, behind a single barrier
+	UploadTicket copyToImage(const Image& destination, std::span<const std::byte> data, uint32_t layerCount = 1);
+	// Blits the other mip levels of all layers from mip 0, then transitions the image for sampling in fragment shaders. Runs on the graphics queue after the copies
+	// The mips of all images of the batch are generated level by level, so each level needs only one barrier. The image must outlive the batch's submission
+	UploadTicket generateMipMaps(const Image& image);
+
+	// Records other commands into the current batch, e.g. layout transitions
+	// Commands on the graphics queue run after all copies of the batch. The image copies and mip generation queued so far are recorded first
+	UploadTicket record(const std::function<void(const vk::raii::CommandBuffer&)>& recordCommands, UploadQueue queue = UploadQueue::Graphics);
+
+	// Submits the current batch. Returns its ticket, or the one of the last batch if nothing was recorded
+	UploadTicket flush();
+	// Submits the ticket's batch if needed and waits for it on the host
+	void wait(UploadTicket ticket);
+	[[nodiscard]] bool isComplete(UploadTicket ticket);
+
+	[[nodiscard]] bool hasDedicatedTransferQueue() const;
+
+	// Makes the uploads submitted earlier to the graphics queue visible to all later commands
+	static void recordVisibilityBarrier(const vk::raii::CommandBuffer& commandBuffer);
+
+private:
+	struct PendingImageCopy
+	{
+		vk::Buffer source;
+		const Image* destination;
+		vk::BufferImageCopy region;
+	};
+
+	struct Batch
+	{
+		// Runs on the transfer queue
+		vk::raii::CommandPool commandPool;
+		vk::raii::CommandBuffer commandBuffer;
+		// Only with a dedicated transfer queue. Run on the graphics queue once the copies have completed
+		vk::raii::CommandPool graphicsCommandPool;
+		vk::raii::CommandBuffer acquireCommandBuffer;
+		vk::raii::CommandBuffer graphicsCommandBuffer;
+		vk::raii::Fence fence;
+		UploadTicket ticket{0};
+		// Ring position after the last staging allocation of the batch. Empty if it did not stage anything in the ring
+		std::optional<vk::DeviceSize> stagingEnd;
+		std::vector<Buffer> dedicatedStagingBuffers;
+		// Release the copied resources on the transfer queue and acquire them on the graphics queue. Recorded when the batch is submitted
+		std::vector<vk::BufferMemoryBarrier2> bufferOwnershipTransfers;
+		std::vector<vk::ImageMemoryBarrier2> imageOwnershipTransfers;
+		// Image work waits until other commands are recorded or the batch is submitted, so the barriers of all images are recorded together
+		BarrierBatcher barriers;
+		std::vector<PendingImageCopy> imageCopies;
+		std::vector<const Image*> mipMapImages;
+	};
+
+	static constexpr vk::DeviceSize stagingAlignment{16};
+
+	const vk::raii::Device& device;
+	DeviceMemoryAllocator& allocator;
+	const vk::raii::Queue& graphicsQueue;
+	uint32_t graphicsQueueFamilyIndex;
+	const vk::raii::Queue& transferQueue;
+	uint32_t transferQueueFamilyIndex;
+	// Signaled with the ticket of a batch once its copies have completed. Only used with a dedicated transfer queue
+	vk::raii::Semaphore copySemaphore;
+
+	vk::DeviceSize stagingSize;
+	Buffer stagingBuffer;
+	std::byte* stagingData;
+	// Allocations are made at the head and freed at the tail
+	vk::DeviceSize stagingHead{0};
+	vk::DeviceSize stagingTail{0};
+
+	std::optional<Batch> recordingBatch;
+	std::deque<Batch> submittedBatches;
+	std::vector<Batch> freeBatches;
+
+	UploadTicket nextTicket{1};
+	UploadTicket completedTicket{0};
+
+	std::mutex mutex;
+
+	Batch& getRecordingBatch();
+	// Stages the data and records the copy into the recording batch
+	Batch& stage(std::span<const std::byte> data, const std::function<void(const vk::raii::CommandBuffer&, vk::Buffer, vk::DeviceSize)>& recordCopy);
+	UploadTicket submitRecordingBatch();
+	// Records the queued image copies behind one barrier, then the queued mip generation
+	void recordImageWork(Batch& batch);
+	void recordMipMapGeneration(Batch& batch);
+	void retireCompletedBatches();
+	// Waits for the oldest submitted batch
+	void retireOldestBatch();
+	void retireBatch(Batch&& batch);
+
+	// Submits and waits for batches until the ring has space
+	vk::DeviceSize allocateStaging(vk::DeviceSize size);
+	std::optional<vk::DeviceSize> tryAllocateStaging(vk::DeviceSize size);
+
+	[[nodiscard]] Batch createBatch() const;
+};
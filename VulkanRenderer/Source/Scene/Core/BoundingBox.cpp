@@ -0,0 +1,21 @@
+#include "BoundingBox.hpp"
+
+glm::vec3 BoundingBox::getCenter() const
+{
+	return (minimum + maximum) * .5f;
+}
+
+glm::vec3 BoundingBox::getExtent() const
+{
+	return (maximum - minimum) * .5f;
+}
+
+BoundingBox BoundingBox::transformed(const glm::mat4& transform) const
+{
+	// Every world axis of the extent gathers the absolute contributions of all local axes
+	const glm::mat3 absoluteTransform{abs(glm::vec3{transform[0]}), abs(glm::vec3{transform[1]}), abs(glm::vec3{transform[2]})};
+
+	const glm::vec3 center{transform * glm::vec4{getCenter(), 1.f}};
+	const glm::vec3 extent{absoluteTransform * getExtent()};
+	return {center - extent, center + extent};
+}
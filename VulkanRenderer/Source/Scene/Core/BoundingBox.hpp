@@ -0,0 +1,15 @@
+#pragma once
+#include <glm/glm.hpp>
+
+// Axis aligned bounding box
+struct BoundingBox
+{
+	glm::vec3 minimum{0.};
+	glm::vec3 maximum{0.};
+
+	[[nodiscard]] glm::vec3 getCenter() const;
+	[[nodiscard]] glm::vec3 getExtent() const; // Half of the size
+
+	// Smallest axis aligned box containing this box after transforming it
+	[[nodiscard]] BoundingBox transformed(const glm::mat4& transform) const;
+};
@@ -8,12 +8,14 @@ glm::mat4 Transform::getMatrix() const
 	return glm::scale(translate(glm::mat4{1.0f}, translation) * mat4_cast(rotation), scale);
 }
 
-void Transform::drawImGui(bool drawScale, bool drawRotation, bool drawLocation)
+bool Transform::drawImGui(bool drawScale, bool drawRotation, bool drawLocation)
 {
+	bool changed{false};
+
 	if (drawLocation)
 	{
 		ImGui::Text("Position:");
-		ImGui::DragFloat3("##0", reinterpret_cast<float*>(&translation), .01f);
+		changed |= ImGui::DragFloat3("##0", reinterpret_cast<float*>(&translation), .01f);
 	}
 
 	if (drawRotation)
@@ -23,12 +25,15 @@ void Transform::drawImGui(bool drawScale, bool drawRotation, bool drawLocation)
 		if (ImGui::DragFloat3("##1", reinterpret_cast<float*>(&eulerVec)))
 		{
 			rotation = glm::quat{radians(eulerVec)};
+			changed = true;
 		}
 	}
 
 	if (drawScale)
 	{
 		ImGui::Text("Scale:");
-		ImGui::DragFloat3("##2", reinterpret_cast<float*>(&scale), .1f);
+		changed |= ImGui::DragFloat3("##2", reinterpret_cast<float*>(&scale), .1f);
 	}
+
+	return changed;
 }
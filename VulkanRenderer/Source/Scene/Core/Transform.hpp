@@ -10,5 +10,6 @@ struct Transform {
 
 	[[nodiscard]] glm::mat4 getMatrix() const;
 
-	void drawImGui(bool drawScale = true, bool drawRotation = true, bool drawLocation = true);
+	// Returns true if the transform was edited
+	bool drawImGui(bool drawScale = true, bool drawRotation = true, bool drawLocation = true);
 };
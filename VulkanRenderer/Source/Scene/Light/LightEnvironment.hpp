@@ -7,12 +7,13 @@ class LightEnvironment
 {
 public:
 	virtual ~LightEnvironment() = 0;
-	virtual std::string getLightTypeName() const = 0;
+	virtual const std::string& getLightTypeName() const = 0;
 	virtual void writeToCursor(const ShaderCursor& cursor) const = 0;
 
 	virtual void drawImGui() = 0;
 };
 
+// The name is only built once, composite light types would otherwise concatenate it on every call
 #define IMPLEMENT_LIGHT_TYPE(lightTypeName) \
-	static std::string getLightTypeNameStatic() {return lightTypeName;} \
-	virtual std::string getLightTypeName() const override {return getLightTypeNameStatic();}
+	static const std::string& getLightTypeNameStatic() {static const std::string name{lightTypeName}; return name;} \
+	virtual const std::string& getLightTypeName() const override {return getLightTypeNameStatic();}
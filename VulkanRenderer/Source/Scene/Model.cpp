@@ -6,9 +6,14 @@
 
 #include <imgui.h>
 
+uint64_t Model::nextVersion{1};
+
 void Model::drawImGui()
 {
-    transform.drawImGui();
+    if (transform.drawImGui())
+    {
+        markChanged();
+    }
 
     ImGui::Text("Mesh:");
     if (ImGui::BeginCombo("##meshcombo", mesh->getName().data()))
@@ -20,6 +25,7 @@ void Model::drawImGui()
             if (ImGui::Selectable(meshOption.getName().data(), isSelected))
             {
                 mesh = mesh.getAssetManager().loadFromUUID<Mesh>(meshOption.getUUID());
+                markChanged();
             }
             if (isSelected)
             {
@@ -39,6 +45,7 @@ void Model::drawImGui()
             if (ImGui::Selectable(mat.getName().data(), isSelected))
             {
                 material = material.getAssetManager().loadFromUUID<MaterialInstance>(mat.getUUID());
+                markChanged();
             }
             if (isSelected)
             {
@@ -48,3 +55,46 @@ void Model::drawImGui()
         ImGui::EndCombo();
     }
 }
+
+const Transform& Model::getTransform() const
+{
+    return transform;
+}
+
+const AssetHandle<Mesh>& Model::getMesh() const
+{
+    return mesh;
+}
+
+const AssetHandle<MaterialInstance>& Model::getMaterial() const
+{
+    return material;
+}
+
+void Model::setTransform(const Transform& transform)
+{
+    this->transform = transform;
+    markChanged();
+}
+
+void Model::setMesh(const AssetHandle<Mesh>& mesh)
+{
+    this->mesh = mesh;
+    markChanged();
+}
+
+void Model::setMaterial(const AssetHandle<MaterialInstance>& material)
+{
+    this->material = material;
+    markChanged();
+}
+
+uint64_t Model::getVersion() const
+{
+    return version;
+}
+
+void Model::markChanged()
+{
+    version = nextVersion++;
+}
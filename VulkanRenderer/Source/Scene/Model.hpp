@@ -14,10 +14,30 @@ public:
 	{
 	}
 
+	void drawImGui();
+
+	[[nodiscard]] const Transform& getTransform() const;
+	[[nodiscard]] const AssetHandle<Mesh>& getMesh() const;
+	[[nodiscard]] const AssetHandle<MaterialInstance>& getMaterial() const;
+
+	// Only editable through the setters, which change the version
+	void setTransform(const Transform& transform);
+	void setMesh(const AssetHandle<Mesh>& mesh);
+	void setMaterial(const AssetHandle<MaterialInstance>& material);
+
+	// Changes whenever transform, mesh or material are set, so GPU-driven rendering only writes the instances of models that changed
+	[[nodiscard]] uint64_t getVersion() const;
+
+private:
 	Transform transform;
 
 	AssetHandle<Mesh> mesh;
 	AssetHandle<MaterialInstance> material; // TODO: Support multiple material slots
 
-	void drawImGui();
+
+	// Versions are unique across all models, so a slot that is taken over by another model is written again too
+	static uint64_t nextVersion;
+	uint64_t version{nextVersion++};
+
+	void markChanged();
 };
@@ -0,0 +1,167 @@
+#include "MaterialCompiler.hpp"
+
+#include <iostream>
+
+#include "ShaderCompiler.hpp"
+
+MaterialCompiler::MaterialCompiler(const Renderer& app, const uint32_t workerCount)
+	: app(app)
+{
+	threads.reserve(workerCount);
+	for (uint32_t i = 0; i < workerCount; ++i)
+	{
+		threads.emplace_back(&MaterialCompiler::runWorker, this);
+	}
+}
+
+MaterialCompiler::~MaterialCompiler()
+{
+	{
+		std::lock_guard lock{mutex};
+		stopping = true;
+	}
+	workAvailable.notify_all();
+
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+}
+
+std::shared_future<void> MaterialCompiler::compile(Material& material)
+{
+	std::packaged_task<void(const SlangCompiler&)> task{[&material, this](const SlangCompiler& compiler) { material.compile(compiler, app); }};
+	std::shared_future<void> future{task.get_future().share()};
+	submit(std::move(task));
+	return future;
+}
+
+void MaterialCompiler::compileAsync(const AssetHandle<Material>& material)
+{
+	const uint64_t submission{++submissionCount};
+	const UUID uuid{material.getUUID()};
+	latestSubmissions.insert_or_assign(uuid.value, PendingCompile{material, submission});
+
+	// The worker only gets copies of the names. Assets move in memory when others are unloaded, so the material is resolved again in applyFinished
+	submit(std::packaged_task<void(const SlangCompiler&)>{[uuid, submission, moduleName = material->getModuleName(), typeName = material->getTypeName(),
+		                                                   name = std::string{material->getName()}, this](const SlangCompiler& compiler)
+	{
+		std::optional<CompiledMaterial> compiled{};
+		try
+		{
+			compiled.emplace(Material::build(moduleName, typeName, compiler, app));
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << "Failed to compile material " << name << ": " << e.what() << std::endl;
+		}
+		std::lock_guard lock{finishedMutex};
+		finished.emplace_back(uuid, submission, std::move(compiled));
+	}});
+}
+
+void MaterialCompiler::applyFinished()
+{
+	std::vector<FinishedCompile> results{};
+	{
+		std::lock_guard lock{finishedMutex};
+		results.swap(finished);
+	}
+
+	// Workers may finish compiles of the same material out of order. Only the latest submitted one is applied
+	for (FinishedCompile& result : results)
+	{
+		const auto latest{latestSubmissions.find(result.material.value)};
+		if (latest == latestSubmissions.end() || latest->second.submission != result.submission)
+		{
+			continue;
+		}
+		if (result.compiled)
+		{
+			try
+			{
+				latest->second.material->apply(std::move(*result.compiled), app);
+			}
+			catch (const std::exception& e)
+			{
+				std::cerr << "Failed to apply material " << latest->second.material->getName() << ": " << e.what() << std::endl;
+			}
+		}
+		latestSubmissions.erase(latest);
+	}
+}
+
+void MaterialCompiler::reloadSources()
+{
+	std::lock_guard lock{mutex};
+	++sourceGeneration;
+}
+
+void MaterialCompiler::waitIdle()
+{
+	std::unique_lock lock{mutex};
+	idle.wait(lock, [this] { return tasks.empty() && runningTasks == 0; });
+}
+
+void MaterialCompiler::discardPending()
+{
+	waitIdle();
+	{
+		std::lock_guard lock{finishedMutex};
+		finished.clear();
+	}
+	latestSubmissions.clear();
+}
+
+uint32_t MaterialCompiler::getWorkerCount() const
+{
+	return static_cast<uint32_t>(threads.size());
+}
+
+void MaterialCompiler::runWorker()
+{
+	// Created on the worker, so the sessions of all workers are set up in parallel
+	SlangCompiler compiler{};
+	uint64_t loadedGeneration{0};
+
+	while (true)
+	{
+		std::unique_lock lock{mutex};
+		workAvailable.wait(lock, [this] { return stopping || !tasks.empty(); });
+		if (tasks.empty())
+		{
+			return;
+		}
+
+		std::packaged_task<void(const SlangCompiler&)> task{std::move(tasks.front())};
+		tasks.pop_front();
+		++runningTasks;
+		const uint64_t generation{sourceGeneration};
+		lock.unlock();
+
+		if (loadedGeneration != generation)
+		{
+			compiler.reloadSources();
+			loadedGeneration = generation;
+		}
+
+		// Stores exceptions in the future instead of throwing
+		task(compiler);
+
+		lock.lock();
+		--runningTasks;
+		if (tasks.empty() && runningTasks == 0)
+		{
+			idle.notify_all();
+		}
+	}
+}
+
+void MaterialCompiler::submit(std::packaged_task<void(const SlangCompiler&)>&& task)
+{
+	{
+		std::lock_guard lock{mutex};
+		tasks.push_back(std::move(task));
+	}
+	workAvailable.notify_one();
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "Asset/Material.hpp"
+#include "AssetSystem/AssetHandle.hpp"
+
+class Renderer;
+class SlangCompiler;
+
+// Compiles materials on worker threads, from Slang source to pipelines. Slang sessions are not thread safe, so every worker owns its own compiler
+// Compiled materials hold no objects of the worker's session, their reflection is copied into plain data
+// Materials are compiled in the order they were submitted
+class MaterialCompiler
+{
+public:
+	MaterialCompiler(const Renderer& app, uint32_t workerCount);
+	// Finishes the compiles already submitted before joining the workers
+	~MaterialCompiler();
+
+	MaterialCompiler(const MaterialCompiler&) = delete;
+	MaterialCompiler& operator=(const MaterialCompiler&) = delete;
+
+	// Queues the compile of material. It must neither be used nor destroyed before the future is ready. Exceptions of the compile are rethrown by the future
+	std::shared_future<void> compile(Material& material);
+
+	// Builds material on a worker while it keeps being drawn with its previous results, or the render queue's fallback before its first compile
+	// The results are applied by applyFinished. Failed compiles and refused results are reported and leave the material as it was. The handle keeps the material loaded until then
+	// Called on the main thread. A newer compile of the same material supersedes older ones that have not been applied yet
+	void compileAsync(const AssetHandle<Material>& material);
+	// Applies the results of the asynchronous compiles finished since the last call. Called on the main thread before the frame is recorded
+	void applyFinished();
+
+	// Blocks until every submitted compile has finished. Results of asynchronous ones are not applied
+	void waitIdle();
+	// Waits for the submitted compiles and drops the asynchronous results that were not applied, releasing their materials. Called before the asset manager is destroyed
+	void discardPending();
+
+	// Workers load all modules from disk again before their next compile. Called once shader sources have changed
+	void reloadSources();
+
+	[[nodiscard]] uint32_t getWorkerCount() const;
+
+private:
+	struct FinishedCompile
+	{
+		UUID material;
+		uint64_t submission;
+		std::optional<CompiledMaterial> compiled; // Empty if the compile failed
+	};
+
+	struct PendingCompile
+	{
+		AssetHandle<Material> material;
+		uint64_t submission;
+	};
+
+	const Renderer& app;
+	std::vector<std::thread> threads;
+
+	std::mutex mutex;
+	std::condition_variable workAvailable;
+	std::condition_variable idle;
+	std::deque<std::packaged_task<void(const SlangCompiler&)>> tasks;
+	uint32_t runningTasks{0};
+	uint64_t sourceGeneration{0}; // Incremented by reloadSources
+	bool stopping{false};
+
+	std::mutex finishedMutex;
+	std::vector<FinishedCompile> finished;
+
+	// Only used on the main thread
+	uint64_t submissionCount{0};
+	std::unordered_map<size_t, PendingCompile> latestSubmissions; // By UUID of the material
+
+	void submit(std::packaged_task<void(const SlangCompiler&)>&& task);
+
+	void runWorker();
+};
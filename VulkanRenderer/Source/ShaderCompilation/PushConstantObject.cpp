@@ -0,0 +1,74 @@
+#include "PushConstantObject.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include "Renderer.hpp"
+
+PushConstantObject::PushConstantObject(const std::shared_ptr<const ShaderTypeLayout>& typeLayout)
+	: ShaderObject(typeLayout)
+{
+}
+
+void PushConstantObject::write(const ShaderOffset& offset, const void* data, const size_t size)
+{
+	if (offset.byteOffset + size > maxSize)
+	{
+		throw std::runtime_error("Push constant write out of range");
+	}
+	std::memcpy(this->data.data() + offset.byteOffset, data, size);
+}
+
+void PushConstantObject::writeTexture(const ShaderOffset& offset, const TextureImage& texture)
+{
+	throw std::runtime_error("Push constants cannot hold textures");
+}
+
+void PushConstantObject::writeSampler(const ShaderOffset& offset, const TextureImage& texture)
+{
+	throw std::runtime_error("Push constants cannot hold samplers");
+}
+
+void PushConstantObject::writeBuffer(const ShaderOffset& offset, const Buffer& buffer)
+{
+	throw std::runtime_error("Push constants cannot hold buffers");
+}
+
+size_t PushConstantObject::existentialToByteOffset(const size_t& existentialObjectOffset)
+{
+	throw std::runtime_error("Push constants cannot hold existential objects");
+}
+
+size_t PushConstantObject::existentialToBindingOffset(const size_t& existentialObjectOffset)
+{
+	throw std::runtime_error("Push constants cannot hold existential objects");
+}
+
+void PushConstantObject::push(const vk::raii::CommandBuffer& commandBuffer, const vk::PipelineLayout& pipelineLayout, const vk::PushConstantRange& range) const
+{
+	commandBuffer.pushConstants<std::byte>(pipelineLayout, range.stageFlags, range.offset, vk::ArrayProxy<const std::byte>{range.size, data.data() + range.offset});
+}
+
+vk::PushConstantRange PushConstantObject::getRange(slang::VariableLayoutReflection* parameter, const vk::ShaderStageFlags stageFlags, const Renderer& app)
+{
+	if (parameter->getCategory() != slang::ParameterCategory::PushConstantBuffer)
+	{
+		throw std::runtime_error("Shader parameter " + std::string{parameter->getName()} + " is not a push constant buffer");
+	}
+
+	// Slang puts the only push constant buffer at offset 0
+	const vk::PushConstantRange range{stageFlags, 0, static_cast<uint32_t>(parameter->getTypeLayout()->getElementTypeLayout()->getSize())};
+	checkRange(range, parameter->getName(), app);
+	return range;
+}
+
+void PushConstantObject::checkRange(const vk::PushConstantRange& range, const std::string_view name, const Renderer& app)
+{
+	const size_t supportedSize{std::min<size_t>(app.physicalDevice.getProperties().limits.maxPushConstantsSize, maxSize)};
+	if (range.offset + range.size > supportedSize)
+	{
+		throw std::runtime_error("Push constants of " + std::string{name} + " are larger than the supported " + std::to_string(supportedSize) + " bytes");
+	}
+}
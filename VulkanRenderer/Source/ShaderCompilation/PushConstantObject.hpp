@@ -0,0 +1,41 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <string_view>
+
+#include "ShaderObject.hpp"
+#include "VulkanBackend.hpp"
+
+class Renderer;
+
+// Shader object whose ordinary data is recorded into the command buffer as push constants instead of living in a buffer
+// Data is kept inline, so filling and pushing it does not allocate
+class PushConstantObject : public ShaderObject
+{
+public:
+	// Largest push constant block we support. Vulkan guarantees 128 bytes, 256 is available on all desktop GPUs
+	static constexpr size_t maxSize{256};
+
+	explicit PushConstantObject(const std::shared_ptr<const ShaderTypeLayout>& typeLayout);
+
+	virtual void write(const ShaderOffset& offset, const void* data, size_t size) override;
+
+	virtual void writeTexture(const ShaderOffset& offset, const TextureImage& texture) override;
+	virtual void writeSampler(const ShaderOffset& offset, const TextureImage& texture) override;
+	virtual void writeBuffer(const ShaderOffset& offset, const Buffer& buffer) override;
+
+	virtual size_t existentialToByteOffset(const size_t& existentialObjectOffset) override;
+	virtual size_t existentialToBindingOffset(const size_t& existentialObjectOffset) override;
+
+	void push(const vk::raii::CommandBuffer& commandBuffer, const vk::PipelineLayout& pipelineLayout, const vk::PushConstantRange& range) const;
+
+	// Range of a [[vk::push_constant]] parameter from reflection. Throws if it does not fit into the device's limits
+	static vk::PushConstantRange getRange(slang::VariableLayoutReflection* parameter, vk::ShaderStageFlags stageFlags, const Renderer& app);
+	// Throws if the range of the named parameter does not fit into the device's limits. For ranges that were not just read from reflection
+	static void checkRange(const vk::PushConstantRange& range, std::string_view name, const Renderer& app);
+
+private:
+	std::array<std::byte, maxSize> data{};
+};
@@ -5,11 +5,27 @@
 #include "ShaderCursor.hpp"
 
 #include <iostream>
+#include <stdexcept>
+#include <string>
 
-#include "Debug/SlangDebug.hpp"
+static void printType(const ShaderTypeLayout& layout, const uint32_t type, const size_t indent)
+{
+	const ShaderTypeLayout::Type& description{layout.getType(type)};
+	std::cout << "size " << description.size << " stride " << description.stride << '\n';
+	if (description.elementType)
+	{
+		std::cout << std::string(indent + 2, ' ') << '[' << description.elementCount << "]: ";
+		printType(layout, *description.elementType, indent + 2);
+	}
+	for (const ShaderTypeLayout::Field& field : description.fields)
+	{
+		std::cout << std::string(indent + 2, ' ') << field.name << " @ " << field.byteOffset << '/' << field.bindingRangeOffset << ": ";
+		printType(layout, field.type, indent + 2);
+	}
+}
 
 ShaderCursor::ShaderCursor(ShaderObject* shaderObject)
-	: shaderObject(shaderObject), typeLayout(shaderObject->typeLayout)
+	: shaderObject(shaderObject)
 {
 }
 
@@ -28,28 +44,30 @@ void ShaderCursor::writeSampler(const TextureImage& texture)
 	shaderObject->writeSampler(offset, texture);
 }
 
+void ShaderCursor::writeBuffer(const Buffer& buffer)
+{
+	shaderObject->writeBuffer(offset, buffer);
+}
+
 ShaderCursor ShaderCursor::field(const char* name) const
 {
-	return field(typeLayout->findFieldIndexByName(name));
+	return field(shaderObject->typeLayout->findFieldIndex(type, name));
 }
 
 ShaderCursor ShaderCursor::field(uint32_t index) const
 {
-	slang::VariableLayoutReflection* field{typeLayout->getFieldByIndex(index)};
+	const ShaderTypeLayout::Field& field{shaderObject->typeLayout->getType(type).fields.at(index)};
 	ShaderCursor result{*this};
-	if (field->getTypeLayout()->getKind() == slang::TypeReflection::Kind::Interface)
+	result.type = field.type;
+	if (field.existentialObject)
 	{
-		// TODO: All of this is bad architecture
-		const size_t existentialObjectOffset{field->getOffset(SLANG_PARAMETER_CATEGORY_EXISTENTIAL_OBJECT_PARAM)};
-		result.typeLayout = field->getTypeLayout()->getPendingDataTypeLayout();
-		result.offset.byteOffset = shaderObject->existentialToByteOffset(existentialObjectOffset);
-		result.offset.bindingIndex = shaderObject->existentialToBindingOffset(existentialObjectOffset);
+		result.offset.byteOffset = shaderObject->existentialToByteOffset(*field.existentialObject);
+		result.offset.bindingIndex = shaderObject->existentialToBindingOffset(*field.existentialObject);
 	}
 	else
 	{
-		result.typeLayout = field->getTypeLayout();
-		result.offset.byteOffset += field->getOffset();
-		result.offset.bindingIndex += typeLayout->getFieldBindingRangeOffset(index);
+		result.offset.byteOffset += field.byteOffset;
+		result.offset.bindingIndex += field.bindingRangeOffset;
 	}
 	return result;
 }
@@ -61,13 +79,17 @@ ShaderCursor ShaderCursor::field(const std::string_view& name) const
 
 ShaderCursor ShaderCursor::element(uint32_t index) const
 {
-	slang::TypeLayoutReflection* element{typeLayout->getElementTypeLayout()};
+	const ShaderTypeLayout::Type& array{shaderObject->typeLayout->getType(type)};
+	if (!array.elementType)
+	{
+		throw std::runtime_error("Shader type is not an array");
+	}
 
 	ShaderCursor result = *this;
-	result.typeLayout = element;
-	result.offset.byteOffset += index * element->getStride();
+	result.type = *array.elementType;
+	result.offset.byteOffset += index * shaderObject->typeLayout->getType(*array.elementType).stride;
 
-	result.offset.bindingArrayElement *= typeLayout->getElementCount();
+	result.offset.bindingArrayElement *= static_cast<uint32_t>(array.elementCount);
 	result.offset.bindingArrayElement += index;
 
 	return result;
@@ -80,7 +102,6 @@ const ShaderOffset& ShaderCursor::getOffset() const
 
 void ShaderCursor::printLayout() const
 {
-	SlangDebug::SlangPrinter printer{};
-	printer << typeLayout;
-	std::cout << printer << std::endl;
+	printType(*shaderObject->typeLayout, type, 0);
+	std::cout << std::flush;
 }
@@ -1,7 +1,6 @@
 ﻿#pragma once
 #include <span>
 #include <string_view>
-#include <slang/slang.h>
 #include <vulkan/vulkan_raii.hpp>
 
 #include "ShaderObject.hpp"
@@ -17,6 +16,7 @@ public:
 
 	void writeTexture(const TextureImage& texture);
 	void writeSampler(const TextureImage& texture);
+	void writeBuffer(const Buffer& buffer);
 
 	template <typename T>
 	void write(const std::span<T>& data);
@@ -38,7 +38,8 @@ private:
 	ShaderObject* shaderObject;
 	ShaderOffset offset{};
 
-	slang::TypeLayoutReflection* typeLayout;
+	// Index into the type layout of the shader object
+	uint32_t type{ShaderTypeLayout::getRootType()};
 };
 
 template <typename T>
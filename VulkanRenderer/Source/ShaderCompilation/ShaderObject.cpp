@@ -4,7 +4,7 @@
 
 #include "ShaderObject.hpp"
 
-ShaderObject::ShaderObject(slang::TypeLayoutReflection *typeLayout)
+ShaderObject::ShaderObject(const std::shared_ptr<const ShaderTypeLayout>& typeLayout)
     : typeLayout(typeLayout)
 {
 }
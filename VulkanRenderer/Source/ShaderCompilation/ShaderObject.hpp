@@ -1,9 +1,10 @@
 ﻿#pragma once
 
+#include <memory>
 #include <span>
-#include <slang/slang.h>
 
 #include "ShaderOffset.hpp"
+#include "ShaderTypeLayout.hpp"
 
 class TextureImage;
 class Buffer;
@@ -15,6 +16,7 @@ public:
 
 	virtual void writeTexture(const ShaderOffset& offset, const TextureImage& texture) = 0;
 	virtual void writeSampler(const ShaderOffset& offset, const TextureImage& texture) = 0;
+	virtual void writeBuffer(const ShaderOffset& offset, const Buffer& buffer) = 0;
 
 	virtual size_t existentialToByteOffset(const size_t& existentialObjectOffset) = 0;
 	virtual size_t existentialToBindingOffset(const size_t& existentialObjectOffset) = 0;
@@ -27,10 +29,10 @@ public:
 
 	virtual ~ShaderObject() = default;
 
-	slang::TypeLayoutReflection* typeLayout;
+	std::shared_ptr<const ShaderTypeLayout> typeLayout;
 
 protected:
-	explicit ShaderObject(slang::TypeLayoutReflection* typeLayout);
+	explicit ShaderObject(const std::shared_ptr<const ShaderTypeLayout>& typeLayout);
 };
 
 template <typename T>
@@ -7,4 +7,6 @@ struct ShaderOffset
 	size_t byteOffset{0};
 	uint32_t bindingIndex{0};
 	uint32_t bindingArrayElement{0};
+
+	bool operator==(const ShaderOffset&) const = default;
 };
@@ -0,0 +1,82 @@
+#include "ShaderTypeLayout.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+ShaderTypeLayout::ShaderTypeLayout(slang::TypeLayoutReflection* typeLayout)
+{
+	addType(typeLayout);
+}
+
+ShaderTypeLayout::ShaderTypeLayout(std::vector<Type>&& types)
+	: types(std::move(types))
+{
+	if (this->types.empty())
+	{
+		throw std::runtime_error("Shader type layout is empty");
+	}
+
+	const auto isValid{[this](const uint32_t type) { return type < this->types.size(); }};
+	for (const Type& type : this->types)
+	{
+		if ((type.elementType && !isValid(*type.elementType)) || !std::ranges::all_of(type.fields, isValid, &Field::type))
+		{
+			throw std::runtime_error("Shader type layout refers to a type it does not contain");
+		}
+	}
+}
+
+const ShaderTypeLayout::Type& ShaderTypeLayout::getType(const uint32_t type) const
+{
+	return types[type];
+}
+
+const std::vector<ShaderTypeLayout::Type>& ShaderTypeLayout::getTypes() const
+{
+	return types;
+}
+
+uint32_t ShaderTypeLayout::findFieldIndex(const uint32_t type, const std::string_view name) const
+{
+	const std::vector<Field>& fields{types[type].fields};
+	const auto field{std::ranges::find(fields, name, &Field::name)};
+	if (field == fields.end())
+	{
+		throw std::runtime_error("Shader type has no field " + std::string{name});
+	}
+	return static_cast<uint32_t>(field - fields.begin());
+}
+
+uint32_t ShaderTypeLayout::addType(slang::TypeLayoutReflection* typeLayout)
+{
+	const uint32_t index{static_cast<uint32_t>(types.size())};
+	types.push_back({typeLayout ? typeLayout->getSize() : 0, typeLayout ? typeLayout->getStride() : 0, 0, std::nullopt, {}});
+	// Interfaces that were not specialized have no pending data
+	if (!typeLayout)
+	{
+		return index;
+	}
+
+	// Types are appended while this one is filled in, so it is only accessed by index
+	if (typeLayout->getKind() == slang::TypeReflection::Kind::Array)
+	{
+		types[index].elementCount = typeLayout->getElementCount();
+		const uint32_t elementType{addType(typeLayout->getElementTypeLayout())};
+		types[index].elementType = elementType;
+	}
+	for (unsigned i = 0; i < typeLayout->getFieldCount(); ++i)
+	{
+		slang::VariableLayoutReflection* field{typeLayout->getFieldByIndex(i)};
+		slang::TypeLayoutReflection* fieldType{field->getTypeLayout()};
+		Field description{field->getName() ? field->getName() : "", 0, field->getOffset(), static_cast<uint32_t>(typeLayout->getFieldBindingRangeOffset(i)), std::nullopt};
+		if (fieldType->getKind() == slang::TypeReflection::Kind::Interface)
+		{
+			// TODO: All of this is bad architecture
+			description.existentialObject = field->getOffset(SLANG_PARAMETER_CATEGORY_EXISTENTIAL_OBJECT_PARAM);
+			fieldType = fieldType->getPendingDataTypeLayout();
+		}
+		description.type = addType(fieldType);
+		types[index].fields.push_back(std::move(description));
+	}
+	return index;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <slang/slang.h>
+
+// Reflection of a type as ShaderCursor walks it, copied out of Slang once
+// Plain data, so cursors never touch a session and the SPIR-V cache can store it with the code
+class ShaderTypeLayout
+{
+public:
+	struct Field
+	{
+		std::string name;
+		uint32_t type; // Index into the types of the layout
+		size_t byteOffset;
+		uint32_t bindingRangeOffset;
+		// Interface fields only. Their data is the pending data of this existential object, which lives at the end of the block
+		std::optional<size_t> existentialObject;
+
+		bool operator==(const Field&) const = default;
+	};
+
+	struct Type
+	{
+		size_t size;
+		size_t stride;
+		// Arrays only
+		size_t elementCount;
+		std::optional<uint32_t> elementType;
+		std::vector<Field> fields;
+
+		bool operator==(const Type&) const = default;
+	};
+
+	// Reads the type and everything it contains
+	explicit ShaderTypeLayout(slang::TypeLayoutReflection* typeLayout);
+	// Throws if a type index is out of range
+	explicit ShaderTypeLayout(std::vector<Type>&& types);
+
+	// The type the layout was created from comes first
+	[[nodiscard]] static constexpr uint32_t getRootType()
+	{
+		return 0;
+	}
+	[[nodiscard]] const Type& getType(uint32_t type) const;
+	[[nodiscard]] const std::vector<Type>& getTypes() const;
+	// Throws if there is no field of that name
+	[[nodiscard]] uint32_t findFieldIndex(uint32_t type, std::string_view name) const;
+
+	bool operator==(const ShaderTypeLayout&) const = default;
+
+private:
+	std::vector<Type> types;
+
+	uint32_t addType(slang::TypeLayoutReflection* typeLayout);
+};
@@ -0,0 +1,160 @@
+#include "ShaderWatcher.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+static bool isShaderFile(const std::filesystem::path& path)
+{
+	return path.extension() == ".slang";
+}
+
+static void addUnique(std::vector<std::filesystem::path>& paths, const std::filesystem::path& path)
+{
+	std::error_code error;
+	std::filesystem::path canonicalPath{std::filesystem::weakly_canonical(path, error)};
+	if (error)
+	{
+		canonicalPath = path;
+	}
+	if (std::ranges::find(paths, canonicalPath) == paths.end())
+	{
+		paths.push_back(std::move(canonicalPath));
+	}
+}
+
+#ifdef __linux__
+
+ShaderWatcher::ShaderWatcher(const std::vector<std::filesystem::path>& directories)
+	: inotifyDescriptor(inotify_init1(IN_NONBLOCK | IN_CLOEXEC))
+{
+	if (inotifyDescriptor < 0)
+	{
+		// Shaders can still be recompiled by restarting
+		std::cerr << "Failed to watch the shader directories, changed shaders are not recompiled" << std::endl;
+		return;
+	}
+
+	for (const std::filesystem::path& directory : directories)
+	{
+		watchDirectory(directory);
+	}
+}
+
+ShaderWatcher::~ShaderWatcher()
+{
+	if (inotifyDescriptor >= 0)
+	{
+		close(inotifyDescriptor);
+	}
+}
+
+std::vector<std::filesystem::path> ShaderWatcher::poll()
+{
+	std::vector<std::filesystem::path> changedFiles{};
+	if (inotifyDescriptor < 0)
+	{
+		return changedFiles;
+	}
+
+	alignas(inotify_event) char buffer[4096];
+	while (true)
+	{
+		const ssize_t length{read(inotifyDescriptor, buffer, sizeof(buffer))};
+		if (length <= 0)
+		{
+			// EAGAIN once all pending events have been read
+			break;
+		}
+
+		for (ssize_t offset = 0; offset < length;)
+		{
+			const auto* event{reinterpret_cast<const inotify_event*>(buffer + offset)};
+			offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+
+			const auto directory{watchedDirectories.find(event->wd)};
+			if (directory == watchedDirectories.end() || event->len == 0)
+			{
+				continue;
+			}
+
+			const std::filesystem::path path{directory->second / event->name};
+			if (event->mask & IN_ISDIR)
+			{
+				watchDirectory(path);
+			}
+			// Created files are still empty. Their contents are reported once written
+			else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO) && isShaderFile(path))
+			{
+				addUnique(changedFiles, path);
+			}
+		}
+	}
+	return changedFiles;
+}
+
+void ShaderWatcher::watchDirectory(const std::filesystem::path& directory)
+{
+	// Editors often save by writing another file and moving it over the original. Creation is only watched for new directories
+	const int watchDescriptor{inotify_add_watch(inotifyDescriptor, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_ONLYDIR)};
+	if (watchDescriptor < 0)
+	{
+		return;
+	}
+	watchedDirectories[watchDescriptor] = directory;
+
+	std::error_code error;
+	for (const auto& entry : std::filesystem::directory_iterator{directory, error})
+	{
+		if (entry.is_directory())
+		{
+			watchDirectory(entry.path());
+		}
+	}
+}
+
+#else
+
+ShaderWatcher::ShaderWatcher(const std::vector<std::filesystem::path>& directories)
+	: directories(directories)
+{
+	scan();
+}
+
+ShaderWatcher::~ShaderWatcher() = default;
+
+std::vector<std::filesystem::path> ShaderWatcher::poll()
+{
+	return scan();
+}
+
+std::vector<std::filesystem::path> ShaderWatcher::scan()
+{
+	std::vector<std::filesystem::path> changedFiles{};
+	for (const std::filesystem::path& directory : directories)
+	{
+		std::error_code error;
+		for (const auto& entry : std::filesystem::recursive_directory_iterator{directory, error})
+		{
+			if (!entry.is_regular_file() || !isShaderFile(entry.path()))
+			{
+				continue;
+			}
+
+			const std::filesystem::file_time_type writeTime{entry.last_write_time(error)};
+			const auto [previous, inserted]{writeTimes.try_emplace(entry.path(), writeTime)};
+			if (!inserted && previous->second != writeTime)
+			{
+				previous->second = writeTime;
+				addUnique(changedFiles, entry.path());
+			}
+		}
+	}
+	return changedFiles;
+}
+
+#endif
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <filesystem>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+// Reports shader source files that were written, so the materials importing them can be recompiled
+// Uses inotify on Linux. Other platforms compare the write times of all shader files on every poll
+class ShaderWatcher
+{
+public:
+	// Watches the directories and all of their subdirectories, including ones created later
+	explicit ShaderWatcher(const std::vector<std::filesystem::path>& directories);
+	~ShaderWatcher();
+
+	ShaderWatcher(const ShaderWatcher&) = delete;
+	ShaderWatcher& operator=(const ShaderWatcher&) = delete;
+
+	// Canonical paths of the .slang files written since the last call, without duplicates. Never blocks
+	[[nodiscard]] std::vector<std::filesystem::path> poll();
+
+private:
+#ifdef __linux__
+	int inotifyDescriptor{-1};
+	std::unordered_map<int, std::filesystem::path> watchedDirectories; // By watch descriptor
+
+	void watchDirectory(const std::filesystem::path& directory);
+#else
+	std::vector<std::filesystem::path> directories;
+	std::map<std::filesystem::path, std::filesystem::file_time_type> writeTimes;
+
+	// Records the current write times and returns the files whose time changed. Files seen for the first time do not count as changed
+	std::vector<std::filesystem::path> scan();
+#endif
+};
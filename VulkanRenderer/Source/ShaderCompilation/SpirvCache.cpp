@@ -0,0 +1,319 @@
+#include "SpirvCache.hpp"
+
+#include <algorithm>
+#include <format>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <ranges>
+#include <stdexcept>
+#include <type_traits>
+
+#include "ShaderCompiler.hpp"
+
+static constexpr uint32_t entryMagic{0x43565053}; // "SPVC"
+static constexpr uint32_t entryVersion{2};
+
+// FNV-1a. Only has to tell versions of the same inputs apart, the full key is stored in the entry to rule out collisions
+static uint64_t hashBytes(const std::string_view bytes)
+{
+	uint64_t hash{0xcbf29ce484222325};
+	for (const char byte : bytes)
+	{
+		hash ^= static_cast<uint8_t>(byte);
+		hash *= 0x100000001b3;
+	}
+	return hash;
+}
+
+static std::optional<std::string> readFile(const std::filesystem::path& path)
+{
+	std::ifstream file{path, std::ios::binary};
+	if (!file)
+	{
+		return std::nullopt;
+	}
+	return std::string{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+}
+
+template <typename T> requires std::is_trivially_copyable_v<T>
+static bool readValue(std::ifstream& file, T& value)
+{
+	return static_cast<bool>(file.read(reinterpret_cast<char*>(&value), sizeof(T)));
+}
+
+template <typename T> requires std::is_trivially_copyable_v<T>
+static void writeValue(std::ofstream& file, const T& value)
+{
+	file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+static bool readValue(std::ifstream& file, std::string& value)
+{
+	uint32_t size;
+	if (!readValue(file, size))
+	{
+		return false;
+	}
+	value.resize(size);
+	return static_cast<bool>(file.read(value.data(), size));
+}
+
+static void writeValue(std::ofstream& file, const std::string_view value)
+{
+	writeValue(file, static_cast<uint32_t>(value.size()));
+	file.write(value.data(), static_cast<std::streamsize>(value.size()));
+}
+
+template <typename T>
+static bool readValue(std::ifstream& file, std::optional<T>& value)
+{
+	bool hasValue;
+	if (!readValue(file, hasValue))
+	{
+		return false;
+	}
+	value = hasValue ? std::optional<T>{T{}} : std::nullopt;
+	return !hasValue || readValue(file, *value);
+}
+
+template <typename T>
+static void writeValue(std::ofstream& file, const std::optional<T>& value)
+{
+	writeValue(file, value.has_value());
+	if (value)
+	{
+		writeValue(file, *value);
+	}
+}
+
+// Elements are read one by one. Only used for the small vectors of the reflection, code is read as a whole
+template <typename T, typename ReadElement>
+static bool readVector(std::ifstream& file, std::vector<T>& values, ReadElement&& readElement)
+{
+	uint32_t count;
+	if (!readValue(file, count))
+	{
+		return false;
+	}
+	values.resize(count);
+	return std::ranges::all_of(values, [&](T& value) { return readElement(file, value); });
+}
+
+template <typename T, typename WriteElement>
+static void writeVector(std::ofstream& file, const std::vector<T>& values, WriteElement&& writeElement)
+{
+	writeValue(file, static_cast<uint32_t>(values.size()));
+	for (const T& value : values)
+	{
+		writeElement(file, value);
+	}
+}
+
+static bool readTypeLayout(std::ifstream& file, std::shared_ptr<const ShaderTypeLayout>& typeLayout)
+{
+	std::vector<ShaderTypeLayout::Type> types{};
+	const bool read{readVector(file, types, [](std::ifstream& file, ShaderTypeLayout::Type& type)
+	{
+		return readValue(file, type.size) && readValue(file, type.stride) && readValue(file, type.elementCount) && readValue(file, type.elementType) &&
+			readVector(file, type.fields, [](std::ifstream& file, ShaderTypeLayout::Field& field)
+			{
+				return readValue(file, field.name) && readValue(file, field.type) && readValue(file, field.byteOffset) && readValue(file, field.bindingRangeOffset) &&
+					readValue(file, field.existentialObject);
+			});
+	})};
+	if (!read)
+	{
+		return false;
+	}
+
+	// Throws on type indices out of range, which only a damaged entry can have
+	try
+	{
+		typeLayout = std::make_shared<const ShaderTypeLayout>(std::move(types));
+		return true;
+	}
+	catch (const std::runtime_error&)
+	{
+		return false;
+	}
+}
+
+static void writeTypeLayout(std::ofstream& file, const ShaderTypeLayout& typeLayout)
+{
+	writeVector(file, typeLayout.getTypes(), [](std::ofstream& file, const ShaderTypeLayout::Type& type)
+	{
+		writeValue(file, type.size);
+		writeValue(file, type.stride);
+		writeValue(file, type.elementCount);
+		writeValue(file, type.elementType);
+		writeVector(file, type.fields, [](std::ofstream& file, const ShaderTypeLayout::Field& field)
+		{
+			writeValue(file, field.name);
+			writeValue(file, field.type);
+			writeValue(file, field.byteOffset);
+			writeValue(file, field.bindingRangeOffset);
+			writeValue(file, field.existentialObject);
+		});
+	});
+}
+
+static bool readLayout(std::ifstream& file, ShaderObjectLayoutReflection& layout)
+{
+	const auto readElement{[](std::ifstream& file, auto& value) { return readValue(file, value); }};
+	return readTypeLayout(file, layout.typeLayout) && readValue(file, layout.setIndex) && readValue(file, layout.ordinaryDataSize) &&
+		readVector(file, layout.existentialObjectOffsets, readElement) && readVector(file, layout.resourceBindings, readElement);
+}
+
+static void writeLayout(std::ofstream& file, const ShaderObjectLayoutReflection& layout)
+{
+	const auto writeElement{[](std::ofstream& file, const auto& value) { writeValue(file, value); }};
+	writeTypeLayout(file, *layout.typeLayout);
+	writeValue(file, layout.setIndex);
+	writeValue(file, layout.ordinaryDataSize);
+	writeVector(file, layout.existentialObjectOffsets, writeElement);
+	writeVector(file, layout.resourceBindings, writeElement);
+}
+
+SpirvCache::SpirvCache(const std::optional<std::filesystem::path>& directory)
+	: directory(directory)
+{
+}
+
+std::string SpirvCache::makeKey(const std::span<const std::string> moduleNames, const std::span<const std::string> specializationArgs, const SlangCompiler& compiler)
+{
+	std::string key{compiler.describeOptions()};
+	for (const std::string& moduleName : moduleNames)
+	{
+		key += "\nmodule " + moduleName;
+	}
+	for (const std::string& argument : specializationArgs)
+	{
+		key += "\nargument " + argument;
+	}
+	return key;
+}
+
+std::optional<SpirvCache::Entry> SpirvCache::load(const std::string& key) const
+{
+	if (!directory)
+	{
+		return std::nullopt;
+	}
+
+	std::ifstream file{getEntryPath(key), std::ios::binary};
+	uint32_t magic, version;
+	std::string storedKey;
+	if (!file || !readValue(file, magic) || !readValue(file, version) || magic != entryMagic || version != entryVersion || !readValue(file, storedKey) || storedKey != key)
+	{
+		return std::nullopt;
+	}
+
+	// Checked before anything else is read, as entries of changed sources are the common miss
+	Entry entry{};
+	const bool sourcesUnchanged{readVector(file, entry.sourceFiles, [](std::ifstream& file, std::filesystem::path& path)
+	{
+		std::string pathString;
+		uint64_t hash;
+		if (!readValue(file, pathString) || !readValue(file, hash))
+		{
+			return false;
+		}
+		path = pathString;
+		const std::optional<std::string> contents{readFile(path)};
+		return contents && hashBytes(*contents) == hash;
+	})};
+	if (!sourcesUnchanged)
+	{
+		return std::nullopt;
+	}
+
+	const bool codeRead{readVector(file, entry.entryPointCode, [](std::ifstream& file, std::vector<uint32_t>& code)
+	{
+		uint32_t wordCount;
+		if (!readValue(file, wordCount))
+		{
+			return false;
+		}
+		code.resize(wordCount);
+		return static_cast<bool>(file.read(reinterpret_cast<char*>(code.data()), static_cast<std::streamsize>(wordCount * sizeof(uint32_t))));
+	})};
+	if (!codeRead || !readVector(file, entry.layouts, readLayout) || !readValue(file, entry.pushConstantRange) || !readValue(file, entry.drawInstanceOffset))
+	{
+		return std::nullopt;
+	}
+	return entry;
+}
+
+void SpirvCache::store(const std::string& key, const Entry& entry, const SlangCompiler& compiler) const
+{
+	if (!directory)
+	{
+		return;
+	}
+
+	// Hashed as they are on disk, which is what load compares against. A file edited since the session loaded it would pair the new hash with the old code
+	std::vector<uint64_t> sourceHashes{};
+	sourceHashes.reserve(entry.sourceFiles.size());
+	for (const std::filesystem::path& sourceFile : entry.sourceFiles)
+	{
+		const std::optional<std::string> contents{readFile(sourceFile)};
+		if (!contents || compiler.getLoadedSource(sourceFile) != contents)
+		{
+			return;
+		}
+		sourceHashes.push_back(hashBytes(*contents));
+	}
+
+	const std::filesystem::path entryPath{getEntryPath(key)};
+	// Unique per writer, so processes storing the same entry at the same time do not write into each other's files
+	std::filesystem::path temporaryPath{entryPath};
+	temporaryPath += std::format(".{:08x}.tmp", std::random_device{}());
+
+	std::error_code error;
+	std::filesystem::create_directories(*directory, error);
+	{
+		std::ofstream file{temporaryPath, std::ios::binary};
+		if (!file)
+		{
+			return;
+		}
+
+		writeValue(file, entryMagic);
+		writeValue(file, entryVersion);
+		writeValue(file, key);
+		writeValue(file, static_cast<uint32_t>(entry.sourceFiles.size()));
+		for (const auto& [sourceFile, hash] : std::views::zip(entry.sourceFiles, sourceHashes))
+		{
+			writeValue(file, sourceFile.string());
+			writeValue(file, hash);
+		}
+		writeVector(file, entry.entryPointCode, [](std::ofstream& file, const std::vector<uint32_t>& code)
+		{
+			writeValue(file, static_cast<uint32_t>(code.size()));
+			file.write(reinterpret_cast<const char*>(code.data()), static_cast<std::streamsize>(code.size() * sizeof(uint32_t)));
+		});
+		writeVector(file, entry.layouts, writeLayout);
+		writeValue(file, entry.pushConstantRange);
+		writeValue(file, entry.drawInstanceOffset);
+
+		if (!file.flush())
+		{
+			file.close();
+			std::filesystem::remove(temporaryPath, error);
+			return;
+		}
+	}
+
+	// Replaces an existing entry atomically. Readers either open the old file or the new one
+	std::filesystem::rename(temporaryPath, entryPath, error);
+	if (error)
+	{
+		std::filesystem::remove(temporaryPath, error);
+	}
+}
+
+std::filesystem::path SpirvCache::getEntryPath(const std::string& key) const
+{
+	return *directory / std::format("{:016x}.spvcache", hashBytes(key));
+}
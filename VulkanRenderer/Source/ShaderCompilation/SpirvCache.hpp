@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "ShaderOffset.hpp"
+#include "VulkanShaderObjectLayout.hpp"
+
+class SlangCompiler;
+
+// Compiled SPIR-V and reflection on disk. Entries are never modified, only replaced as a whole
+// Several processes may share the directory. Entries are written to a temporary file first and renamed into place, so readers never see partial ones
+// A hit holds everything the pipelines and layouts of a program are created from, so no Slang module is loaded for it
+class SpirvCache
+{
+public:
+	struct Entry
+	{
+		std::vector<std::vector<uint32_t>> entryPointCode;
+		// Parameter blocks of the program in set order
+		std::vector<ShaderObjectLayoutReflection> layouts;
+		vk::PushConstantRange pushConstantRange{};
+		// Offset of the instanceOffset field of the push constants, which is written on recording threads without a cursor
+		ShaderOffset drawInstanceOffset{};
+		// Canonical paths of the source files of the modules and everything they import. The entry is only valid while none of them changes on disk
+		std::vector<std::filesystem::path> sourceFiles;
+	};
+
+	// Disabled without a directory. Every lookup misses and nothing is stored
+	explicit SpirvCache(const std::optional<std::filesystem::path>& directory);
+
+	// Describes the modules, the specialization arguments and the compiler options. Built without loading anything, so it can be looked up before compiling
+	// The sources are not part of it, an entry stores the files it was compiled from instead
+	[[nodiscard]] static std::string makeKey(std::span<const std::string> moduleNames, std::span<const std::string> specializationArgs, const SlangCompiler& compiler);
+
+	// Entry stored under key. Empty if there is none, it is unreadable, or one of its source files is missing or differs on disk from the one it was compiled from
+	[[nodiscard]] std::optional<Entry> load(const std::string& key) const;
+	// Hashes the source files as they are on disk now. Nothing is stored if one of them changed since the compiler's session loaded it, as the code would not match
+	// Failing to write is not an error, the program is compiled again next time
+	void store(const std::string& key, const Entry& entry, const SlangCompiler& compiler) const;
+
+private:
+	std::optional<std::filesystem::path> directory;
+
+	[[nodiscard]] std::filesystem::path getEntryPath(const std::string& key) const;
+};
@@ -1,5 +1,11 @@
 ﻿#include "VulkanShaderObject.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <ranges>
+#include <stdexcept>
+
 #include "Buffer.hpp"
 #include "Renderer.hpp"
 #include "ShaderCursor.hpp"
@@ -13,42 +19,53 @@ VulkanShaderObject::VulkanShaderObject(const std::shared_ptr<VulkanShaderObjectL
 
 void VulkanShaderObject::write(const ShaderOffset& offset, const void* data, size_t size)
 {
-	if (!buffer)
+	if (!uniformData)
 	{
 		return;
 	}
-	Buffer::copySpanToBufferStaged(app, std::span{static_cast<const std::byte*>(data), size}, *buffer, offset.byteOffset); // TODO: Support non-staged buffers
+	std::memcpy(ordinaryData.data() + offset.byteOffset, data, size);
+
+	// Frames in flight may still read their copies, so every copy is updated once its frame is recorded again
+	for (std::vector<DirtyRange>& frameRanges : dirtyRanges)
+	{
+		addDirtyRange(frameRanges, {offset.byteOffset, offset.byteOffset + size});
+	}
+	std::atomic_ref{staleFrames}.store((1u << app.maxFramesInFlight) - 1);
 }
 
 void VulkanShaderObject::writeTexture(const ShaderOffset& offset, const TextureImage& texture)
 {
-	const uint32_t bindingIndex = offset.bindingIndex; //typeLayout->getBindingRangeIndexOffset(offset.bindingIndex);
-
-	vk::DescriptorImageInfo image{texture.sampler, texture.imageView, vk::ImageLayout::eShaderReadOnlyOptimal}; // TODO: Sampler is right now here and in the sampler. TODO: Is this always the correct layout?
-
-	std::vector<vk::WriteDescriptorSet> descriptorWrites{};
-	descriptorWrites.reserve(descriptorSets.size());
-	for (const auto& descriptorSet : descriptorSets)
+	const uint32_t bindingIndex = layout->getDescriptorBinding(offset.bindingIndex); //typeLayout->getBindingRangeIndexOffset(offset.bindingIndex);
+	// Textures are often written again every frame. The descriptors only change with the texture
+	const auto existing{std::ranges::find_if(textures, [&](const TextureBinding& binding) { return binding.binding == bindingIndex && binding.arrayElement == offset.bindingArrayElement; })};
+	if (existing == textures.end())
+	{
+		textures.emplace_back(bindingIndex, offset.bindingArrayElement, texture.data, std::vector<uint64_t>(descriptorSets.size(), 0));
+	}
+	else if (existing->texture != texture.data)
 	{
-		descriptorWrites.emplace_back(descriptorSet, bindingIndex, offset.bindingArrayElement, 1,
-									  vk::DescriptorType::eCombinedImageSampler/* TODO: VulkanShaderObjectLayout::mapDescriptorType(typeLayout->getBindingRangeType(bindingIndex))*/, &image);
+		existing->texture = texture.data;
+		std::ranges::fill(existing->writtenGenerations, 0);
 	}
-	app.device.updateDescriptorSets(descriptorWrites, nullptr);
 }
 
 void VulkanShaderObject::writeSampler(const ShaderOffset& offset, const TextureImage& texture)
 {
-	const uint32_t bindingIndex = offset.bindingIndex; //typeLayout->getBindingRangeIndexOffset(offset.bindingIndex);
+	const uint32_t bindingIndex = layout->getDescriptorBinding(offset.bindingIndex); //typeLayout->getBindingRangeIndexOffset(offset.bindingIndex);
+	recordWrite({bindingIndex, offset.bindingArrayElement, layout->getDescriptorType(bindingIndex), vk::DescriptorImageInfo{texture.data->sampler}, {}, 0});
+}
 
-	vk::DescriptorImageInfo image{texture.sampler};
+void VulkanShaderObject::writeBuffer(const ShaderOffset& offset, const Buffer& buffer)
+{
+	const uint32_t bindingIndex = layout->getDescriptorBinding(offset.bindingIndex);
+	const vk::DescriptorType descriptorType{layout->getDescriptorType(bindingIndex)};
 
-	std::vector<vk::WriteDescriptorSet> descriptorWrites{};
-	descriptorWrites.reserve(descriptorSets.size());
-	for (const auto& descriptorSet : descriptorSets)
+	// Texel buffers would need a buffer view of a format
+	if (descriptorType != vk::DescriptorType::eStorageBuffer && descriptorType != vk::DescriptorType::eUniformBuffer)
 	{
-		descriptorWrites.emplace_back(descriptorSet, bindingIndex, offset.bindingArrayElement, 1, VulkanShaderObjectLayout::mapDescriptorType(typeLayout->getBindingRangeType(bindingIndex)), &image);
+		throw std::runtime_error("Buffers cannot be written to descriptors of type " + vk::to_string(descriptorType));
 	}
-	app.device.updateDescriptorSets(descriptorWrites, {});
+	recordWrite({bindingIndex, offset.bindingArrayElement, descriptorType, {}, vk::DescriptorBufferInfo{buffer.vkBuffer, 0, vk::WholeSize}, 0});
 }
 
 size_t VulkanShaderObject::existentialToByteOffset(const size_t& existentialObjectOffset)
@@ -66,48 +83,164 @@ const std::vector<vk::raii::DescriptorSet>& VulkanShaderObject::getDescriptorSet
 	return descriptorSets;
 }
 
+const VulkanShaderObjectLayout& VulkanShaderObject::getLayout() const
+{
+	return *layout;
+}
+
+void VulkanShaderObject::bind(const vk::raii::CommandBuffer& commandBuffer, const vk::PipelineBindPoint bindPoint, const vk::PipelineLayout pipelineLayout, const uint32_t setIndex,
+                              const uint32_t frameIndex) const
+{
+	if (!uniformData)
+	{
+		commandBuffer.bindDescriptorSets(bindPoint, pipelineLayout, setIndex, *descriptorSets[frameIndex], nullptr);
+		return;
+	}
+
+	// Whoever clears the bit copies. Everything is copied before the frame is submitted, so other threads may bind right away
+	const uint32_t frameBit{1u << frameIndex};
+	if (std::atomic_ref{staleFrames}.fetch_and(~frameBit) & frameBit)
+	{
+		flushFrame(frameIndex);
+	}
+
+	const uint32_t dynamicOffset{static_cast<uint32_t>(frameIndex * frameStride)};
+	commandBuffer.bindDescriptorSets(bindPoint, pipelineLayout, setIndex, *descriptorSets[frameIndex], dynamicOffset);
+}
+
+void VulkanShaderObject::updateDescriptors(const uint32_t frameIndex) const
+{
+	std::pmr::vector<vk::DescriptorImageInfo> imageInfos{app.frameAllocator.makeVector<vk::DescriptorImageInfo>()};
+	std::pmr::vector<vk::WriteDescriptorSet> writes{app.frameAllocator.makeVector<vk::WriteDescriptorSet>()};
+	// The writes point into imageInfos, so it must not reallocate
+	imageInfos.reserve(textures.size());
+	for (const TextureBinding& binding : textures)
+	{
+		binding.texture->markUsed();
+
+		// The frame's fence was waited on, so its set is not in use. Other frames update their sets when they are recorded
+		const uint64_t generation{binding.texture->getGeneration()};
+		if (binding.writtenGenerations[frameIndex] == generation)
+		{
+			continue;
+		}
+		binding.writtenGenerations[frameIndex] = generation;
+
+		// TODO: Sampler is right now here and in the sampler. TODO: Is this always the correct layout?
+		const vk::DescriptorImageInfo& image{imageInfos.emplace_back(binding.texture->sampler, binding.texture->image->imageView, vk::ImageLayout::eShaderReadOnlyOptimal)};
+		writes.emplace_back(descriptorSets[frameIndex], binding.binding, binding.arrayElement, 1,
+		                    vk::DescriptorType::eCombinedImageSampler/* TODO: VulkanShaderObjectLayout::mapDescriptorType(typeLayout->getBindingRangeType(bindingIndex))*/, &image);
+	}
+
+	const uint32_t frameBit{1u << frameIndex};
+	for (const DescriptorWrite& write : descriptorWrites)
+	{
+		if (write.pendingFrames & frameBit)
+		{
+			writes.emplace_back(descriptorSets[frameIndex], write.binding, write.arrayElement, 1, write.type, &write.image, &write.buffer);
+			write.pendingFrames &= ~frameBit;
+		}
+	}
+
+	if (!writes.empty())
+	{
+		app.device.updateDescriptorSets(writes, nullptr);
+	}
+}
+
+void VulkanShaderObject::recordWrite(const DescriptorWrite& write)
+{
+	const auto existing{std::ranges::find_if(descriptorWrites, [&](const DescriptorWrite& other) { return other.binding == write.binding && other.arrayElement == write.arrayElement; })};
+	DescriptorWrite& recorded{existing == descriptorWrites.end() ? descriptorWrites.emplace_back(write) : (*existing = write)};
+	recorded.pendingFrames = (1u << descriptorSets.size()) - 1;
+}
+
 VulkanShaderObject VulkanShaderObject::createShaderObject(const std::shared_ptr<VulkanShaderObjectLayout>& layoutObject) // TODO: Stage flags as param
 {
-	const auto typeLayout{layoutObject->getTypeLayout()->getElementVarLayout()->getTypeLayout()};
-	const bool hasOrdinaryData{layoutObject->getOrdinaryDataSize() > 0};
-	std::optional<Buffer> buffer{};
+	const bool hasOrdinaryData{layoutObject->hasOrdinaryData()};
+	std::optional<UniformAllocation> uniformData{};
+	vk::DeviceSize frameStride{0};
 	if (hasOrdinaryData)
 	{
-		// TODO: Give the option to have this host visible instead
-		buffer = Buffer{
-			layoutObject->app, vk::DeviceSize{layoutObject->getOrdinaryDataSize()}, vk::BufferUsageFlagBits::eUniformBuffer | vk::BufferUsageFlagBits::eTransferDst, vk::MemoryPropertyFlags{}
-		};
+		const Renderer& app{layoutObject->app};
+		const vk::DeviceSize alignment{app.physicalDevice.getProperties().limits.minUniformBufferOffsetAlignment};
+		frameStride = (vk::DeviceSize{layoutObject->getOrdinaryDataSize()} + alignment - 1) / alignment * alignment;
+
+		uniformData = app.uniformArena.allocate(app.maxFramesInFlight * frameStride);
+	}
+
+	std::vector<vk::raii::DescriptorSet> descriptorSets{layoutObject->allocateDescriptorSets()};
+
+	return {layoutObject->getTypeLayout(), layoutObject, std::move(uniformData), frameStride, std::move(descriptorSets), layoutObject->app};
+}
+
+void VulkanShaderObject::flushFrame(const uint32_t frameIndex) const
+{
+	std::vector<DirtyRange>& ranges{dirtyRanges[frameIndex]};
+	std::ranges::sort(ranges, {}, &DirtyRange::begin);
+
+	std::byte* frameCopy{uniformData->getMappedData() + frameIndex * frameStride};
+	const auto copyRange{
+		[&](const DirtyRange& range) { std::memcpy(frameCopy + range.begin, ordinaryData.data() + range.begin, range.end - range.begin); }
+	};
+
+	DirtyRange merged{ranges.front()};
+	for (const DirtyRange& range : ranges | std::views::drop(1))
+	{
+		if (range.begin <= merged.end + coalesceGap)
+		{
+			merged.end = std::max(merged.end, range.end);
+			continue;
+		}
+		copyRange(merged);
+		merged = range;
 	}
+	copyRange(merged);
+
+	ranges.clear();
+}
 
-	std::vector<vk::DescriptorSetLayout> layouts(layoutObject->app.maxFramesInFlight, layoutObject->descriptorSetLayout);
-	const vk::DescriptorSetAllocateInfo descriptorSetAllocateInfo{layoutObject->descriptorPool, layouts};
-	std::vector<vk::raii::DescriptorSet> descriptorSets{layoutObject->app.device.allocateDescriptorSets(descriptorSetAllocateInfo)};
+void VulkanShaderObject::addDirtyRange(std::vector<DirtyRange>& ranges, const DirtyRange range) const
+{
+	// Fields are mostly written in order, so overlapping or adjacent writes usually extend the last range
+	if (!ranges.empty() && range.begin <= ranges.back().end && range.end >= ranges.back().begin)
+	{
+		ranges.back().begin = std::min(ranges.back().begin, range.begin);
+		ranges.back().end = std::max(ranges.back().end, range.end);
+		return;
+	}
 
-	return {typeLayout, layoutObject, std::move(buffer), std::move(descriptorSets), layoutObject->app};
+	if (ranges.size() >= maxDirtyRanges)
+	{
+		ranges.assign(1, DirtyRange{0, ordinaryData.size()});
+		return;
+	}
+	ranges.push_back(range);
 }
 
 void VulkanShaderObject::initializeGlobalDescriptorSet()
 {
-	if (buffer)
+	if (uniformData)
 	{
-		const uint32_t bindingIndex = layout->getBindingIndex(); //offset.bindingIndex; //typeLayout->getBindingRangeIndexOffset(offset.bindingIndex);
+		const uint32_t bindingIndex = layout->getOrdinaryDataBinding();
 
-		vk::DescriptorBufferInfo bufferInfo{buffer->vkBuffer, 0, layout->getOrdinaryDataSize()};
+		// The frame's copy is selected by the dynamic offset when binding, relative to the start of the allocation
+		vk::DescriptorBufferInfo bufferInfo{uniformData->getBuffer().vkBuffer, uniformData->getOffset(), layout->getOrdinaryDataSize()};
 
-		std::vector<vk::WriteDescriptorSet> descriptorWrites{};
+		std::pmr::vector<vk::WriteDescriptorSet> descriptorWrites{app.frameAllocator.makeVector<vk::WriteDescriptorSet>()};
 		descriptorWrites.reserve(descriptorSets.size());
 		for (const auto& descriptorSet : descriptorSets)
 		{
-			descriptorWrites.emplace_back(descriptorSet, bindingIndex, 0 /* TODO: This might be needed some day */, 1,
-			                              VulkanShaderObjectLayout::mapDescriptorType(typeLayout->getBindingRangeType(bindingIndex)), nullptr, &bufferInfo);
+			descriptorWrites.emplace_back(descriptorSet, bindingIndex, 0 /* TODO: This might be needed some day */, 1, vk::DescriptorType::eUniformBufferDynamic, nullptr, &bufferInfo);
 		}
 		app.device.updateDescriptorSets(descriptorWrites, {});
 	}
 }
 
-VulkanShaderObject::VulkanShaderObject(slang::TypeLayoutReflection* typeLayout, const std::shared_ptr<VulkanShaderObjectLayout>& layout, std::optional<Buffer>&& buffer,
-                                       std::vector<vk::raii::DescriptorSet>&& descriptorSets, const Renderer& app)
-	: ShaderObject(typeLayout), buffer(std::move(buffer)), descriptorSets(std::move(descriptorSets)), layout(layout), app(app)
+VulkanShaderObject::VulkanShaderObject(const std::shared_ptr<const ShaderTypeLayout>& typeLayout, const std::shared_ptr<VulkanShaderObjectLayout>& layout, std::optional<UniformAllocation>&& uniformData,
+                                       const vk::DeviceSize frameStride, std::vector<vk::raii::DescriptorSet>&& descriptorSets, const Renderer& app)
+	: ShaderObject(typeLayout), uniformData(std::move(uniformData)), frameStride(frameStride), ordinaryData(layout->getOrdinaryDataSize()), dirtyRanges(app.maxFramesInFlight),
+	  trackedOrdinaryData(app.hostMemory, MemoryCategory::ShaderObject, ordinaryData.size()), descriptorSets(std::move(descriptorSets)), layout(layout), app(app)
 {
 	initializeGlobalDescriptorSet();
 }
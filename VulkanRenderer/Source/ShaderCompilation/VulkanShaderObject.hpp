@@ -1,12 +1,14 @@
 ﻿#pragma once
+#include <memory>
 #include <slang/slang.h>
 
-#include "Buffer.hpp"
 #include "ShaderObject.hpp"
 #include "VulkanBackend.hpp"
+#include "Renderer/UniformArena.hpp"
 
 class VulkanShaderObjectLayout;
 class Renderer;
+class TextureData;
 
 class VulkanShaderObject : public ShaderObject
 {
@@ -16,25 +18,85 @@ public:
 	// TODO: We may need to treat matrices differently: For CPU targets, they need to be forced into row-major. For GPU targets, non 4x4 matrices need to be forced into certain layouts
 	virtual void write(const ShaderOffset& offset, const void* data, size_t size) override;
 
+	// Only record the descriptor. Frames in flight may still use their sets, so each frame's set is written by updateDescriptors before the frame binds it
+	// Textures are written once they are resident
 	virtual void writeTexture(const ShaderOffset& offset, const TextureImage& texture) override;
 	virtual void writeSampler(const ShaderOffset& offset, const TextureImage& texture) override;
+	virtual void writeBuffer(const ShaderOffset& offset, const Buffer& buffer) override;
 
 	virtual size_t existentialToByteOffset(const size_t& existentialObjectOffset) override;
 	virtual size_t existentialToBindingOffset(const size_t& existentialObjectOffset) override;
 
 	const std::vector<vk::raii::DescriptorSet>& getDescriptorSets() const;
+	const VulkanShaderObjectLayout& getLayout() const;
+
+	// Binds the frame's descriptor set with the dynamic offset of the frame's copy of the ordinary data, which is brought up to date first
+	// Expects the frame's fence to be signaled. Safe to call from several recording threads at once
+	void bind(const vk::raii::CommandBuffer& commandBuffer, vk::PipelineBindPoint bindPoint, vk::PipelineLayout pipelineLayout, uint32_t setIndex, uint32_t frameIndex) const;
+
+	// Has to be called in every frame binding the object, before it is recorded. Restores the evicted textures written to it
+	// and updates the frame's descriptors written or uploaded since the frame last bound the set. Called on the main thread
+	void updateDescriptors(uint32_t frameIndex) const;
 
 private:
+	struct TextureBinding
+	{
+		uint32_t binding;
+		uint32_t arrayElement;
+		std::shared_ptr<TextureData> texture;
+		// Generation of the texture that the descriptor in each frame's set refers to
+		mutable std::vector<uint64_t> writtenGenerations;
+	};
+
+	// Sampler or buffer descriptor, kept until every frame's set has been updated
+	struct DescriptorWrite
+	{
+		uint32_t binding;
+		uint32_t arrayElement;
+		vk::DescriptorType type;
+		vk::DescriptorImageInfo image;
+		vk::DescriptorBufferInfo buffer;
+		// Bit i is set while the set of frame i lacks the write
+		mutable uint32_t pendingFrames;
+	};
+
+	struct DirtyRange
+	{
+		size_t begin;
+		size_t end;
+	};
+
+	// Dirty ranges closer than this are copied as one, including the padding between them
+	static constexpr size_t coalesceGap{64};
+	// Frames with more dirty ranges copy all of the ordinary data instead, so objects that are written but never drawn stay bounded
+	static constexpr size_t maxDirtyRanges{16};
+
 	static VulkanShaderObject createShaderObject(const std::shared_ptr<VulkanShaderObjectLayout>& layoutObject);
 
-	std::optional<Buffer> buffer;
+	// Suballocated from the renderer's uniform arena. Holds one copy of the ordinary data per frame in flight, frameStride bytes apart
+	std::optional<UniformAllocation> uniformData;
+	vk::DeviceSize frameStride;
+	// Written by ShaderCursor. Its dirty ranges are copied into a frame's region when the object is bound for that frame
+	std::vector<std::byte> ordinaryData;
+	// Bit i is set while the copy of frame i lags behind ordinaryData. Only accessed through std::atomic_ref
+	mutable uint32_t staleFrames{0};
+	// Ranges written since the copy of each frame was last updated. Owned by whoever clears the frame's stale bit
+	mutable std::vector<std::vector<DirtyRange>> dirtyRanges;
+	TrackedHostMemory trackedOrdinaryData;
 	std::vector<vk::raii::DescriptorSet> descriptorSets;
+	std::vector<TextureBinding> textures;
+	std::vector<DescriptorWrite> descriptorWrites;
 
 	std::shared_ptr<VulkanShaderObjectLayout> layout;
 	const Renderer& app;
 
 	void initializeGlobalDescriptorSet();
+	// Replaces an earlier write to the same descriptor
+	void recordWrite(const DescriptorWrite& write);
+	void addDirtyRange(std::vector<DirtyRange>& ranges, DirtyRange range) const;
+	// Merges the frame's dirty ranges and copies them into its region of the buffer
+	void flushFrame(uint32_t frameIndex) const;
 
-	VulkanShaderObject(slang::TypeLayoutReflection* typeLayout, const std::shared_ptr<VulkanShaderObjectLayout>& layout, std::optional<Buffer>&& buffer,
+	VulkanShaderObject(const std::shared_ptr<const ShaderTypeLayout>& typeLayout, const std::shared_ptr<VulkanShaderObjectLayout>& layout, std::optional<UniformAllocation>&& uniformData, vk::DeviceSize frameStride,
 	                   std::vector<vk::raii::DescriptorSet>&& descriptorSets, const Renderer& app);
 };
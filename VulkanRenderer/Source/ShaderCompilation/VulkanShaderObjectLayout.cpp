@@ -4,8 +4,16 @@
 
 #include "VulkanShaderObjectLayout.hpp"
 
+#include <stdexcept>
+
 #include "Renderer.hpp"
 
+bool ShaderObjectLayoutReflection::operator==(const ShaderObjectLayoutReflection& other) const
+{
+	return *typeLayout == *other.typeLayout && setIndex == other.setIndex && ordinaryDataSize == other.ordinaryDataSize &&
+		existentialObjectOffsets == other.existentialObjectOffsets && resourceBindings == other.resourceBindings;
+}
+
 vk::DescriptorType VulkanShaderObjectLayout::mapDescriptorType(slang::BindingType bindingType)
 {
 	switch (bindingType)
@@ -21,9 +29,9 @@ vk::DescriptorType VulkanShaderObjectLayout::mapDescriptorType(slang::BindingTyp
 	case slang::BindingType::ParameterBlock:
 		return vk::DescriptorType::eUniformBuffer;
 	case slang::BindingType::TypedBuffer:
-		break;
+		return vk::DescriptorType::eUniformTexelBuffer;
 	case slang::BindingType::RawBuffer:
-		break;
+		return vk::DescriptorType::eStorageBuffer;
 	case slang::BindingType::CombinedTextureSampler:
 		return vk::DescriptorType::eCombinedImageSampler;
 	case slang::BindingType::InputRenderTarget:
@@ -45,53 +53,110 @@ vk::DescriptorType VulkanShaderObjectLayout::mapDescriptorType(slang::BindingTyp
 	case slang::BindingType::MutableTexture:
 		return vk::DescriptorType::eStorageImage;
 	case slang::BindingType::MutableTypedBuffer:
-		break;
+		return vk::DescriptorType::eStorageTexelBuffer;
 	case slang::BindingType::MutableRawBuffer:
-		break;
+		return vk::DescriptorType::eStorageBuffer;
 	case slang::BindingType::BaseMask:
 		break;
 	case slang::BindingType::ExtMask:
 		break;
 	}
 
-	// TODO: Missing: eUniformTexelBuffer, eStorageTexelBuffer, eUniformBuffer, eStorageBuffer, eUniformBufferDynamic, eStorageBufferDynamic, eInputAttachment, eMutableEXT
+	// TODO: Missing: eUniformBufferDynamic, eStorageBufferDynamic, eInputAttachment, eMutableEXT
 	return vk::DescriptorType::eUniformBuffer;
 }
 
-slang::TypeLayoutReflection* VulkanShaderObjectLayout::getTypeLayout() const
+const ShaderObjectLayoutReflection& VulkanShaderObjectLayout::getReflection() const
 {
-	return variableLayout->getTypeLayout();
+	return reflection;
 }
 
-uint32_t VulkanShaderObjectLayout::getBindingIndex() const
+const std::shared_ptr<const ShaderTypeLayout>& VulkanShaderObjectLayout::getTypeLayout() const
 {
-	return variableLayout->getBindingIndex();
+	return reflection.typeLayout;
 }
 
-VulkanShaderObjectLayout::VulkanShaderObjectLayout(slang::VariableLayoutReflection* variableLayout, const std::vector<slang::TypeLayoutReflection*>& existentialObjectLayouts, const Renderer& app)
-	: VulkanShaderObjectLayout(createLayout(variableLayout, existentialObjectLayouts, app))
+uint32_t VulkanShaderObjectLayout::getSetIndex() const
+{
+	return reflection.setIndex;
+}
+
+bool VulkanShaderObjectLayout::hasOrdinaryData() const
+{
+	return getOrdinaryDataSize() > 0;
+}
+
+uint32_t VulkanShaderObjectLayout::getOrdinaryDataBinding() const
+{
+	return 0;
+}
+
+uint32_t VulkanShaderObjectLayout::getDescriptorBinding(const uint32_t bindingRangeIndex) const
+{
+	return bindingRangeIndex + (hasOrdinaryData() ? 1 : 0);
+}
+
+vk::DescriptorType VulkanShaderObjectLayout::getDescriptorType(const uint32_t binding) const
+{
+	if (hasOrdinaryData() && binding == getOrdinaryDataBinding())
+	{
+		return vk::DescriptorType::eUniformBufferDynamic;
+	}
+	return reflection.resourceBindings.at(binding - (hasOrdinaryData() ? 1 : 0)).type;
+}
+
+std::vector<vk::raii::DescriptorSet> VulkanShaderObjectLayout::allocateDescriptorSets()
+{
+	std::vector<vk::DescriptorSetLayout> layouts(app.maxFramesInFlight, descriptorSetLayout);
+
+	if (!descriptorPools.empty())
+	{
+		try
+		{
+			return app.device.allocateDescriptorSets({descriptorPools.back(), layouts});
+		}
+		catch (const vk::OutOfPoolMemoryError&)
+		{
+		}
+		catch (const vk::FragmentedPoolError&)
+		{
+		}
+	}
+
+	descriptorPools.push_back(createDescriptorPool());
+	return app.device.allocateDescriptorSets({descriptorPools.back(), layouts});
+}
+
+VulkanShaderObjectLayout::VulkanShaderObjectLayout(ShaderObjectLayoutReflection&& reflection, const Renderer& app)
+	// The descriptor set layout is created before the reflection is moved into place
+	: descriptorSetLayout(app.device, vk::DescriptorSetLayoutCreateInfo{{}, createBindings(reflection)}), app(app), reflection(std::move(reflection)),
+	  poolSizes(createPoolSizes(this->reflection, app))
 {
-	// TODO: Existential object handling should be changed but apparently the slang API is not yet updated for this?
 }
 
 size_t VulkanShaderObjectLayout::getOrdinaryDataSize() const
 {
-	return getOrdinaryDataSize(existentialObjectSizes, existentialObjectOffsets, getTypeLayout());
+	return reflection.ordinaryDataSize;
 }
 
 size_t VulkanShaderObjectLayout::getBindingSize() const
 {
-	return getBindingSize(existentialObjectSizes, existentialObjectOffsets, getTypeLayout());
+	return reflection.resourceBindings.size();
 }
 
 size_t VulkanShaderObjectLayout::getByteOffsetOfExistentialObject(const size_t& existentialObjectOffset) const
 {
-	return existentialObjectOffsets[existentialObjectOffset].byteOffset;
+	return reflection.existentialObjectOffsets[existentialObjectOffset].byteOffset;
 }
 
 size_t VulkanShaderObjectLayout::getBindingOffsetOfExistentialObject(const size_t& existentialObjectOffset) const
 {
-	return existentialObjectOffsets[existentialObjectOffset].bindingIndex;
+	return reflection.existentialObjectOffsets[existentialObjectOffset].bindingIndex;
+}
+
+bool VulkanShaderObjectLayout::isCompatible(const VulkanShaderObjectLayout& other) const
+{
+	return reflection == other.reflection;
 }
 
 std::pair<std::vector<ShaderOffset>, std::vector<ShaderOffset>> VulkanShaderObjectLayout::buildOffsets(slang::TypeLayoutReflection* typeLayout,
@@ -102,7 +167,7 @@ std::pair<std::vector<ShaderOffset>, std::vector<ShaderOffset>> VulkanShaderObje
 	existentialObjectOffsets.reserve(existentialObjectLayouts.size());
 	existentialObjectSizes.reserve(existentialObjectLayouts.size());
 	size_t currentByteOffset{typeLayout->getElementVarLayout()->getTypeLayout()->getSize()};
-	int64_t currentBindingOffset{typeLayout->getBindingRangeCount()};
+	int64_t currentBindingOffset{getResourceBindingRangeCount(typeLayout->getElementVarLayout()->getTypeLayout())};
 	for (const auto& existentialObjectLayout : existentialObjectLayouts)
 	{
 		const size_t byteSize{existentialObjectLayout->getSize()};
@@ -115,6 +180,35 @@ std::pair<std::vector<ShaderOffset>, std::vector<ShaderOffset>> VulkanShaderObje
 	return {existentialObjectOffsets, existentialObjectSizes};
 }
 
+uint32_t VulkanShaderObjectLayout::getResourceBindingRangeCount(slang::TypeLayoutReflection* typeLayout)
+{
+	// Existential fields only act as placeholders for their pending data. As they are the last fields of a block, skipping them keeps the other ranges in place
+	uint32_t count{0};
+	for (int64_t i = 0; i < typeLayout->getBindingRangeCount(); ++i)
+	{
+		if (typeLayout->getBindingRangeType(i) != slang::BindingType::ExistentialValue)
+		{
+			++count;
+		}
+	}
+	return count;
+}
+
+vk::raii::DescriptorPool VulkanShaderObjectLayout::createDescriptorPool() const
+{
+	std::vector<vk::DescriptorPoolSize> scaledPoolSizes{poolSizes};
+	for (auto& poolSize : scaledPoolSizes)
+	{
+		poolSize.descriptorCount *= objectsPerPool;
+	}
+	// Layouts without any binding still need a valid pool to allocate their (empty) sets from
+	if (scaledPoolSizes.empty())
+	{
+		scaledPoolSizes.emplace_back(vk::DescriptorType::eUniformBuffer, 1);
+	}
+	return vk::raii::DescriptorPool{app.device, {vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet, app.maxFramesInFlight * objectsPerPool, scaledPoolSizes}};
+}
+
 size_t VulkanShaderObjectLayout::getOrdinaryDataSize(const std::vector<ShaderOffset>& existentialObjectSizes, const std::vector<ShaderOffset>& existentialObjectOffsets,
                                                      slang::TypeLayoutReflection* typeLayout)
 {
@@ -124,72 +218,70 @@ size_t VulkanShaderObjectLayout::getOrdinaryDataSize(const std::vector<ShaderOff
 	return lastOffset + lastSize;
 }
 
-size_t VulkanShaderObjectLayout::getBindingSize(const std::vector<ShaderOffset>& existentialObjectSizes, const std::vector<ShaderOffset>& existentialObjectOffsets,
-                                                slang::TypeLayoutReflection* typeLayout)
+ShaderObjectLayoutReflection VulkanShaderObjectLayout::reflect(slang::VariableLayoutReflection* variableLayout,
+                                                               const std::vector<slang::TypeLayoutReflection*>& existentialObjectLayouts)
 {
-	const size_t numExistentialObjects{existentialObjectSizes.size()};
-	const size_t lastSize{
-		numExistentialObjects > 0 ? existentialObjectSizes[numExistentialObjects - 1].bindingIndex : static_cast<size_t>(typeLayout->getElementVarLayout()->getTypeLayout()->getBindingRangeCount())
-	};
-	const size_t lastOffset{numExistentialObjects > 0 ? existentialObjectOffsets[numExistentialObjects - 1].bindingIndex : 0};
-	return lastOffset + lastSize;
-}
-
-VulkanShaderObjectLayout VulkanShaderObjectLayout::createLayout(slang::VariableLayoutReflection* variableLayout, const std::vector<slang::TypeLayoutReflection*>& existentialObjectLayouts,
-                                                                const Renderer& app)
-{
-	// TODO: This currently does not handle ParameterBlocks!
-	// TODO: We don't need to support all shader stage flags
-
+	// TODO: Existential object handling should be changed but apparently the slang API is not yet updated for this?
 	const auto typeLayout{variableLayout->getTypeLayout()};
+	const auto elementTypeLayout{typeLayout->getElementVarLayout()->getTypeLayout()};
 
 	auto [existentialObjectOffsets, existentialObjectSizes] = buildOffsets(typeLayout, existentialObjectLayouts);
 
-	std::vector<vk::DescriptorSetLayoutBinding> bindings;
-	std::vector<vk::DescriptorPoolSize> poolSizes;
-
-	const bool hasOrdinaryData = typeLayout->getSize() > 0; // TODO: Should this consider existential values?
-
-	const int64_t bindingRangeCount{typeLayout->getBindingRangeCount()};
-	const uint32_t totalBindingCount = getBindingSize(existentialObjectSizes, existentialObjectOffsets, typeLayout) + (hasOrdinaryData ? 1 : 0);
-
-	bindings.reserve(totalBindingCount);
-	poolSizes.reserve(totalBindingCount);
+	ShaderObjectLayoutReflection reflection{
+		std::make_shared<const ShaderTypeLayout>(elementTypeLayout), static_cast<uint32_t>(variableLayout->getOffset(SLANG_PARAMETER_CATEGORY_SUB_ELEMENT_REGISTER_SPACE)),
+		getOrdinaryDataSize(existentialObjectSizes, existentialObjectOffsets, typeLayout), existentialObjectOffsets, {}
+	};
 
+	const uint32_t bindingRangeCount{getResourceBindingRangeCount(elementTypeLayout)};
 	for (unsigned i = 0; i < bindingRangeCount; ++i)
 	{
-		const vk::DescriptorType descriptorType{mapDescriptorType(typeLayout->getBindingRangeType(i))};
-		bindings.emplace_back(i, descriptorType, static_cast<uint32_t>(typeLayout->getBindingRangeBindingCount(i)), vk::ShaderStageFlagBits::eAll, nullptr);
-		poolSizes.emplace_back(descriptorType, app.maxFramesInFlight);
-	}
-	unsigned currentBindingIndex{static_cast<uint32_t>(bindingRangeCount)};
-	if (hasOrdinaryData)
-	{
-		bindings.emplace_back(currentBindingIndex, vk::DescriptorType::eUniformBuffer, 1, vk::ShaderStageFlagBits::eAll, nullptr);
-		poolSizes.emplace_back(vk::DescriptorType::eUniformBuffer, app.maxFramesInFlight);
-		++currentBindingIndex;
+		reflection.resourceBindings.emplace_back(mapDescriptorType(elementTypeLayout->getBindingRangeType(i)), static_cast<uint32_t>(elementTypeLayout->getBindingRangeBindingCount(i)));
 	}
 	for (unsigned j = 0; j < existentialObjectLayouts.size(); ++j)
 	{
 		slang::TypeLayoutReflection* existentialObjectLayout{existentialObjectLayouts[j]};
 		for (unsigned i = 0; i < existentialObjectSizes[j].bindingIndex; ++i)
 		{
-			const vk::DescriptorType descriptorType{mapDescriptorType(existentialObjectLayout->getBindingRangeType(i))};
-			bindings.emplace_back(currentBindingIndex, descriptorType, static_cast<uint32_t>(existentialObjectLayout->getBindingRangeBindingCount(i)), vk::ShaderStageFlagBits::eAll, nullptr);
-			poolSizes.emplace_back(descriptorType, app.maxFramesInFlight);
-			++currentBindingIndex;
+			reflection.resourceBindings.emplace_back(mapDescriptorType(existentialObjectLayout->getBindingRangeType(i)),
+			                                         static_cast<uint32_t>(existentialObjectLayout->getBindingRangeBindingCount(i)));
 		}
 	}
+	return reflection;
+}
+
+std::vector<vk::DescriptorSetLayoutBinding> VulkanShaderObjectLayout::createBindings(const ShaderObjectLayoutReflection& reflection)
+{
+	// TODO: We don't need to support all shader stage flags
+	std::vector<vk::DescriptorSetLayoutBinding> bindings;
+	bindings.reserve(reflection.resourceBindings.size() + 1);
 
-	vk::raii::DescriptorSetLayout descriptorSetLayout{app.device, {{}, bindings}};
-	vk::raii::DescriptorPool descriptorPool{app.device, {vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet, app.maxFramesInFlight, poolSizes}};
-	return {variableLayout, app, std::move(descriptorSetLayout), std::move(descriptorPool), existentialObjectLayouts, existentialObjectSizes, existentialObjectOffsets};
+	// The ordinary data of a parameter block always comes first
+	unsigned currentBindingIndex{0};
+	if (reflection.ordinaryDataSize > 0)
+	{
+		// Dynamic, so the shader object selects the copy of the frame when binding
+		bindings.emplace_back(currentBindingIndex, vk::DescriptorType::eUniformBufferDynamic, 1, vk::ShaderStageFlagBits::eAll, nullptr);
+		++currentBindingIndex;
+	}
+	for (const ShaderObjectLayoutReflection::ResourceBinding& binding : reflection.resourceBindings)
+	{
+		bindings.emplace_back(currentBindingIndex, binding.type, binding.count, vk::ShaderStageFlagBits::eAll, nullptr);
+		++currentBindingIndex;
+	}
+	return bindings;
 }
 
-VulkanShaderObjectLayout::VulkanShaderObjectLayout(slang::VariableLayoutReflection* variableLayout, const Renderer& app, vk::raii::DescriptorSetLayout&& descriptorSetLayout,
-                                                   vk::raii::DescriptorPool&& descriptorPool, const std::vector<slang::TypeLayoutReflection*>& existentialObjectLayouts,
-                                                   const std::vector<ShaderOffset>& existentialObjectSizes, const std::vector<ShaderOffset>& existentialObjectOffsets)
-	: descriptorSetLayout(std::move(descriptorSetLayout)), descriptorPool(std::move(descriptorPool)), app(app), variableLayout(variableLayout), existentialObjectLayouts(existentialObjectLayouts),
-	  existentialObjectSizes(existentialObjectSizes), existentialObjectOffsets(existentialObjectOffsets)
+std::vector<vk::DescriptorPoolSize> VulkanShaderObjectLayout::createPoolSizes(const ShaderObjectLayoutReflection& reflection, const Renderer& app)
 {
+	std::vector<vk::DescriptorPoolSize> poolSizes;
+	poolSizes.reserve(reflection.resourceBindings.size() + 1);
+	if (reflection.ordinaryDataSize > 0)
+	{
+		poolSizes.emplace_back(vk::DescriptorType::eUniformBufferDynamic, app.maxFramesInFlight);
+	}
+	for (const ShaderObjectLayoutReflection::ResourceBinding& binding : reflection.resourceBindings)
+	{
+		poolSizes.emplace_back(binding.type, app.maxFramesInFlight);
+	}
+	return poolSizes;
 }
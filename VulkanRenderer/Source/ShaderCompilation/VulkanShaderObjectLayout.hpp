@@ -1,24 +1,66 @@
 ﻿#pragma once
 
+#include <memory>
+#include <vector>
 #include <slang/slang.h>
 
 #include "ShaderOffset.hpp"
+#include "ShaderTypeLayout.hpp"
 #include "VulkanBackend.hpp"
 
 class Renderer;
 
+// Everything a layout is built from, read from reflection once
+// Plain data, so the SPIR-V cache can store it and the layout is created again without loading any module
+struct ShaderObjectLayoutReflection
+{
+	struct ResourceBinding
+	{
+		vk::DescriptorType type;
+		uint32_t count;
+
+		bool operator==(const ResourceBinding&) const = default;
+	};
+
+	// Element type of the parameter block. Its interface fields lead to the pending data of the existential objects
+	std::shared_ptr<const ShaderTypeLayout> typeLayout;
+	uint32_t setIndex{0};
+	size_t ordinaryDataSize{0};
+	// Where the data of each existential object starts, after the fields and resources of the block itself
+	std::vector<ShaderOffset> existentialObjectOffsets;
+	// Resources of the block and of its existential objects in binding order, after the buffer of the ordinary data
+	std::vector<ResourceBinding> resourceBindings;
+
+	bool operator==(const ShaderObjectLayoutReflection& other) const;
+};
+
+// Layout of a single ParameterBlock, which maps to its own descriptor set
+// Binding 0 holds the ordinary data of the block (if any), followed by the resources of the block and of its existential objects
 class VulkanShaderObjectLayout
 {
 public:
-	VulkanShaderObjectLayout(slang::VariableLayoutReflection* variableLayout, const std::vector<slang::TypeLayoutReflection*>& existentialObjectLayouts, const Renderer& app);
+	// Creating the layout and its shader objects does not touch any Slang session
+	VulkanShaderObjectLayout(ShaderObjectLayoutReflection&& reflection, const Renderer& app);
 
+	// Has to be called on the thread using the session the reflection belongs to
+	[[nodiscard]] static ShaderObjectLayoutReflection reflect(slang::VariableLayoutReflection* variableLayout,
+	                                                          const std::vector<slang::TypeLayoutReflection*>& existentialObjectLayouts);
 	static vk::DescriptorType mapDescriptorType(slang::BindingType bindingType);
 
 	vk::raii::DescriptorSetLayout descriptorSetLayout;
-	vk::raii::DescriptorPool descriptorPool;
 
-	slang::TypeLayoutReflection* getTypeLayout() const;
-	uint32_t getBindingIndex() const;
+	[[nodiscard]] const ShaderObjectLayoutReflection& getReflection() const;
+	[[nodiscard]] const std::shared_ptr<const ShaderTypeLayout>& getTypeLayout() const;
+	uint32_t getSetIndex() const;
+	[[nodiscard]] bool hasOrdinaryData() const;
+	[[nodiscard]] uint32_t getOrdinaryDataBinding() const;
+	// Converts a binding range index as used by ShaderCursor into the binding inside the descriptor set
+	[[nodiscard]] uint32_t getDescriptorBinding(uint32_t bindingRangeIndex) const;
+	// Type of a binding inside the descriptor set
+	[[nodiscard]] vk::DescriptorType getDescriptorType(uint32_t binding) const;
+
+	// Allocates one descriptor set per frame in flight. Pools are added when the current one is full
+	[[nodiscard]] std::vector<vk::raii::DescriptorSet> allocateDescriptorSets();
 
 	const Renderer& app;
 
@@ -27,20 +69,23 @@ public:
 	[[nodiscard]] size_t getByteOffsetOfExistentialObject(const size_t& existentialObjectOffset) const;
 	[[nodiscard]] size_t getBindingOffsetOfExistentialObject(const size_t& existentialObjectOffset) const;
 
+	// Whether shader objects of this layout can be bound in place of ones of other. Needs the same fields at the same offsets and the same bindings
+	[[nodiscard]] bool isCompatible(const VulkanShaderObjectLayout& other) const;
+
 private:
-	slang::VariableLayoutReflection* variableLayout;
+	// Shader objects allocated per pool before a new pool is created
+	static constexpr uint32_t objectsPerPool{64};
+
+	ShaderObjectLayoutReflection reflection;
+
+	std::vector<vk::DescriptorPoolSize> poolSizes;
+	std::vector<vk::raii::DescriptorPool> descriptorPools;
 
-	std::vector<slang::TypeLayoutReflection*> existentialObjectLayouts;
-	std::vector<ShaderOffset> existentialObjectSizes;
-	std::vector<ShaderOffset> existentialObjectOffsets;
 	static std::pair<std::vector<ShaderOffset>, std::vector<ShaderOffset>> buildOffsets(slang::TypeLayoutReflection* typeLayout,
 	                                                                                    const std::vector<slang::TypeLayoutReflection*>& existentialObjectLayouts);
+	static uint32_t getResourceBindingRangeCount(slang::TypeLayoutReflection* typeLayout);
+	static std::vector<vk::DescriptorSetLayoutBinding> createBindings(const ShaderObjectLayoutReflection& reflection);
+	static std::vector<vk::DescriptorPoolSize> createPoolSizes(const ShaderObjectLayoutReflection& reflection, const Renderer& app);
+	vk::raii::DescriptorPool createDescriptorPool() const;
 	static size_t getOrdinaryDataSize(const std::vector<ShaderOffset>& existentialObjectSizes, const std::vector<ShaderOffset>& existentialObjectOffsets, slang::TypeLayoutReflection* typeLayout);
-	static size_t getBindingSize(const std::vector<ShaderOffset>& existentialObjectSizes, const std::vector<ShaderOffset>& existentialObjectOffsets, slang::TypeLayoutReflection* typeLayout);
-
-	static VulkanShaderObjectLayout createLayout(slang::VariableLayoutReflection* variableLayout, const std::vector<slang::TypeLayoutReflection*>& existentialObjectLayouts, const Renderer& app);
-
-	VulkanShaderObjectLayout(slang::VariableLayoutReflection* variableLayout, const Renderer& app, vk::raii::DescriptorSetLayout&& descriptorSetLayout, vk::raii::DescriptorPool&& descriptorPool,
-	                         const std::vector<slang::TypeLayoutReflection*>& existentialObjectLayouts, const std::vector<ShaderOffset>& existentialObjectSizes,
-	                         const std::vector<ShaderOffset>& existentialObjectOffsets);
 };
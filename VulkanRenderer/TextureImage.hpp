@@ -1,18 +1,55 @@
 ﻿#pragma once
 #include <filesystem>
+#include <memory>
+#include <optional>
+#include <span>
 
 #include "Image.hpp"
+#include "Renderer/ResidencyBlob.hpp"
+#include "Renderer/ResidencyManager.hpp"
 
-class TextureImage : public Image
+// Device image of a texture. Evicted by the residency manager when no drawn shader object uses it, and uploaded again from a blob of the decoded texels once one does
+class TextureData : public EvictableResource
 {
 public:
-	TextureImage(const std::filesystem::path& path, vk::ImageViewType viewType, const Renderer& app);
+	// texels are tightly packed RGBA8 texels of every layer
+	TextureData(const Renderer& app, std::span<const std::byte> texels, uint32_t width, uint32_t height, uint32_t layerCount, vk::ImageViewType viewType);
 
+	// Kept while evicted, as it holds no memory
 	vk::raii::Sampler sampler;
+	// Only valid while resident
+	std::optional<Image> image;
+
+	// Incremented by every upload. Descriptors written before refer to a destroyed image view
+	[[nodiscard]] uint64_t getGeneration() const;
+
+protected:
+	vk::DeviceSize restore() override;
+	void evict() override;
 
 private:
-	void generateMipMaps(const vk::Format& imageFormat, uint32_t width, uint32_t height, uint32_t mipLevels, const Renderer& app) const;
+	const Renderer& app;
+	ResidencyBlob blob;
+	uint32_t width;
+	uint32_t height;
+	uint32_t layerCount;
+	uint32_t mipLevels;
+	vk::ImageViewType viewType;
+	uint64_t generation{0};
 
-	static Image createImageFromPath(const std::filesystem::path& path, vk::ImageViewType viewType, const Renderer& app);
 	static vk::raii::Sampler createTextureSampler(const vk::raii::Device& device, const vk::raii::PhysicalDevice& physicalDevice);
 };
+
+// Texture loaded from an image file. Cubemaps are read from a horizontal cross
+class TextureImage
+{
+public:
+	TextureImage(const std::filesystem::path& path, vk::ImageViewType viewType, const Renderer& app);
+
+	// Shared with the shader objects the texture is written to, which make it resident in the frames they are drawn in
+	// Kept on the heap, so the residency manager can refer to it while the texture moves
+	std::shared_ptr<TextureData> data;
+
+private:
+	static std::shared_ptr<TextureData> loadFromFile(const std::filesystem::path& path, vk::ImageViewType viewType, const Renderer& app);
+};
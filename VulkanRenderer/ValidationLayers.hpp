@@ -38,13 +38,19 @@ inline bool checkValidationLayerSupport()
     return true;
 }
 
-inline std::vector<const char*> getRequiredExtensions()
+inline std::vector<const char*> getRequiredExtensions(const bool headless = false)
 {
-    glfwInit(); // TODO: glfw might not be initialized here. This will be changed someday
-    uint32_t glfwExtensionCount = 0;
-    const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    std::vector<const char*> extensions{};
 
-    std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+    // Headless rendering must not touch glfw, as there might not be any display to connect to
+    if (!headless)
+    {
+        glfwInit(); // TODO: glfw might not be initialized here. This will be changed someday
+        uint32_t glfwExtensionCount = 0;
+        const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+
+        extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+    }
 
     if (enableValidationLayers)
     {